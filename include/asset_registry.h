@@ -0,0 +1,97 @@
+#ifndef ASSET_REGISTRY_H
+#define ASSET_REGISTRY_H
+
+#include "../include/file_watch.h"
+#include "../include/obj_loader.h"
+#include "../include/mtl_loader.h"
+#include "../include/texture.h"
+#include "../include/texture_atlas.h"
+#include "../glad/glad.h"
+#include <pthread.h>
+
+// Most assets one registry can track, bounded by the file watcher
+#define MAX_ASSETS MAX_WATCHED_FILES
+
+typedef enum {
+    ASSET_TEXTURE,
+    ASSET_ATLAS_IMAGE,
+    ASSET_MESH,
+    ASSET_MATERIAL
+} AssetType;
+
+// Where an asset is in its reload
+typedef enum {
+    ASSET_IDLE,
+    ASSET_QUEUED,  // File changed, waiting for the worker
+    ASSET_LOADING, // Worker is importing it
+    ASSET_READY    // Imported, waiting for the frame boundary
+} AssetState;
+
+// A loaded file and the result it replaces when the file changes
+typedef struct {
+    AssetType type;
+    const char* path;
+    AssetState state;
+    int dirty;   // Changed again while being imported
+    int changed; // Replaced by the last updateAssetRegistry
+
+    // What gets replaced in place
+    GLuint texture;           // ASSET_TEXTURE, keeps its ID
+    TextureAtlas* atlas;      // ASSET_ATLAS_IMAGE, keeps its index
+    int atlasImage;           // ASSET_ATLAS_IMAGE
+    int atlasBindless;        // ASSET_ATLAS_IMAGE, copied so the worker never reads the atlas
+    AtlasSlot atlasSlot;      // ASSET_ATLAS_IMAGE, as of the last time it was applied
+    LoadedObject* object;     // ASSET_MESH, the old arrays are freed
+    int maxLods;              // ASSET_MESH, detail levels generated on import
+    MaterialLibrary* library; // ASSET_MATERIAL
+
+    // Imported by the worker
+    ImageData image;
+    AtlasImageLevels atlasLevels; // Texture array images, filtered as they sit in their layer
+    LoadedObject loadedObject;
+    MaterialLibrary loadedLibrary;
+} Asset;
+
+// Watches the files of loaded assets and imports them again when they change
+// Parsing and decoding run on a worker thread, only GL uploads happen on the main thread
+typedef struct {
+    FileWatcher watcher;
+    Asset assets[MAX_ASSETS];
+    int numAssets;
+
+    pthread_t worker;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    int quit;
+} AssetRegistry;
+
+// Starts the import worker
+// 0 on failure, 1 on success
+int initAssetRegistry(AssetRegistry* registry);
+
+// Tracks a texture made by loadTexture, its contents are replaced under the same ID
+// Returns the asset id, -1 on failure
+int trackTexture(AssetRegistry* registry, const char* path, GLuint texture);
+
+// Tracks an image of a built atlas, its pixels are replaced under the same index
+// A new size packs the whole atlas again, the other images are read from disk
+// Returns the asset id, -1 on failure
+int trackAtlasImage(AssetRegistry* registry, TextureAtlas* atlas, int image);
+
+// Tracks an object made by loadObj, the new one gets maxLods detail levels like generateLods
+// Returns the asset id, -1 on failure
+int trackObj(AssetRegistry* registry, const char* path, LoadedObject* object, int maxLods);
+
+// Tracks a material library made by loadMtl
+// Returns the asset id, -1 on failure
+int trackMtl(AssetRegistry* registry, const char* path, MaterialLibrary* library);
+
+// Call once per frame on the main thread, between frames
+// Queues changed files and swaps in every finished import, never waits on the worker
+// Returns how many assets were replaced, their changed flag is set
+int updateAssetRegistry(AssetRegistry* registry);
+
+// Stops the worker and frees pending imports, tracked results stay with their owners
+void freeAssetRegistry(AssetRegistry* registry);
+
+#endif
\ No newline at end of file
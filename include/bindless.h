@@ -0,0 +1,21 @@
+#ifndef BINDLESS_H
+#define BINDLESS_H
+
+#include "../glad/glad.h"
+
+// ARB_bindless_texture entry points, GLAD only loads core 3.3 so they are fetched at runtime
+typedef GLuint64 (APIENTRYP PFNGLGETTEXTUREHANDLEARBPROC)(GLuint texture);
+typedef GLuint64 (APIENTRYP PFNGLGETTEXTURESAMPLERHANDLEARBPROC)(GLuint texture, GLuint sampler);
+typedef void (APIENTRYP PFNGLMAKETEXTUREHANDLERESIDENTARBPROC)(GLuint64 handle);
+typedef void (APIENTRYP PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC)(GLuint64 handle);
+
+extern PFNGLGETTEXTUREHANDLEARBPROC glGetTextureHandleARB;
+extern PFNGLGETTEXTURESAMPLERHANDLEARBPROC glGetTextureSamplerHandleARB;
+extern PFNGLMAKETEXTUREHANDLERESIDENTARBPROC glMakeTextureHandleResidentARB;
+extern PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC glMakeTextureHandleNonResidentARB;
+
+// Checks the extension string of the current context and loads the entry points
+// 0 if the extension is missing, 1 if bindless textures can be used
+int loadBindlessTexture(void);
+
+#endif
\ No newline at end of file
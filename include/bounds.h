@@ -0,0 +1,21 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <stddef.h>
+
+// Axis aligned box and the sphere around it, in model space
+typedef struct {
+    float min[3];
+    float max[3];
+    float center[3];
+    float radius;
+} Bounds;
+
+// Calculates the bounds of a vertex array
+// Every vertex starts with three position floats, stride is the size of a vertex in bytes
+void computeBounds(const void* vertices, int numVertices, size_t stride, Bounds* bounds);
+
+// Radius of a sphere around the model origin that contains the bounds under any rotation
+float boundsOriginRadius(const Bounds* bounds);
+
+#endif
\ No newline at end of file
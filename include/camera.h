@@ -9,6 +9,8 @@ typedef struct{
     // Angles
     float angleX;
     float angleY;
+    // Position, set with the view matrix
+    vec3 position;
     // View matrix
     mat4 viewMatrix;  
 } Camera;
@@ -0,0 +1,105 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+#include <cglm/cglm.h>
+#include "../glad/glad.h"
+#include "../include/orbit.h"
+#include "../include/obj_loader.h"
+#include <stdint.h>
+
+// Detail levels are switched when their error covers this many pixels
+#define LOD_PIXEL_ERROR 1.0f
+
+// How invisible bodies are rejected
+typedef enum {
+    CULL_NONE, // Everything is drawn at full detail
+    CULL_CPU,  // SIMD sphere tests over the orbit positions
+    CULL_GPU   // Transform feedback pass that compacts the visible body indices
+} CullMode;
+
+// Planes of the view frustum, xyz is the normal pointing inside, w the distance
+typedef struct {
+    vec4 planes[6];
+} Frustum;
+
+// A contiguous range of bodies drawn with the same mesh
+typedef struct {
+    int firstBody;
+    int numBodies;
+    float radius; // Bounding sphere around each body's position
+
+    // Detail levels of the mesh, each visible body is given one
+    int numLods;
+    float lodError[MAX_LODS];
+
+    // Visible body indices, read as the per instance attribute 3 of the render VAO
+    // One region of numBodies indices per detail level
+    GLuint indexVBO;
+    GLuint* cpuIndices;
+
+    // Distance key of every entry of cpuIndices, and room to radix sort one level's region
+    uint32_t* sortKeys;
+    uint32_t* tempKeys;
+    uint32_t* tempIndices;
+
+    // Counters of the last cull, lodVisible is the instance count of each level
+    int visible;
+    int culled;
+    int lodVisible[MAX_LODS];
+    float nearest; // Distance of the closest visible body, 0 when unknown (GPU or no culling)
+
+    // Primitives written by the GPU pass, one per level
+    GLuint queries[MAX_LODS];
+} CullBatch;
+
+typedef struct {
+    CullMode mode;
+    Frustum frustum;
+
+    // Visible bodies of each level are drawn nearest first, so the depth test rejects what they hide
+    // Only the CPU path sorts, the GPU one emits in body order
+    int frontToBack;
+
+    // Turns a level's error into the distance it can be used from
+    float lodScale;
+
+    // GPU path
+    GLuint program;
+    GLuint emptyVAO;
+    GLint firstBodyLoc;
+    GLint radiusLoc;
+    GLint planesLoc;
+    GLint cameraPosLoc;
+    GLint minDistanceLoc;
+    GLint maxDistanceLoc;
+} Culler;
+
+// Prepares the culler, the GPU mode falls back to CPU if its shaders fail
+// The body matrices are read from texture unit matrixUnit on the GPU path
+void initCuller(Culler* culler, CullMode mode, int matrixUnit);
+
+// Sets the projection used to pick detail levels
+void setCullerProjection(Culler* culler, mat4 projection, int screenHeight);
+
+// Creates the index buffer of a batch and sets it as attribute 3 (divisor 1) of the given VAO
+// lods may be NULL for meshes with a single level
+// 0 on failure, the batch is left empty and draws nothing, 1 on success
+int initCullBatch(CullBatch* batch, GLuint vao, int firstBody, int numBodies, float radius, const MeshLod* lods, int numLods);
+
+// Points attribute 3 of the bound VAO at the visible bodies of the given level
+void bindCullBatchLod(CullBatch* batch, int lod);
+
+// Extracts the six planes from a projection * view matrix
+void extractFrustum(mat4 viewProjection, Frustum* frustum);
+
+// Tests every body of the given batches and fills their visible index lists
+// Each visible body goes to the coarsest level whose error stays under LOD_PIXEL_ERROR
+// The orbit matrices of this frame must already be written
+void cullBodies(Culler* culler, OrbitSystem* orbits, float time, mat4 viewProjection, vec3 cameraPos,
+                CullBatch* batches, int numBatches);
+
+// Frees the GPU objects
+void freeCullBatch(CullBatch* batch);
+void freeCuller(Culler* culler);
+
+#endif
\ No newline at end of file
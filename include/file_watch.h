@@ -0,0 +1,37 @@
+#ifndef FILE_WATCH_H
+#define FILE_WATCH_H
+
+#include <time.h>
+
+// Most files one watcher can follow
+#define MAX_WATCHED_FILES 32
+#define WATCH_PATH_LENGTH 256
+
+// Reports files that were written since the last poll, never blocks
+// Uses inotify on Linux, watching the parent directory so editors that save by renaming are caught
+// Elsewhere it falls back to comparing modification times
+typedef struct {
+    int fd; // inotify descriptor, -1 when polling modification times
+    int numFiles;
+    char paths[MAX_WATCHED_FILES][WATCH_PATH_LENGTH];
+    const char* names[MAX_WATCHED_FILES]; // File name part of each path
+    int watches[MAX_WATCHED_FILES];       // inotify watch of each file's directory
+    time_t modified[MAX_WATCHED_FILES];
+} FileWatcher;
+
+// Sets up an empty watcher
+// 0 on failure, 1 on success
+int initFileWatcher(FileWatcher* watcher);
+
+// Starts following a file
+// Returns its id, -1 on failure
+int watchFile(FileWatcher* watcher, const char* path);
+
+// Writes the ids of the files changed since the last call, each id at most once
+// Returns how many were written
+int pollFileChanges(FileWatcher* watcher, int* changed, int maxChanged);
+
+// Stops following every file
+void freeFileWatcher(FileWatcher* watcher);
+
+#endif
\ No newline at end of file
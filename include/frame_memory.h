@@ -0,0 +1,81 @@
+#ifndef FRAME_MEMORY_H
+#define FRAME_MEMORY_H
+
+#include <stddef.h>
+
+// Room of the frame arenas at startup, they grow to the busiest frame they see
+#define FRAME_ARENA_SIZE (256 * 1024)
+
+// Allocations from an arena are aligned to this, enough for any scalar or vec4
+#define ARENA_ALIGNMENT 16
+
+// Block a full arena allocates past its end, freed at the next reset
+typedef struct ArenaOverflow {
+    struct ArenaOverflow* next;
+} ArenaOverflow;
+
+// Linear allocator, allocating moves an offset and resetting frees everything at once
+// One is reset every frame for scratch data, the frame mailbox pairs one with each of its packets
+// A frame that does not fit is served from overflow blocks, and the next reset grows the arena to what that frame used
+// so once it has seen the busiest frame, allocating never reaches the heap
+typedef struct {
+    unsigned char* base;
+    size_t capacity;
+    size_t used;
+    size_t overflowUsed;     // Bytes served from overflow blocks since the last reset
+    ArenaOverflow* overflow;
+
+    // Counters since the last read
+    size_t peak;             // Most bytes in use at once, overflow included
+    int grown;               // Resets that had to grow the arena
+} Arena;
+
+// Fixed size blocks taken from and given back to a free list, for nodes created and destroyed in any order
+// All blocks are allocated up front, an empty pool returns NULL instead of growing
+typedef struct {
+    unsigned char* blocks;
+    size_t blockSize;
+    int capacity;
+    void* freeList;
+    int used;
+    int peak;
+    int exhausted;           // Allocations refused since the last read
+} Pool;
+
+// Heap calls made through malloc, calloc, realloc and free by this program's code
+typedef struct {
+    long long allocations;   // malloc, calloc and realloc
+    long long frees;
+    long long bytes;         // Requested by the allocations
+} HeapCounters;
+
+// Allocates the arena's first block
+// 0 on failure, 1 on success
+int initArena(Arena* arena, size_t capacity);
+
+// Returns size bytes aligned to ARENA_ALIGNMENT, valid until the next reset
+// NULL only if an overflow block could not be allocated either
+void* arenaAlloc(Arena* arena, size_t size);
+
+// Frees everything allocated since the last reset, growing the arena if the frame overflowed it
+void resetArena(Arena* arena);
+
+void freeArena(Arena* arena);
+
+// Allocates room for capacity blocks of blockSize bytes
+// 0 on failure, 1 on success
+int initPool(Pool* pool, size_t blockSize, int capacity);
+
+// Returns a free block, NULL when all of them are taken
+void* poolAlloc(Pool* pool);
+
+// Gives a block back
+void poolFree(Pool* pool, void* block);
+
+void freePool(Pool* pool);
+
+// Copies the heap counters, then resets them if asked
+// Only counts calls from objects linked with the makefile's --wrap flags
+void readHeapCounters(HeapCounters* counters, int reset);
+
+#endif
\ No newline at end of file
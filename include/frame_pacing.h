@@ -0,0 +1,62 @@
+#ifndef FRAME_PACING_H
+#define FRAME_PACING_H
+
+// How frames are spaced out
+typedef enum {
+    PACING_VSYNC,    // Swap waits for every vertical blank
+    PACING_ADAPTIVE, // Same, but a late frame swaps at once and tears instead of waiting a whole blank
+    PACING_UNCAPPED, // No waiting, for benchmarks
+    PACING_CAPPED,   // No vsync, each frame is held until its deadline by a sleep and a short spin
+    PACING_MODES
+} PacingMode;
+
+// The sleep is cut short by this much, and the rest is spun, so the OS waking the thread late does not miss the deadline
+// The margin grows with the worst oversleep seen and shrinks back slowly
+#define PACING_MIN_MARGIN 0.0002
+#define PACING_MAX_MARGIN 0.004
+
+typedef struct {
+    PacingMode mode;
+    double interval; // Capped mode, seconds between frames
+    double deadline; // When the next capped frame may be presented
+    double margin;
+
+    // Intervals between presents since the last read, their spread is the jitter
+    double lastPresent;
+    int samples;
+    double sum;
+    double sumSquares;
+    double worst;
+
+    // Time spent waiting in the capped mode since the last read
+    double slept;
+    double spun;
+} FramePacer;
+
+// Averages since the last read, in milliseconds
+typedef struct {
+    int frames;
+    double meanInterval;
+    double jitter; // Standard deviation of the intervals
+    double worstInterval;
+    double slept;  // Per frame
+    double spun;   // Per frame
+} FramePacingStats;
+
+// Sets the swap interval of the current context for the mode, capFps is only used by PACING_CAPPED
+// Adaptive vsync falls back to plain vsync without the swap tear extension
+void initFramePacer(FramePacer* pacer, PacingMode mode, double capFps);
+
+// Holds the frame until its deadline in the capped mode, call right before swapping
+void paceFrame(FramePacer* pacer);
+
+// Records the interval since the last present, call right after swapping
+void recordFramePresented(FramePacer* pacer);
+
+// Copies the statistics since the last read, then resets them
+void readFramePacingStats(FramePacer* pacer, FramePacingStats* stats);
+
+// Name of a mode for the window title
+const char* pacingModeName(PacingMode mode);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,71 @@
+#ifndef FRAME_PACKET_H
+#define FRAME_PACKET_H
+
+#include <cglm/cglm.h>
+#include <pthread.h>
+#include "../include/frame_memory.h"
+
+// Longest window title the render thread can hand over
+#define MAX_TITLE_LENGTH 1024
+
+// Everything the render thread needs from input and simulation to draw one frame
+// Written by the main thread, then only read until the render thread takes the next one
+typedef struct {
+    mat4 view;
+    vec3 cameraPosition;
+    float time;        // Interpolated simulation time to draw at
+    int steps;         // Simulation steps taken for this frame
+    double dropped;    // Simulation time dropped by the catch-up clamp, in seconds
+    int cycleFiltering;
+    int switchRenderPath;
+    int quit;          // Last packet, the render thread frees everything and stops
+
+    // Variable length data the packet points to, lives as long as the packet and is reset when it is filled again
+    Arena* arena;
+} FramePacket;
+
+// Two packets, so the main thread fills one while the render thread draws the other
+// The main thread is never more than one frame ahead
+typedef struct {
+    FramePacket packets[2];
+    Arena arenas[2];
+    int writeIndex;  // Packet the main thread fills next
+    int readIndex;   // Packet the render thread draws
+    int pending;     // A submitted packet the render thread has not taken yet
+    int finished;    // The render thread stopped, no packet will be taken again
+
+    // Title for the window, which only the main thread may change
+    char title[MAX_TITLE_LENGTH];
+    int titleChanged;
+
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+} FrameMailbox;
+
+// Allocates the packets' arenas
+// 0 on failure, 1 on success
+int initFrameMailbox(FrameMailbox* mailbox);
+
+// Main thread: waits until the render thread has taken the last packet and returns the next one to fill
+// Its arena is reset, what the render thread may still read is in the other packet's
+// NULL once the render thread has finished
+FramePacket* beginFramePacket(FrameMailbox* mailbox);
+
+// Main thread: hands the filled packet over
+void submitFramePacket(FrameMailbox* mailbox);
+
+// Render thread: waits for a submitted packet and takes it, it stays valid until the next call
+const FramePacket* acquireFramePacket(FrameMailbox* mailbox);
+
+// Render thread: marks it stopped, wakes the main thread if it waits for it
+void finishFrameMailbox(FrameMailbox* mailbox);
+
+// Render thread: leaves a title for the main thread to set
+void postWindowTitle(FrameMailbox* mailbox, const char* title);
+
+// Main thread: copies the title left since the last call, 0 if there is none
+int takeWindowTitle(FrameMailbox* mailbox, char* title, int size);
+
+void freeFrameMailbox(FrameMailbox* mailbox);
+
+#endif
\ No newline at end of file
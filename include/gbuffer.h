@@ -0,0 +1,36 @@
+#ifndef GBUFFER_H
+#define GBUFFER_H
+
+#include "../glad/glad.h"
+
+// Surfaces of the lit bodies, written by the G-buffer variant of the scene program and lit in one fullscreen pass
+// 16 bytes per pixel: albedo, octahedral normal, material and light, depth
+typedef struct {
+    GLuint framebuffer;
+    GLuint albedo;  // SRGB8_ALPHA8, the image color and its alpha
+    GLuint surface; // RGBA16UI, octahedral normal in xy, material index in z, body light + 1 in w
+    GLuint depth;   // DEPTH_COMPONENT24, same format as the HDR target's so it can be blitted there
+    int width, height;
+
+    // The lighting pass reads no attributes, but core profile needs a VAO to draw
+    GLuint vao;
+} GBuffer;
+
+// Creates the targets at the given size
+// 0 on failure, 1 on success
+int initGBuffer(GBuffer* gbuffer, int width, int height);
+
+// Binds the G-buffer units, the lighting pass reads the three textures from them
+void bindGBufferTextures(const GBuffer* gbuffer, int albedoUnit, int surfaceUnit, int depthUnit);
+
+// Binds and clears the G-buffer, draw the lit bodies with the G-buffer variant after this
+void beginGBuffer(const GBuffer* gbuffer);
+
+// Copies the depth into the given framebuffer and draws the fullscreen lighting pass into it
+// The lighting program must be in use, bodies drawn forward afterwards are depth tested against the G-buffer's
+void lightGBuffer(const GBuffer* gbuffer, GLuint targetFramebuffer);
+
+// Frees the targets
+void freeGBuffer(GBuffer* gbuffer);
+
+#endif
\ No newline at end of file
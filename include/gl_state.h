@@ -0,0 +1,37 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include "../glad/glad.h"
+
+// Kinds of state the cache tracks, each with its own counters
+typedef enum {
+    STATE_PROGRAM,
+    STATE_VERTEX_ARRAY,
+    STATE_BUFFER,
+    STATE_TEXTURE, // Active unit and the texture of each unit and target
+    STATE_SAMPLER,
+    STATE_UNIFORM, // Single int and float values, per program and location
+    STATE_KINDS
+} GLStateKind;
+
+// Calls dropped because the state was already set (hits) and calls passed to the driver (misses)
+typedef struct {
+    long long hits[STATE_KINDS];
+    long long misses[STATE_KINDS];
+} GLStateCounters;
+
+// Replaces GLAD's binding and uniform entry points with ones that skip calls setting what is already set
+// Every later call of the calling thread goes through the cache, other threads' contexts call the driver directly
+// Must be called once, after gladLoadGLLoader, with the context current
+void installGLStateCache(void);
+
+// Forgets every tracked value, for state changed without going through GLAD
+void invalidateGLStateCache(void);
+
+// Copies the counters since the last reset, then resets them if asked
+void readGLStateCounters(GLStateCounters* counters, int reset);
+
+// Name of a kind for printing
+const char* glStateKindName(GLStateKind kind);
+
+#endif
\ No newline at end of file
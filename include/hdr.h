@@ -0,0 +1,46 @@
+#ifndef HDR_H
+#define HDR_H
+
+#include "../glad/glad.h"
+
+// Color formats of the HDR target
+typedef enum {
+    HDR_RGBA16F,    // 8 bytes per pixel
+    HDR_R11G11B10F, // 4 bytes per pixel, no alpha and less precision, half the bandwidth
+    HDR_FORMATS
+} HdrFormat;
+
+// Offscreen target the scene is lit into, in linear space and unclamped
+// One fullscreen pass tonemaps it and writes the window in sRGB, the only time it is read
+typedef struct {
+    GLuint framebuffer;
+    GLuint color; // Texture of the chosen format
+    GLuint depth; // Renderbuffer, never read
+    int width, height;
+    HdrFormat format;
+
+    // Tonemap pass
+    GLuint program;
+    GLuint vao; // Empty, the fullscreen triangle comes from gl_VertexID
+    GLint exposureLoc;
+    int unit;
+    int encodeSrgb; // The window's framebuffer is not sRGB, the shader encodes instead
+} HdrTarget;
+
+// Creates the target at the window's size and loads the tonemap program, the color is read from the given texture unit
+// 0 on failure, 1 on success
+int initHdrTarget(HdrTarget* target, int width, int height, HdrFormat format, int unit);
+
+// Binds the target and its viewport, clear and draw the scene after this
+void beginHdrTarget(const HdrTarget* target);
+
+// Tonemaps the target into the window's framebuffer and leaves that bound
+void resolveHdrTarget(const HdrTarget* target, float exposure);
+
+// Name for the window title
+const char* hdrFormatName(HdrFormat format);
+
+// Frees the target and the program
+void freeHdrTarget(HdrTarget* target);
+
+#endif
\ No newline at end of file
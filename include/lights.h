@@ -0,0 +1,76 @@
+#ifndef LIGHTS_H
+#define LIGHTS_H
+
+#include <cglm/cglm.h>
+#include "../glad/glad.h"
+#include "../include/orbit.h"
+
+// The view is split into screen tiles and depth slices, each fragment only loops over its cluster's lights
+// Must match the CLUSTER_ defines in fragment.glsl
+#define CLUSTER_TILES_X 16
+#define CLUSTER_TILES_Y 12
+#define CLUSTER_SLICES 24
+#define CLUSTER_COUNT (CLUSTER_TILES_X * CLUSTER_TILES_Y * CLUSTER_SLICES)
+
+// Lights kept per cluster, the first lights win, so the cost of a fragment stays bounded however many there are
+#define MAX_CLUSTER_LIGHTS 32
+
+// Point lights that follow bodies, assigned to the clusters of the view on the CPU every frame
+typedef struct {
+    int numLights;
+
+    // One entry per light (structure of arrays), set by the caller after initLightSystem
+    int* body;     // Body whose position the light has
+    float* range;  // Distance past which it adds nothing
+    float* colorR; // Color times intensity
+    float* colorG;
+    float* colorB;
+
+    // View space positions of the last update
+    float* viewX;
+    float* viewY;
+    float* viewZ;
+
+    // Clusters each light touches, x0 x1 y0 y1 z0 z1, x0 is -1 when it is outside the view
+    int* bounds;
+
+    // Slices grow exponentially with depth, slice = log(depth / near) * sliceScale
+    float near, far;
+    float sliceScale;
+    float projX, projY;          // Projection scale of x and y
+    float tileWidth, tileHeight; // In pixels
+
+    // Lights of each cluster, count entries of indices from offset
+    GLuint* grid; // Offset and count per cluster
+    GLuint* indices;
+    int indexCapacity;
+    float* lightData; // Upload of the lights, two texels each
+
+    // Read by the fragment shader through buffer textures
+    GLuint lightBuffer, lightTexture; // RGBA32F, position and range, then color
+    GLuint gridBuffer, gridTexture;   // RG32UI, offset and count of each cluster
+    GLuint indexBuffer, indexTexture; // R32UI, light indices
+
+    // Counters of the last update
+    int assigned; // Light indices over every cluster
+    int occupied; // Clusters with at least one light
+} LightSystem;
+
+// Allocates the arrays and buffers for the given amount of lights
+// 0 on failure, 1 on success
+int initLightSystem(LightSystem* lights, int numLights);
+
+// Sets the projection and screen size the clusters divide, near and far must be the projection's planes
+void setLightProjection(LightSystem* lights, mat4 projection, float near, float far, int width, int height);
+
+// Sets the cluster uniforms of the scene program, the buffers are read from the given texture units
+void setLightUniforms(const LightSystem* lights, GLuint program, int lightUnit, int gridUnit, int indexUnit);
+
+// Moves every light to its body, assigns the lights to clusters and uploads the lists
+// The orbit positions (posX, posY, posZ) of this frame must already be calculated
+void updateLightClusters(LightSystem* lights, const OrbitSystem* orbits, mat4 view);
+
+// Frees the arrays and GPU objects of the system
+void freeLightSystem(LightSystem* lights);
+
+#endif
\ No newline at end of file
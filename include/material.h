@@ -0,0 +1,47 @@
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include "../include/mtl_loader.h"
+#include "../include/texture_atlas.h"
+#include "../include/virtual_texture.h"
+#include "../glad/glad.h"
+
+// Uniform block binding of the material table, shaders declare it as "Materials"
+#define MATERIAL_BINDING 0
+
+// One material in std140 layout, matches the Material struct in fragment.glsl
+typedef struct {
+    float ambient[4];  // w unused
+    float diffuse[4];  // w is the dissolve
+    float specular[4]; // w is the shininess
+    float maps[4];     // x diffuse image, y bump image in the atlas, -1 without, VIRTUAL_IMAGE when streamed, zw unused
+} GpuMaterial;
+
+// Every material of a library on the GPU, selected per draw with an index instead of separate uniforms
+typedef struct {
+    GLuint ubo;
+    int numMaterials;
+    // Atlas image of each material's map_Kd and map_Bump, -1 without
+    int diffuseImages[MAX_MATERIALS];
+    int bumpImages[MAX_MATERIALS];
+    // Diffuse map streamed by the virtual texture instead of packed in the atlas, empty for none
+    char virtualMap[MATERIAL_PATH_LENGTH];
+} MaterialTable;
+
+// Uploads the library and adds its diffuse and bump maps to the atlas, an empty library gets one default material
+// A diffuse map equal to virtualMap gets VIRTUAL_IMAGE instead, NULL when nothing is streamed
+// Binds the table to MATERIAL_BINDING
+// Returns 1 if images were added, the atlas must then be built before drawing
+int initMaterialTable(MaterialTable* table, const MaterialLibrary* library, TextureAtlas* atlas, const char* virtualMap);
+
+// Uploads a changed library, maps already in the atlas keep their image
+// Returns 1 if images were added, the atlas must then be built again
+int updateMaterialTable(MaterialTable* table, const MaterialLibrary* library, TextureAtlas* atlas);
+
+// Points a program's "Materials" block at the table
+void bindMaterialTable(GLuint program);
+
+// Frees the buffer, the images stay in the atlas
+void freeMaterialTable(MaterialTable* table);
+
+#endif
\ No newline at end of file
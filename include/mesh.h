@@ -0,0 +1,45 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include "../include/obj_loader.h"
+#include "../glad/glad.h"
+
+// Where a mesh lives inside a MeshBuffer
+typedef struct {
+    int baseVertex;
+    int numLods;
+    int numSubmeshes;
+    MeshLod lods[MAX_LODS]; // Index offsets are into the whole buffer
+} MeshRange;
+
+// Vertices and indices of several meshes merged into one buffer pair, read through one VAO
+// Every mesh uses the Vertex layout, so switching meshes needs no state changes
+typedef struct {
+    GLuint vao;
+    GLuint vbo;
+    GLuint ebo;
+    int numVertices;
+    int numIndices;
+} MeshBuffer;
+
+// Uploads the given meshes back to back and fills one range per mesh
+// The objects can be freed afterwards
+void initMeshBuffer(MeshBuffer* buffer, const LoadedObject* objects, int numObjects, MeshRange* ranges);
+
+// Replaces the contents of the buffer with new meshes, filling the ranges again
+// The VAO and buffer IDs stay the same, storage is only reallocated when the size changes
+void updateMeshBuffer(MeshBuffer* buffer, const LoadedObject* objects, int numObjects, MeshRange* ranges);
+
+// Sets the Vertex attributes (0 to 2, and 4) of the bound VAO for the bound array buffer
+void setVertexFormat(void);
+
+// Draws a detail level of a mesh, the buffer's VAO must be bound
+void drawMeshInstanced(const MeshRange* range, int lod, int instanceCount);
+
+// Draws one submesh of a detail level, the buffer's VAO must be bound
+void drawSubmeshInstanced(const MeshRange* range, int lod, int submesh, int instanceCount);
+
+// Frees the GPU objects
+void freeMeshBuffer(MeshBuffer* buffer);
+
+#endif
\ No newline at end of file
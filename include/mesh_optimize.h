@@ -0,0 +1,18 @@
+#ifndef MESH_OPTIMIZE_H
+#define MESH_OPTIMIZE_H
+
+#include "../include/vertex.h"
+
+// Size of the post transform cache the triangle order is tuned for
+#define VERTEX_CACHE_SIZE 16
+
+// Reorders the triangles so consecutive ones reuse recently transformed vertices (Tipsify)
+// 0 when its working memory could not be allocated, the indices are left in their order, 1 on success
+int optimizeVertexCache(unsigned int* indices, int indexCount, int vertexCount);
+
+// Reorders the vertices in the order the indices first use them, and rewrites the indices
+// Vertices no index uses are dropped. Returns the new vertex count
+// 0 when its working memory could not be allocated, the vertices and indices are left as they were
+int optimizeVertexFetch(Vertex* vertices, unsigned int* indices, int indexCount, int vertexCount);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,75 @@
+#ifndef MIPMAP_H
+#define MIPMAP_H
+
+#include "../glad/glad.h"
+
+// Enough levels for a 32768 texel side
+#define MAX_MIP_LEVELS 16
+
+// Space the texels are averaged in
+typedef enum {
+    MIP_SRGB,  // Color, channels other than alpha are decoded from sRGB before filtering
+    MIP_LINEAR // Data such as height maps, filtered as stored
+} MipSpace;
+
+// Texels [x0, x1) x [y0, y1) of one level
+typedef struct {
+    int x0, y0, x1, y1;
+} MipRect;
+
+// Every level of an image down to 1x1, level 0 is the caller's pixels and is not owned
+typedef struct {
+    unsigned char* levels[MAX_MIP_LEVELS];
+    int widths[MAX_MIP_LEVELS];
+    int heights[MAX_MIP_LEVELS];
+    int numLevels;
+    int channels;
+    MipSpace space; // Of the chain as a whole, color chains upload to sRGB formats
+} MipChain;
+
+// Filters a level into the next one, max(1, width / 2) by max(1, height / 2) texels
+// Each texel averages exactly the source area it covers, so odd sizes weigh their edge texels instead of dropping them
+// Needs no GL context, so it can run on any thread
+void downsampleMip(const unsigned char* src, int width, int height, unsigned char* dest, int channels, MipSpace space);
+
+// Filters every level below the pixels, 1 to 4 channels of 8 bits
+// 0 on failure, 1 on success
+int generateMipChain(const unsigned char* pixels, int width, int height, int channels, MipSpace space, MipChain* chain);
+
+// Filters one rectangle of level 0 down the chain again in another space, for layers mixing color and data images
+// Texels along the edge of the rectangle mix with their neighbours like in the first pass
+void refilterMipRegion(MipChain* chain, int x, int y, int width, int height, MipSpace space);
+
+// Levels of one rectangle of a bigger image, filtered without the rest of it
+// Each level holds only the texels whose whole source lies in the rectangle, so they match the full chain exactly
+typedef struct {
+    MipChain mips;                // Level k holds rects[k] of the full chain's level k, level 0 is not owned
+    MipRect rects[MAX_MIP_LEVELS];
+} MipRegion;
+
+// Filters the levels of rect of a width x height image, pixels hold only the rect
+// Stops at the first level where the rect has no texel of its own
+// Needs no GL context, so it can run on any thread
+// 0 on failure, 1 on success
+int generateMipRegion(const unsigned char* pixels, int width, int height, MipRect rect, int channels, MipSpace space,
+                      MipRegion* region);
+
+// Copies a region into the chain of the whole image, then filters the texels around it that mix it with its neighbours
+// changed gets the texels of every level of the chain that were written, empty below the last one
+void spliceMipRegion(MipChain* chain, const MipRegion* region, MipRect* changed);
+
+// Frees the levels below level 0
+void freeMipRegion(MipRegion* region);
+
+// Uploads every level of the chain to the bound 2D texture, its format comes from the channels and the space
+// Grey and alpha color is stored as RGBA, so the sampler decodes the grey from sRGB and leaves alpha linear
+void uploadMipChain(const MipChain* chain);
+
+// Replaces the pixels of every level of the bound 2D texture, which must already have the chain's sizes
+// For textures whose storage can not change, such as ones with bindless handles
+void replaceMipChain(const MipChain* chain);
+
+// Frees the levels below level 0
+void freeMipChain(MipChain* chain);
+
+#endif
\ No newline at end of file
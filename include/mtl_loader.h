@@ -1,17 +1,37 @@
 #ifndef MTL_LOADER_H
 #define MTL_LOADER_H
 
-// Holds material data for the planet
+// Most materials one MTL file can hold
+#define MAX_MATERIALS 16
+#define MATERIAL_NAME_LENGTH 64
+#define MATERIAL_PATH_LENGTH 256
+
+// Holds the data of one newmtl block
 typedef struct {
+    char name[MATERIAL_NAME_LENGTH];
     float Ka[3]; // Ambient color
     float Kd[3]; // Diffuse color
     float Ks[3]; // Specular color
     float Ns;    // Specular exponent (shininess)
     float d;     // Dissolve (transparency)
     int illum;   // Illumination model
+    // Texture maps, relative to the working directory, empty when not given
+    char diffuseMap[MATERIAL_PATH_LENGTH]; // map_Kd
+    char bumpMap[MATERIAL_PATH_LENGTH];    // map_Bump
 } MaterialData;
 
-// Loads data from the given mtl file to the material data struct
-int loadMtl(const char* path, MaterialData* materialData);
+// Every material of an MTL file, in file order
+typedef struct {
+    MaterialData materials[MAX_MATERIALS];
+    int numMaterials;
+} MaterialLibrary;
+
+// Loads every material of the given mtl file into the library
+// 0 on failure, 1 on success
+int loadMtl(const char* path, MaterialLibrary* library);
+
+// Finds a material by its newmtl name
+// Returns its index, -1 if there is none
+int findMaterial(const MaterialLibrary* library, const char* name);
 
 #endif
\ No newline at end of file
@@ -2,12 +2,37 @@
 #define OBJ_LOADER_H
 
 #include "../include/vertex.h"
+#include "../include/bounds.h"
+#include "../include/mtl_loader.h"
 #include "../glad/glad.h"
 
+// Most detail levels a mesh can have, level 0 is the full mesh
+#define MAX_LODS 5
+
+// Most materials one object can use
+#define MAX_SUBMESHES 8
+
+// One detail level, a range of the object's indices
+typedef struct {
+    int indexOffset;
+    int numIndices;
+    float error; // Largest deviation from the full mesh, in model units
+    int submeshIndices[MAX_SUBMESHES]; // Index count of each submesh, back to back from indexOffset
+} MeshLod;
+
 // Holds loaded object data
 typedef struct {
     Vertex* vertices; 
     int numVertices;
+    // Triangles, the index ranges of every detail level back to back
+    unsigned int* indices;
+    int numIndices;
+    MeshLod lods[MAX_LODS];
+    int numLods;
+    Bounds bounds; // Used for culling
+    // Triangles of every level are grouped by material, one submesh per usemtl name in first use order
+    char submeshMaterials[MAX_SUBMESHES][MATERIAL_NAME_LENGTH]; // Empty for faces without usemtl
+    int numSubmeshes;
 } LoadedObject;
 
 // Loads an OBJ file from the given path into the provided LoadedObject structure
@@ -0,0 +1,64 @@
+#ifndef ORBIT_H
+#define ORBIT_H
+
+#include <cglm/cglm.h>
+#include "../glad/glad.h"
+
+// Every body circles its parent (or the origin) on the XZ plane and spins around SPIN_AXIS.
+// Only one level of parenting is supported, a parent can't have a parent of its own.
+typedef struct {
+    int numBodies;
+
+    // Orbit parameters, one entry per body (structure of arrays)
+    float* radius;  // Distance from the parent
+    float* phase;   // Starting angle on the orbit
+    float* speed;   // Angular speed of the orbit
+    float* spin;    // Angular speed of the self rotation
+    int* parent;    // Index of the parent body, -1 orbits the origin
+
+    // World positions of the last updateOrbitPositions call (structure of arrays)
+    float* posX;
+    float* posY;
+    float* posZ;
+
+    // Use the transform feedback path instead of the CPU one
+    int useGPU;
+
+    // Transform feedback program and its uniforms
+    GLuint program;
+    GLint timeLoc;
+    GLint spinAxisLoc;
+
+    // Per body parameters read by the transform feedback pass
+    GLuint paramsVAO;
+    GLuint paramsVBO;
+
+    // One model matrix per body, written by either path
+    // Read by the shaders through matrixTexture, a RGBA32F buffer texture (four texels per body)
+    GLuint matrixVBO;
+    GLuint matrixTexture;
+    mat4* cpuMatrices;
+} OrbitSystem;
+
+// Allocates the parameter arrays for the given amount of bodies
+// 0 on failure, 1 on success
+int initOrbitSystem(OrbitSystem* orbits, int numBodies);
+
+// Uploads the body parameters and creates the GPU buffers
+// Must be called once all bodies are set. Falls back to the CPU path if the feedback shader fails
+void uploadOrbitSystem(OrbitSystem* orbits, int useGPU);
+
+// Advances every body to the given time and writes its model matrix to matrixVBO
+void updateOrbits(OrbitSystem* orbits, float time);
+
+// Calculates the position of a single body on the CPU
+void getOrbitPosition(OrbitSystem* orbits, int body, float time, vec3 dest);
+
+// Calculates the positions of every body on the CPU into posX, posY, posZ
+// Done by updateOrbits on the CPU path, needed separately by CPU culling on the GPU path
+void updateOrbitPositions(OrbitSystem* orbits, float time);
+
+// Frees the arrays and GPU objects of the system
+void freeOrbitSystem(OrbitSystem* orbits);
+
+#endif
\ No newline at end of file
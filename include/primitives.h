@@ -0,0 +1,21 @@
+#ifndef PRIMITIVES_H
+#define PRIMITIVES_H
+
+#include "../include/obj_loader.h"
+
+// Most subdivisions allowed, level n has 20 * 4^n triangles
+#define MAX_ICOSPHERE_SUBDIVISIONS 7
+
+// Generates a sphere of the given radius by subdividing an icosahedron, centered on the origin
+// UVs are equirectangular like a UV sphere texture, vertices are split on the seam and at the poles
+// Fills the same structure as loadObj, freed with freeObj
+// 0 on failure, 1 on success
+int generateIcosphere(int subdivisions, float radius, LoadedObject* returnObject);
+
+// Generates an axis aligned cube with the given edge length, centered on the origin
+// Four vertices per face so every face keeps its own normal and a full 0 to 1 UV square
+// Fills the same structure as loadObj, freed with freeObj
+// 0 on failure, 1 on success
+int generateCube(float size, LoadedObject* returnObject);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,17 @@
+#ifndef RADIX_SORT_H
+#define RADIX_SORT_H
+
+#include <stdint.h>
+
+// Sorts values by their 32 bit keys, ascending and stable, one pass per byte of the keys
+// Passes where every key has the same byte are skipped, so narrow keys cost less
+// tempKeys and tempValues need room for count entries, the result ends up back in keys and values
+void radixSort32(uint32_t* keys, uint32_t* values, int count, uint32_t* tempKeys, uint32_t* tempValues);
+
+// Same for 64 bit keys, eight passes at most
+void radixSort64(uint64_t* keys, uint32_t* values, int count, uint64_t* tempKeys, uint32_t* tempValues);
+
+// Key of a float that sorts like the float itself, for any sign
+uint32_t floatSortKey(float value);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,93 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include "../glad/glad.h"
+#include "../include/mesh.h"
+#include "../include/culling.h"
+#include "../include/frame_memory.h"
+#include <stdint.h>
+
+// Draw keys, most significant bits first: pass (4), then program (6), material (8), mesh (8) and depth (24)
+// Passes that sort by depth put the depth above the program instead
+#define MAX_RENDER_PASSES 16
+#define MAX_QUEUE_PROGRAMS 64
+#define MAX_QUEUE_MATERIALS 256
+#define MAX_QUEUE_MESHES 256
+#define DRAW_DEPTH_BITS 24
+
+// One instanced draw, the instances are a detail level's visible bodies of a batch
+typedef struct {
+    const MeshRange* mesh;
+    int meshId;  // Only used to group draws of the same mesh, below MAX_QUEUE_MESHES
+    int lod;
+    int submesh; // -1 draws every submesh of the level
+    CullBatch* batch;
+    int program; // Slot set with setRenderQueueProgram
+    int material;
+    int isPlanet;
+} DrawCommand;
+
+// A program the queue draws with, and the uniforms it sets per draw
+typedef struct {
+    GLuint program;
+    GLint materialLoc;
+    GLint flagLoc;
+
+    // Last values set, uniforms are program state so they are kept across frames, -1 when unknown
+    int material;
+    int flag;
+} QueueProgram;
+
+// Draws submitted in any order, radix sorted by key and executed pass by pass
+// Storage only grows, so once it has seen the busiest frame submitting allocates nothing
+typedef struct {
+    DrawCommand* commands;
+    uint64_t* keys;
+    uint32_t* order; // Command of each sorted key
+    int count;
+    int capacity;
+
+    // Whether a pass sorts nearest first before state, set once with setRenderPassOrder
+    int depthFirst[MAX_RENDER_PASSES];
+    float depthScale; // Turns a distance into the depth bits
+
+    // Sorted range of each pass, passStart[pass] to passStart[pass + 1]
+    int passStart[MAX_RENDER_PASSES + 1];
+
+    QueueProgram programs[MAX_QUEUE_PROGRAMS];
+
+    // Counters since the last reset
+    int draws;
+    int instances;
+    int stateChanges; // Programs, uniforms and instance ranges bound
+} RenderQueue;
+
+// Allocates room for the given amount of draws, distances past farPlane sort as the farthest
+// 0 on failure, 1 on success
+int initRenderQueue(RenderQueue* queue, int capacity, float farPlane);
+
+// Sets the order of a pass, nearest first before state or state before nearest first
+void setRenderPassOrder(RenderQueue* queue, int pass, int depthFirst);
+
+// Sets the program of a slot and its per draw uniforms, called again whenever the program is replaced
+void setRenderQueueProgram(RenderQueue* queue, int slot, GLuint program, GLint materialLoc, GLint flagLoc);
+
+// Empties the queue and its counters, for the next frame
+void resetRenderQueue(RenderQueue* queue);
+
+// Adds a draw to a pass, depth is the distance of its nearest instance
+// 0 when the queue could not grow, 1 on success
+int submitDraw(RenderQueue* queue, int pass, const DrawCommand* command, float depth);
+
+// Sorts the submitted draws and finds the range of every pass, with scratch memory from the frame's arena
+// 0 when the scratch could not be allocated and every pass is left empty, 1 on success
+int sortRenderQueue(RenderQueue* queue, Arena* scratch);
+
+// Issues the sorted draws of a pass, binding only what differs from the draw before
+// The mesh buffer's VAO must be bound
+void executeRenderPass(RenderQueue* queue, int pass);
+
+// Frees the arrays
+void freeRenderQueue(RenderQueue* queue);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,48 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include "../glad/glad.h"
+
+// EXT_texture_filter_anisotropic, core only from 4.6 so GLAD 3.3 does not have it
+#ifndef GL_TEXTURE_MAX_ANISOTROPY_EXT
+#define GL_TEXTURE_MAX_ANISOTROPY_EXT 0x84FE
+#define GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT 0x84FF
+#endif
+
+// What a texture holds decides how it is filtered
+typedef enum {
+    SAMPLER_COLOR, // Diffuse maps, as sharp as the quality allows
+    SAMPLER_DATA,  // Height maps, LOD bias would change the slopes read from them
+    SAMPLER_CLASSES
+} SamplerClass;
+
+// Quality presets, trading filtering against texture bandwidth
+typedef enum {
+    SAMPLER_LOW,    // Bilinear, no anisotropy, biased towards smaller mip levels
+    SAMPLER_MEDIUM, // Trilinear, 4x anisotropy on color
+    SAMPLER_HIGH,   // Trilinear, 16x anisotropy on color, slightly sharper mip selection
+    SAMPLER_QUALITIES
+} SamplerQuality;
+
+// Sampler objects of every class at every quality, shared by all textures
+// They are never changed after init, so bindless handles made from them stay valid,
+// switching quality only picks other samplers
+typedef struct {
+    GLuint samplers[SAMPLER_QUALITIES][SAMPLER_CLASSES];
+    float maxAnisotropy; // 1 without the extension
+    SamplerQuality quality;
+} SamplerSet;
+
+// Makes the samplers of every preset, anisotropy is capped at what the driver supports
+void initSamplerSet(SamplerSet* set, SamplerQuality quality);
+
+// Sampler of a class at the current quality
+GLuint getSampler(const SamplerSet* set, SamplerClass samplerClass);
+
+// Name of a quality, for logs and the window title
+const char* samplerQualityName(SamplerQuality quality);
+
+// Deletes the samplers
+void freeSamplerSet(SamplerSet* set);
+
+#endif
\ No newline at end of file
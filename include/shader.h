@@ -9,4 +9,14 @@
 GLuint loadShaders(const char* vertex_file_path, const char* fragment_file_path);
 // Once loaded, to free call glDeleteProgram(programID);
 
+// Same as loadShaders, with the defines (for example "#define NORMAL_MAP") added after #version in both stages
+// NULL or an empty string loads the plain program
+GLuint loadShaderVariant(const char* vertex_file_path, const char* fragment_file_path, const char* defines);
+
+// Load and compile a program whose outputs are captured with transform feedback
+// The geometry shader is optional, pass NULL for a vertex only program
+// The varyings are written interleaved, in the given order, to the buffer bound at index 0
+// Returns the program ID, 0 on failure.
+GLuint loadFeedbackShader(const char* vertex_file_path, const char* geometry_file_path, const char** varyings, int varyingCount);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,53 @@
+#ifndef SHADER_RELOAD_H
+#define SHADER_RELOAD_H
+
+#include "../include/file_watch.h"
+#include "../glad/glad.h"
+#include <GLFW/glfw3.h>
+#include <pthread.h>
+
+// Most variants of one shader pair
+#define MAX_SHADER_VARIANTS 8
+
+// Rebuilds every variant of a vertex and fragment program whenever one of its files is saved
+// Compiling and linking happen on a worker thread with a context sharing the window's objects,
+// the drawing thread only swaps in the finished programs once their fence has signaled
+// Without a worker context the rebuild runs on the drawing thread between frames
+typedef struct {
+    const char* vertexPath;
+    const char* fragmentPath;
+    const char* defines[MAX_SHADER_VARIANTS]; // As given to loadShaderVariant
+    int numVariants;
+    GLuint programs[MAX_SHADER_VARIANTS]; // The programs to draw with, only replaced by updateShaderReloader
+
+    FileWatcher watcher;
+
+    // Worker, NULL context when rebuilding between frames
+    GLFWwindow* workerContext;
+    pthread_t worker;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    int requested;
+    int quit;
+
+    // Linked on the worker, not yet swapped in
+    GLuint pending[MAX_SHADER_VARIANTS];
+    GLsync pendingFence;
+} ShaderReloader;
+
+// Starts watching the files of already loaded programs, one per define string, the reloader owns them from now on
+// workerContext is a hidden window sharing the drawing context's objects, created and destroyed by the caller on the main thread
+// NULL rebuilds between frames instead
+// 0 on failure, the programs are still owned but must not be updated, 1 on success
+int initShaderReloader(ShaderReloader* reloader, GLFWwindow* workerContext, const char* vertex_file_path, const char* fragment_file_path,
+                       const char* const* defines, const GLuint* programs, int numVariants);
+
+// Call once per frame on the drawing thread, never waits on the compiler
+// Returns 1 when reloader->programs were replaced, their uniform locations must be looked up again
+// Variants are swapped together, if any fails to compile or link all the current ones are kept
+int updateShaderReloader(ShaderReloader* reloader);
+
+// Stops the worker and deletes the programs
+void freeShaderReloader(ShaderReloader* reloader);
+
+#endif
\ No newline at end of file
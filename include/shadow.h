@@ -0,0 +1,63 @@
+#ifndef SHADOW_H
+#define SHADOW_H
+
+#include "../glad/glad.h"
+#include "../include/orbit.h"
+#include "../include/mesh.h"
+#include <stdint.h>
+
+#define SHADOW_FACES 6
+
+// Casters closer to the light than this are clipped by the faces
+#define SHADOW_NEAR 0.1f
+
+// Omnidirectional shadows of one point light, a depth cube map centered on the body that carries it
+// Every face holds the distance to the light over its range, compared by the lit pass through a samplerCubeShadow
+typedef struct {
+    int size;    // Texels along a face's edge
+    float range; // Distance the faces reach, the light's range
+
+    // The light's body and the contiguous range of bodies that cast, each within casterRadius of its position
+    int lightBody;
+    int firstCaster;
+    int numCasters;
+    float casterRadius;
+
+    GLuint texture; // DEPTH_COMPONENT24 cube map with comparison
+    GLuint framebuffer;
+    GLuint program;
+    GLint faceViewProjectionLoc;
+    GLint lightPosLoc;
+
+    // Casters in each face's frustum, one region of numCasters indices per face, read as attribute 3
+    GLuint indexVBO;
+    GLuint* indices;
+
+    // What each face holds, a face is drawn again only when its casters or the light moved
+    int faceCasters[SHADOW_FACES];
+    uint64_t faceSignature[SHADOW_FACES];
+    int faceValid[SHADOW_FACES];
+
+    // Counters since the caller last reset them
+    int facesDrawn;
+    int facesReused;
+} ShadowMap;
+
+// Creates the cube map and loads the shadow program, the body matrices are read from texture unit matrixUnit
+// 0 on failure, 1 on success
+int initShadowMap(ShadowMap* shadow, int size, float range, int lightBody, int firstCaster, int numCasters,
+                  float casterRadius, int matrixUnit);
+
+// Sets the shadow uniforms of the scene program, the cube map is read from the given unit
+// Programs of a system that failed to initialise, or was never initialised, draw without shadows
+void setShadowUniforms(const ShadowMap* shadow, GLuint program, int unit, int light);
+
+// Culls the casters of every face and draws the faces whose contents changed
+// The orbit positions (posX, posY, posZ) and matrices of this frame must already be calculated
+// Attribute 3 of the given VAO is repointed, after drawing a face framebuffer 0 is left bound with the face's viewport
+void updateShadowMap(ShadowMap* shadow, const OrbitSystem* orbits, float time, GLuint vao, const MeshRange* casterMesh);
+
+// Frees the cube map and the program
+void freeShadowMap(ShadowMap* shadow);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,37 @@
+#ifndef SIM_CLOCK_H
+#define SIM_CLOCK_H
+
+// Steps per second of the simulation, whatever the frame rate, can be changed with --sim-rate N
+#define DEFAULT_SIM_RATE 60.0
+
+// Steps a single frame may catch up on, time beyond them is dropped so one slow frame can't snowball
+#define MAX_CATCHUP_STEPS 5
+
+// Fixed timestep clock, the simulation advances in whole steps and the renderer draws between the last two
+// Step n is always at time n * step, so a run reaches the same states at any frame rate
+typedef struct {
+    double step;
+    int maxSteps;
+    long long ticks;     // Steps taken so far
+    double accumulator;  // Frame time not yet covered by a step
+    double alpha;        // Fraction of a step the renderer is past the previous state, from 0 to 1
+
+    // Counters since the last read
+    int stepsTaken;
+    double timeDropped;
+} SimulationClock;
+
+// Starts at step 0 with the given steps per second
+void initSimulationClock(SimulationClock* clock, double rate, int maxSteps);
+
+// Adds the frame time and takes the steps it covers, at most maxSteps of them
+// Returns the number of steps taken
+int advanceSimulation(SimulationClock* clock, double elapsed);
+
+// Time of the latest step
+double simulationTime(const SimulationClock* clock);
+
+// Time the renderer draws, alpha of the way from the previous step to the latest
+double interpolatedTime(const SimulationClock* clock);
+
+#endif
\ No newline at end of file
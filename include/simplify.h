@@ -0,0 +1,21 @@
+#ifndef SIMPLIFY_H
+#define SIMPLIFY_H
+
+#include "../include/vertex.h"
+#include "../include/obj_loader.h"
+
+// Reduces an indexed triangle mesh towards targetIndexCount with quadric error edge collapses
+// Vertices only move onto other existing vertices, so every result shares the original vertex buffer
+// Vertices on open borders (including UV and normal seams) never move, which keeps the seams closed
+// destination must hold indexCount indices, it may not overlap indices
+// resultError gets the largest deviation introduced, in model units
+// Returns the new index count, -1 when its working memory could not be allocated
+int simplifyMesh(unsigned int* destination, const unsigned int* indices, int indexCount,
+                 const Vertex* vertices, int vertexCount, int targetIndexCount, float* resultError);
+
+// Appends up to maxLods - 1 simplified levels to the object, each with about half the triangles of the previous
+// Stops early once a level can't be reduced much further, or at the last complete level when memory runs out
+// Each submesh is reduced on its own so material borders stay closed and levels stay grouped by material
+void generateLods(LoadedObject* obj, int maxLods);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,19 @@
+#ifndef TANGENTS_H
+#define TANGENTS_H
+
+#include "../include/vertex.h"
+
+// Fills the tangent of every vertex from the triangles' UV directions
+// Follows MikkTSpace's conventions so baked normal maps line up: face tangents are weighted by the corner angle,
+// made orthogonal to the vertex normal, and the bitangent is sign * cross(normal, tangent)
+// Vertices are not split where the tangent frame flips, meshes already split on UV seams match in practice
+// 0 on failure, the tangents are left as they were, 1 on success
+int generateTangents(Vertex* vertices, int vertexCount, const unsigned int* indices, int indexCount);
+
+// Packs a unit vector into two snorm8 octahedral coordinates
+void encodeOctahedral(const float* v, signed char* dest);
+
+// Unpacks two snorm8 octahedral coordinates into a unit vector
+void decodeOctahedral(const signed char* e, float* dest);
+
+#endif
\ No newline at end of file
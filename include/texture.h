@@ -1,11 +1,38 @@
 #ifndef TEXTURE_H
 #define TEXTURE_H
 
+#include "../include/mipmap.h"
 #include "../glad/glad.h"
 
-// Loads a texture from the given file path
+// Decoded pixels of an image file, rows start at the bottom
+typedef struct {
+    unsigned char* pixels;
+    int width;
+    int height;
+    int channels;
+    MipChain mips; // Every level, empty until generateImageMips
+} ImageData;
+
+// Loads a texture from the given file path, with mipmaps filtered on the CPU in sRGB space
+// Wrapping and filtering are left to sampler objects, see sampler.h
 // Returns the texture ID on success, 0 on failure
 GLuint loadTexture(const char* texture_file_path);
 // Once loaded, to free call glDeleteTextures(1, &textureID);
 
+// Reads and decodes an image file, needs no GL context so it can run on any thread
+// 0 on failure, 1 on success
+int loadImage(const char* path, ImageData* image);
+
+// Filters the image's mip levels, needs no GL context so it can run with the decode
+// 0 on failure, 1 on success
+int generateImageMips(ImageData* image, MipSpace space);
+
+// Replaces the contents of a texture with the image and every mip level, the texture keeps its ID
+// An image without mips gets them filtered here, as color
+// Leaves the texture bound to the active unit
+void uploadTexture(GLuint texture, const ImageData* image);
+
+// Frees the decoded pixels and the mips
+void freeImage(ImageData* image);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,121 @@
+#ifndef TEXTURE_ATLAS_H
+#define TEXTURE_ATLAS_H
+
+#include "../include/texture.h"
+#include "../include/sampler.h"
+#include "../glad/glad.h"
+
+// Most images one atlas holds, must match MAX_ATLAS_IMAGES in fragment.glsl
+#define MAX_ATLAS_IMAGES 32
+#define ATLAS_PATH_LENGTH 256
+
+// Uniform block binding of the image table, shaders declare it as "Atlas"
+#define ATLAS_BINDING 1
+
+// Texels around each image copied from its edge, keeps filtering and the first mip levels from bleeding
+#define ATLAS_PADDING 8
+
+// Where an image was packed, in texels of its layer
+typedef struct {
+    char path[ATLAS_PATH_LENGTH];
+    int layer;
+    int x, y; // Corner of the image itself, the padding is around it
+    int width, height;
+    MipSpace space; // Color, or data such as height maps whose mips are filtered linearly
+} AtlasImage;
+
+// One image in std140 layout, matches the AtlasImage struct in fragment.glsl
+typedef struct {
+    float rect[4]; // xy offset, zw size, in UVs of the layer
+    float layer;
+    float padding;
+    GLuint64 handles[SAMPLER_CLASSES]; // Bindless texture of the image with each class's sampler, 0 in the texture array
+    float padding2[2];
+} GpuAtlasImage;
+
+// Every scene image in the layers of one texture array, so draws pick an image by index instead of a bind
+// Color images are sampled from an sRGB array and data images from a linear copy of it
+// Images of the same size get a layer each, smaller ones are packed together on shelves
+// With bindless textures each image is its own resident texture instead, the indices stay the same
+typedef struct {
+    GLuint texture;     // GL_TEXTURE_2D_ARRAY in sRGB, read as color
+    GLuint dataTexture; // Same layers in a linear format, read by the data sampler since one array can not mix the two
+    GLuint ubo;
+    int width, height; // Of every layer
+    int numLayers;
+    AtlasImage images[MAX_ATLAS_IMAGES];
+    int numImages;
+
+    // Every level of every layer, kept so a changed image is spliced in without filtering the rest of its layer
+    unsigned char* layerPixels; // Level 0 of all layers, layerMips point into it
+    MipChain* layerMips;
+
+    // Bindless path, a handle pairs a texture with a sampler
+    int bindless;
+    GLuint samplers[SAMPLER_CLASSES];
+    GLuint imageTextures[MAX_ATLAS_IMAGES];
+    GLuint64 handles[MAX_ATLAS_IMAGES][SAMPLER_CLASSES];
+} TextureAtlas;
+
+// Where an image sits in the texture array, copied so its levels can be filtered without reading the atlas
+typedef struct {
+    int layerWidth, layerHeight;
+    int layer;
+    int x, y; // Corner of the image itself, the padding is around it
+    int width, height;
+    MipSpace space;
+} AtlasSlot;
+
+// Levels of a new image as they sit in its layer, filtered away from the GL thread
+typedef struct {
+    AtlasSlot slot;         // Where they were filtered for, an atlas packed since then ignores them
+    unsigned char* pixels;  // The image and its padding in RGBA
+    MipRegion region;
+} AtlasImageLevels;
+
+// Makes an empty atlas and binds its table to ATLAS_BINDING
+void initTextureAtlas(TextureAtlas* atlas);
+
+// Switches the atlas to bindless textures if the context has ARB_bindless_texture, call before building it
+// Returns 1 if the atlas is bindless, 0 if it stays a texture array
+int useBindlessAtlas(TextureAtlas* atlas);
+
+// Samplers the bindless handles are made with, resident handles are replaced by ones for the new samplers
+// The texture array ignores them, its samplers are bound to the units it is read from
+void setAtlasSamplers(TextureAtlas* atlas, const GLuint* samplers);
+
+// Adds an image file, packed on the next buildTextureAtlas, its mips are filtered in the given space
+// Returns its index, the same one for a path that was already added in the same space, -1 when the atlas is full
+int addAtlasImage(TextureAtlas* atlas, const char* path, MipSpace space);
+
+// Loads every added image and packs them into the texture array, the texture keeps its ID
+// Every mip level is filtered on the CPU, each image in its own space
+// Bindless atlases only load the images added since the last build
+// Images that fail to load are left blank
+// 0 on failure, 1 on success
+int buildTextureAtlas(TextureAtlas* atlas);
+
+// Copies where an image sits
+void getAtlasSlot(const TextureAtlas* atlas, int image, AtlasSlot* slot);
+
+// Filters the levels of a new image as they will sit in the texture array, needs no GL context so it can run on a worker
+// An image of another size leaves levels empty, the atlas is packed again when it is updated
+// 0 on failure, 1 on success
+int filterAtlasImage(const AtlasSlot* slot, const ImageData* data, AtlasImageLevels* levels);
+
+void freeAtlasImageLevels(AtlasImageLevels* levels);
+
+// Replaces one image with new pixels of the same size, in its layer or its own texture
+// Texture array images splice levels made by filterAtlasImage, when they are NULL or the atlas was packed since they are filtered here
+// Bindless images use the mips in data when it has them
+// Returns 0 if the size changed, the atlas must be built again
+// Bindless images of a new size get a new texture and handle instead, so they always return 1
+int updateAtlasImage(TextureAtlas* atlas, int image, const ImageData* data, const AtlasImageLevels* levels);
+
+// Points a program's "Atlas" block at the image table
+void bindTextureAtlas(GLuint program);
+
+// Frees the textures and the table
+void freeTextureAtlas(TextureAtlas* atlas);
+
+#endif
\ No newline at end of file
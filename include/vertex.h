@@ -6,6 +6,8 @@ typedef struct {
     float x, y, z; // Position
     float u, v; // Texture coordinates
     float nx, ny, nz; // Normal 
+    // Tangent as octahedral x, y and the bitangent sign in z, all snorm8, w unused
+    signed char tangent[4];
 
 } Vertex;
 
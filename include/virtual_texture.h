@@ -0,0 +1,133 @@
+#ifndef VIRTUAL_TEXTURE_H
+#define VIRTUAL_TEXTURE_H
+
+#include "../glad/glad.h"
+#include <pthread.h>
+
+// Must match the VT_ defines in fragment.glsl
+#define VT_PAGE_SIZE 128
+#define VT_BORDER 4 // Texels copied from the neighbouring pages, for bilinear filtering
+#define VT_MAX_LEVELS 16
+#define VT_PADDED_PAGE (VT_PAGE_SIZE + 2 * VT_BORDER)
+
+// Physical cache of VT_PHYSICAL_PAGES^2 pages, the only page memory on the GPU
+#define VT_PHYSICAL_PAGES 8
+
+// Pages read from disk at once, each has its own staging buffer
+#define VT_MAX_LOADS 16
+// Pages uploaded into the cache per frame
+#define VT_UPLOADS_PER_FRAME 8
+
+// Feedback is rendered at 1/VT_FEEDBACK_SCALE of the window size
+#define VT_FEEDBACK_SCALE 8
+
+// Images with a side above this are streamed instead of loaded whole
+#define VT_MIN_SIZE 4096
+
+// Material image index meaning "the virtual texture", must match VIRTUAL_IMAGE in fragment.glsl
+#define VIRTUAL_IMAGE -2
+
+// One mip level of the virtual texture, split into pages
+typedef struct {
+    int width, height; // In texels
+    int pagesX, pagesY;
+    int firstPage;     // Id of its first page, pages are numbered level by level
+} VirtualLevel;
+
+// Where a disk read is
+typedef enum {
+    PAGE_LOAD_FREE,
+    PAGE_LOAD_QUEUED,  // Waiting for the worker
+    PAGE_LOAD_READING, // Worker is reading it
+    PAGE_LOAD_DONE     // Read, waiting for the main thread to upload it
+} PageLoadState;
+
+// A page being read by the worker
+typedef struct {
+    int page;
+    PageLoadState state;
+    unsigned char* pixels; // VT_PADDED_PAGE^2 RGBA texels
+} PageLoad;
+
+// Streams the pages of one huge texture into a fixed size cache
+// The source is converted once into a file of bordered pages for every mip level
+// A low resolution feedback pass records the pages each frame needs, a worker reads them from disk,
+// and each frame uploads a few of them into the least recently used slots of the physical texture
+// The indirection buffer texture maps every page to its slot, or to the closest coarser page that is in the cache,
+// so resident memory is bounded whatever the size of the source
+typedef struct {
+    int fd;
+    VirtualLevel levels[VT_MAX_LEVELS];
+    int numLevels;
+    int numPages;
+
+    // Per page, -1 when not in the cache
+    int* pageSlots;
+    unsigned int* pageUsed; // Last frame it was seen in the feedback
+    unsigned char* pageLoading;
+
+    // Per slot of the physical texture
+    int slotPages[VT_PHYSICAL_PAGES * VT_PHYSICAL_PAGES];
+    unsigned int slotUsed[VT_PHYSICAL_PAGES * VT_PHYSICAL_PAGES];
+
+    // GPU side
+    GLuint physical;
+    GLuint indirectionBuffer, indirection;
+    unsigned char* indirectionData; // RGBA8UI per page: slot x, slot y, mapped level
+    int indirectionDirty;
+
+    // Feedback pass
+    GLuint feedbackFramebuffer, feedbackColor, feedbackDepth;
+    int feedbackWidth, feedbackHeight;
+    GLuint feedbackBuffers[2]; // Pixel pack buffers, one written while the other is read
+    GLsync feedbackFences[2];
+    int feedbackIndex;
+    unsigned int frame;
+    unsigned int feedbackFrame; // Frame the latest feedback was read in, the pages it saw are not evicted
+
+    // Disk reads on a worker thread
+    PageLoad loads[VT_MAX_LOADS];
+    pthread_t worker;
+    int started;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    int quit;
+
+    // Counters for the window title
+    int pagesUploaded;
+    int pagesEvicted;
+} VirtualTexture;
+
+// Whether an image is big enough that it should be streamed, reads only its header
+int wantsVirtualTexture(const char* path);
+
+// Converts the image into "<path>.pages" whether or not one exists, needs no GL context
+// For images too big to convert next to everything the renderer loads, run with --convert-pages first
+// 0 on failure, 1 on success
+int convertVirtualTexture(const char* path);
+
+// Converts the image into "<path>.pages" if that is missing or older, opens it and starts the worker
+// The coarsest page is loaded right away and never evicted, so every page has something to fall back to
+// 0 on failure, 1 on success
+int initVirtualTexture(VirtualTexture* vt, const char* path, int windowWidth, int windowHeight);
+
+// Sets the level table and the lod bias of a program, the feedback program gets a bias for its smaller target
+void setVirtualTextureUniforms(const VirtualTexture* vt, GLuint program, float lodBias);
+
+// LOD bias the feedback program needs to ask for the pages the full size frame uses
+float virtualFeedbackBias(void);
+
+// Binds the feedback target, draw the virtual textured meshes with the feedback program after this
+void beginVirtualFeedback(VirtualTexture* vt);
+
+// Reads the feedback back without waiting and restores the window's framebuffer and viewport
+void endVirtualFeedback(VirtualTexture* vt, int windowWidth, int windowHeight);
+
+// Call once per frame on the main thread
+// Uploads finished pages, updates the indirection, and queues the pages an earlier frame's feedback asked for
+void updateVirtualTexture(VirtualTexture* vt);
+
+// Stops the worker and frees everything
+void freeVirtualTexture(VirtualTexture* vt);
+
+#endif
\ No newline at end of file
@@ -2,9 +2,29 @@
 #include "../include/texture.h"
 #include "../include/obj_loader.h"
 #include "../include/camera.h"
-#include "../include/cube.h"
 #include "../include/vertex.h"
 #include "../include/mtl_loader.h"
+#include "../include/orbit.h"
+#include "../include/culling.h"
+#include "../include/simplify.h"
+#include "../include/primitives.h"
+#include "../include/mesh.h"
+#include "../include/shader_reload.h"
+#include "../include/asset_registry.h"
+#include "../include/material.h"
+#include "../include/texture_atlas.h"
+#include "../include/sampler.h"
+#include "../include/virtual_texture.h"
+#include "../include/hdr.h"
+#include "../include/lights.h"
+#include "../include/gbuffer.h"
+#include "../include/render_queue.h"
+#include "../include/gl_state.h"
+#include "../include/shadow.h"
+#include "../include/frame_pacing.h"
+#include "../include/sim_clock.h"
+#include "../include/frame_packet.h"
+#include "../include/frame_memory.h"
 
 #include "../glad/glad.h"
 #include <GLFW/glfw3.h>
@@ -12,15 +32,100 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdbool.h>
 #include <math.h>
+#include <pthread.h>
 
 const unsigned int SCR_WIDTH = 1200;
 const unsigned int SCR_HEIGHT = 900;
 
+// Cubes orbiting the planet, can be changed with --cubes N
+#define DEFAULT_CUBES 6
+#define CUBES_PER_RING 6
+
+// Texture units of the atlas and of the body image buffer texture
+#define ATLAS_UNIT 0
+#define BODY_IMAGE_UNIT 1
+// The linear copy of the atlas, with the sampler for height maps
+#define ATLAS_DATA_UNIT 3
+
+// Texture unit of the body matrix buffer texture
+#define BODY_MATRIX_UNIT 2
+
+// Texture units of the virtual texture's indirection and page cache
+#define VT_INDIRECTION_UNIT 4
+#define VT_PHYSICAL_UNIT 5
+
+// Texture unit the tonemap pass reads the HDR target from
+#define HDR_UNIT 6
+
+// Texture units of the lights and of their cluster lists
+#define LIGHT_DATA_UNIT 7
+#define CLUSTER_GRID_UNIT 8
+#define CLUSTER_LIGHTS_UNIT 9
+
+// Texture units of the G-buffer, read by the deferred lighting pass
+#define GBUFFER_ALBEDO_UNIT 10
+#define GBUFFER_SURFACE_UNIT 11
+#define GBUFFER_DEPTH_UNIT 12
+
+// Texture unit of the planet light's shadow cube map
+#define SHADOW_UNIT 13
+
+// Frame rate of --pacing capped when --fps is not given
+#define DEFAULT_CAP_FPS 60.0
+
+// Edge of each shadow map face in texels, can be changed with --shadow-size N, 0 turns shadows off
+#define DEFAULT_SHADOW_SIZE 1024
+
+// Planes of the projection, the clusters divide the same depth range
+#define NEAR_PLANE 0.1f
+#define FAR_PLANE 100.0f
+
+// The planet lights everything around it, lamp cubes only their neighbours
+#define PLANET_LIGHT_RANGE 60.0f
+#define LAMP_RANGE 6.0f
+#define LAMP_INTENSITY 1.5f
+
+// Scale of the lit scene before the tonemap curve
+#define HDR_EXPOSURE 1.0f
+
+// Edge length of the cubes
+#define CUBE_SIZE 1.0f
+
+// Radius of the sphere in planet.obj, used for the procedural planet
+#define PLANET_RADIUS 2.6f
+
+// Variants of the scene program, materials with a bump map draw with the normal mapped one
+// The feedback variant only writes the virtual texture pages each pixel needs
+// The deferred renderer writes the cubes with the G-buffer variant and lights them with the fullscreen one
+// The depth variant only writes depth, for the prepass
+enum { SCENE_BASE, SCENE_NORMAL_MAP, SCENE_FEEDBACK, SCENE_GBUFFER, SCENE_DEFERRED, SCENE_DEPTH, SCENE_VARIANTS };
+const char* const sceneDefines[SCENE_VARIANTS] = { "", "#define NORMAL_MAP", "#define VT_FEEDBACK", "#define GBUFFER",
+                                                   "#define DEFERRED_LIGHTING", "#define DEPTH_ONLY" };
+// Same variants reading the images through bindless handles
+const char* const bindlessSceneDefines[SCENE_VARIANTS] = { "#define BINDLESS", "#define BINDLESS\n#define NORMAL_MAP",
+                                                           "#define BINDLESS\n#define VT_FEEDBACK", "#define BINDLESS\n#define GBUFFER",
+                                                           "#define BINDLESS\n#define DEFERRED_LIGHTING", "#define BINDLESS\n#define DEPTH_ONLY" };
+
+// Passes of the render queue, executed in this order, each around the state it needs
+// Feedback records virtual texture pages, the G-buffer and depth passes only write surfaces, the opaque pass is lit
+enum { PASS_FEEDBACK, PASS_GBUFFER, PASS_DEPTH, PASS_OPAQUE };
+
+// How the cubes are lit, R switches between the two at runtime
+typedef enum {
+    RENDER_FORWARD,  // Each cube fragment loops over its cluster's lights as it is drawn
+    RENDER_DEFERRED  // Cubes go to the G-buffer, one fullscreen pass loops over the clusters of the visible pixels
+} RenderPath;
+
 // For input handling
 bool isPaused = false;
 bool pPressed = false;
+bool fPressed = false;
+bool cycleFiltering = false;
+bool rPressed = false;
+bool switchRenderPath = false;
 
 // Process all input
 // Camera input handled by processCameraInput function
@@ -38,262 +143,1113 @@ void processInput(GLFWwindow *window, Camera* camera, float deltaTime) {
     if(glfwGetKey(window, GLFW_KEY_P) == GLFW_RELEASE){
         pPressed = false;
     }
+    // Next filtering quality on F key press
+    if((glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS) && !fPressed){
+        cycleFiltering = true;
+        fPressed = true;
+    }
+    if(glfwGetKey(window, GLFW_KEY_F) == GLFW_RELEASE){
+        fPressed = false;
+    }
+    // Forward or deferred lighting on R key press
+    if((glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS) && !rPressed){
+        switchRenderPath = true;
+        rPressed = true;
+    }
+    if(glfwGetKey(window, GLFW_KEY_R) == GLFW_RELEASE){
+        rPressed = false;
+    }
     // Camera controls handled here
     processCameraInput(camera, window, deltaTime);
     
 }
 
-int main(){
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    
-    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Somewhat Accurate Solar System", NULL, NULL);
-    if (window == NULL)
-    {
-        printf("Failed to create GLFW window\n");
-        glfwTerminate();
-        return 1;
+// Places the planet (body 0) and the cubes (bodies 1 to numCubes) on their orbits
+// The first ring holds the original six cubes, each further ring is wider and holds more of them
+void setupBodies(OrbitSystem* orbits, int numCubes){
+    // Planet orbits the origin
+    orbits->radius[0] = 10.0f;
+    orbits->speed[0] = 1.0f;
+
+    int ring = 0, ringStart = 0, ringSize = CUBES_PER_RING;
+    for (int i = 0; i < numCubes; i++){
+        if (i - ringStart >= ringSize){
+            ring++;
+            ringStart = i;
+            ringSize = CUBES_PER_RING * (ring + 1);
+        }
+        int slot = i - ringStart;
+        int body = i + 1;
+
+        orbits->parent[body] = 0;
+        orbits->radius[body] = 4.0f + ring;
+        orbits->phase[body] = slot * (6.28f / ringSize);
+        orbits->speed[body] = 1.0f;
+        orbits->spin[body] = 1.0f + (i % CUBES_PER_RING) * 0.5f;
+    }
+}
+
+// Makes the planet light 0 and spreads the lamps evenly over the cubes, each in a color of its own
+void setupLights(LightSystem* lights, int numCubes){
+    lights->body[0] = 0;
+    lights->range[0] = PLANET_LIGHT_RANGE;
+    lights->colorR[0] = lights->colorG[0] = lights->colorB[0] = 1.0f;
+
+    for (int i = 1; i < lights->numLights; i++){
+        int lamp = i - 1;
+        lights->body[i] = 1 + (int)((long long)lamp * numCubes / (lights->numLights - 1));
+        lights->range[i] = LAMP_RANGE;
+
+        // Hues around the color wheel
+        float hue = lamp * 0.618034f;
+        hue -= floorf(hue);
+        lights->colorR[i] = LAMP_INTENSITY * glm_clamp(fabsf(hue * 6.0f - 3.0f) - 1.0f, 0.0f, 1.0f);
+        lights->colorG[i] = LAMP_INTENSITY * glm_clamp(2.0f - fabsf(hue * 6.0f - 2.0f), 0.0f, 1.0f);
+        lights->colorB[i] = LAMP_INTENSITY * glm_clamp(2.0f - fabsf(hue * 6.0f - 4.0f), 0.0f, 1.0f);
+    }
+}
+
+// Uniform locations of the scene program, looked up again whenever it is reloaded
+typedef struct {
+    GLint view;
+    GLint inverseViewProjection;
+    GLint isPlanet;
+    GLint materialIndex;
+} SceneUniforms;
+
+// Finds the per frame uniforms of the scene program and sets the ones that never change
+void setupSceneProgram(GLuint program, SceneUniforms* uniforms, mat4 projection, const LightSystem* lights, const ShadowMap* shadow){
+    glUseProgram(program);
+
+    // Matrixes
+    uniforms->view = glGetUniformLocation(program, "view");
+    uniforms->inverseViewProjection = glGetUniformLocation(program, "inverseViewProjection");
+    glUniformMatrix4fv(glGetUniformLocation(program, "projection"), 1, GL_FALSE, (float*)projection);
+    glUniform1i(glGetUniformLocation(program, "bodyMatrices"), BODY_MATRIX_UNIT);
+
+    // Every image is in the atlas, each body says which one it uses
+    glUniform1i(glGetUniformLocation(program, "atlas"), ATLAS_UNIT);
+    glUniform1i(glGetUniformLocation(program, "atlasData"), ATLAS_DATA_UNIT);
+    glUniform1i(glGetUniformLocation(program, "bodyImages"), BODY_IMAGE_UNIT);
+    bindTextureAtlas(program);
+
+    // Set even without a virtual texture, samplers of different types may not share unit 0
+    glUniform1i(glGetUniformLocation(program, "vtIndirection"), VT_INDIRECTION_UNIT);
+    glUniform1i(glGetUniformLocation(program, "vtPhysical"), VT_PHYSICAL_UNIT);
+
+    // Lighting, the lights and their clusters are in buffer textures
+    setLightUniforms(lights, program, LIGHT_DATA_UNIT, CLUSTER_GRID_UNIT, CLUSTER_LIGHTS_UNIT);
+    glUniform1i(glGetUniformLocation(program, "gAlbedo"), GBUFFER_ALBEDO_UNIT);
+    glUniform1i(glGetUniformLocation(program, "gSurface"), GBUFFER_SURFACE_UNIT);
+    glUniform1i(glGetUniformLocation(program, "gDepth"), GBUFFER_DEPTH_UNIT);
+    uniforms->isPlanet = glGetUniformLocation(program, "isPlanet");
+    // The planet, light 0, casts the cubes' shadows
+    setShadowUniforms(shadow, program, SHADOW_UNIT, 0);
+    // Position remains static
+    vec3 cameraStaticPos = {0.0f, 5.0f, 30.0f};
+    glUniform3fv(glGetUniformLocation(program, "viewPos"), 1, cameraStaticPos);
+
+    // Materials come from the table, each draw picks one
+    bindMaterialTable(program);
+    uniforms->materialIndex = glGetUniformLocation(program, "materialIndex");
+}
+
+// Level table of the virtual texture in every variant, the feedback one asks for the pages of the full size frame
+void setupVirtualTexture(const VirtualTexture* vt, const GLuint* programs){
+    for (int i = 0; i < SCENE_VARIANTS; i++){
+        setVirtualTextureUniforms(vt, programs[i], i == SCENE_FEEDBACK ? virtualFeedbackBias() : 0.0f);
+    }
+}
+
+// Program variant a material draws with
+int materialVariant(const MaterialTable* table, int material){
+    return table->bumpImages[material] >= 0 ? SCENE_NORMAL_MAP : SCENE_BASE;
+}
+
+// Looks up the material of every submesh, the render queue orders the draws by them
+// Submeshes naming a missing material use the first one
+void findSubmeshMaterials(const LoadedObject* obj, const MaterialLibrary* library, int* materials){
+    for (int i = 0; i < obj->numSubmeshes; i++){
+        materials[i] = findMaterial(library, obj->submeshMaterials[i]);
+        if (materials[i] < 0) materials[i] = 0;
+    }
+}
+
+// Puts the atlas image and the light of every body in a buffer texture, read by the vertex shader per instance
+// The planet (body 0) uses its materials' diffuse maps, every cube the cube image
+// 0 on failure, 1 on success
+int initBodyImages(GLuint* buffer, GLuint* texture, int numCubes, int cubeImage, const LightSystem* lights){
+    int* images = (int*)malloc((numCubes + 1) * 2 * sizeof(int));
+    if (!images){
+        printf("Failed to allocate memory for body images\n");
+        return 0;
+    }
+    images[0] = -1;
+    images[1] = -1;
+    for (int i = 1; i <= numCubes; i++){
+        images[i * 2] = cubeImage;
+        images[i * 2 + 1] = -1;
+    }
+    for (int i = 0; i < lights->numLights; i++){
+        images[lights->body[i] * 2 + 1] = i;
+    }
+
+    glGenBuffers(1, buffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, *buffer);
+    glBufferData(GL_TEXTURE_BUFFER, (numCubes + 1) * 2 * sizeof(int), images, GL_STATIC_DRAW);
+    glGenTextures(1, texture);
+    glBindTexture(GL_TEXTURE_BUFFER, *texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32I, *buffer);
+    free(images);
+    return 1;
+}
+
+// Puts the samplers of the current quality on the atlas units, and in its bindless handles
+void applySamplers(const SamplerSet* samplers, TextureAtlas* atlas){
+    GLuint current[SAMPLER_CLASSES];
+    for (int i = 0; i < SAMPLER_CLASSES; i++){
+        current[i] = getSampler(samplers, (SamplerClass)i);
     }
-    glfwMakeContextCurrent(window);
+    setAtlasSamplers(atlas, current);
+    glBindSampler(ATLAS_UNIT, current[SAMPLER_COLOR]);
+    glBindSampler(ATLAS_DATA_UNIT, current[SAMPLER_DATA]);
+}
+
+// Gives the render queue every variant and its per draw uniforms
+void setupQueuePrograms(RenderQueue* queue, const GLuint* programs, const SceneUniforms* uniforms){
+    for (int i = 0; i < SCENE_VARIANTS; i++){
+        setRenderQueueProgram(queue, i, programs[i], uniforms[i].materialIndex, uniforms[i].isPlanet);
+    }
+}
+
+// Deletes the variants loaded so far
+void deleteScenePrograms(const GLuint* programs){
+    for (int i = 0; i < SCENE_VARIANTS; i++){
+        if (programs[i]) glDeleteProgram(programs[i]);
+    }
+}
+
+// Options and shared objects the render thread starts from
+typedef struct {
+    GLFWwindow* window;
+    GLFWwindow* reloadContext; // Hidden window for the shader worker, NULL without one
+    FrameMailbox* mailbox;
+
+    int numCubes;
+    int useGPUOrbits;
+    CullMode cullMode;
+    int icosphereLevel;
+    int allowBindless;
+    int forceVirtual;
+    int numLamps;
+    RenderPath renderPath;
+    int depthPrepass;
+    int frontToBack;
+    int stateCache;
+    int shadowSize;
+    PacingMode pacingMode;
+    double capFps;
+    double simRate;
+    HdrFormat hdrFormat;
+    SamplerQuality filtering;
+
+    int result; // 0 when it ran until quit, 1 when loading failed
+} RendererSetup;
+
+// Loads everything, then draws each frame the main thread hands over, until the quit packet
+// Runs on the render thread with the window's context current
+// 0 on quit, 1 when loading failed
+int runRenderer(RendererSetup* setup){
+    GLFWwindow* window = setup->window;
+    FrameMailbox* mailbox = setup->mailbox;
+    int numCubes = setup->numCubes;
+    int useGPUOrbits = setup->useGPUOrbits;
+    CullMode cullMode = setup->cullMode;
+    int icosphereLevel = setup->icosphereLevel;
+    int allowBindless = setup->allowBindless;
+    int forceVirtual = setup->forceVirtual;
+    int numLamps = setup->numLamps;
+    RenderPath renderPath = setup->renderPath;
+    int depthPrepass = setup->depthPrepass;
+    int frontToBack = setup->frontToBack;
+    int stateCache = setup->stateCache;
+    int shadowSize = setup->shadowSize;
+    PacingMode pacingMode = setup->pacingMode;
+    double capFps = setup->capFps;
+    double simRate = setup->simRate;
+    HdrFormat hdrFormat = setup->hdrFormat;
+    SamplerQuality filtering = setup->filtering;
+
+    // 1 until the loop has run, a failed step jumps to the cleanup of what came before it
+    int result = 1;
+
     gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+    // Binds and uniforms that set what is already set never reach the driver
+    if (stateCache) {
+        installGLStateCache();
+    }
+
+    // Swap interval of the window, or the frame rate the loop holds itself to
+    FramePacer pacer;
+    initFramePacer(&pacer, pacingMode, capFps);
     glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
     glEnable(GL_DEPTH_TEST);
 
-    // Load shaders, attached to a program
+    // --------- Collect textures ---------
 
-    GLuint shaderProgram = loadShaders("shaders/vertex.glsl", "shaders/fragment.glsl");
-    if (shaderProgram == 0) {
-        printf("Failed to load shaders\n");
-        glfwTerminate();
-        return 1;
-    }
+    // Every texture goes into one atlas, loaded once the materials have added theirs
+    // Bindless handles when the driver has them, the texture array otherwise
+    TextureAtlas atlas;
+    initTextureAtlas(&atlas);
+    int bindless = allowBindless && useBindlessAtlas(&atlas);
+    int cubeImage = addAtlasImage(&atlas, "resources/texture/container.png", MIP_SRGB);
 
-    // --------- Load textures ---------
+    // Sampling state is shared by every texture, F switches to the next quality
+    SamplerSet samplers;
+    initSamplerSet(&samplers, filtering);
+    applySamplers(&samplers, &atlas);
 
-    // Cube texture
-    GLuint cubeTexture = loadTexture("resources/texture/container.png");
-    if (cubeTexture == 0) {
-        printf("Failed to load cubetexture\n");
-        glDeleteProgram(shaderProgram);
-        glfwTerminate();
-        return 1;
-    }
+    // Load shaders, attached to a program per variant
 
-    // Planet texture
-    GLuint planetTexture = loadTexture("resources/planet/planet_Quom1200.png");
-    if (planetTexture == 0) {
-        printf("Failed to load planet texture\n");
-        glDeleteProgram(shaderProgram);
-        glDeleteTextures(1, &cubeTexture);
-        glfwTerminate();
-        return 1;
+    const char* const* defines = bindless ? bindlessSceneDefines : sceneDefines;
+    GLuint scenePrograms[SCENE_VARIANTS] = {0};
+    for (int i = 0; i < SCENE_VARIANTS; i++) {
+        scenePrograms[i] = loadShaderVariant("shaders/vertex.glsl", "shaders/fragment.glsl", defines[i]);
+        if (scenePrograms[i] == 0) {
+            printf("Failed to load shaders\n");
+            goto freePrograms;
+        }
     }
 
     // --------- Load OBJ model for planet ---------
 
+    // Or generate a sphere of the requested detail instead
     LoadedObject planet;
-    if (loadObj("resources/planet/planet.obj", &planet) == 0) {
+    int planetLoaded = icosphereLevel >= 0 ? generateIcosphere(icosphereLevel, PLANET_RADIUS, &planet)
+                                           : loadObj("resources/planet/planet.obj", &planet);
+    if (planetLoaded == 0) {
         printf("Failed to load OBJ model\n");
-        glDeleteProgram(shaderProgram);
-        glDeleteTextures(1, &cubeTexture);
-        glDeleteTextures(1, &planetTexture);
-        glfwTerminate();
-        return 1;
+        goto freePrograms;
     }
 
+    // Simplified detail levels for distant planets
+    generateLods(&planet, MAX_LODS);
+
     // --------- Load material data for planet ---------
-    MaterialData planetMat;
-    loadMtl("resources/planet/planet.mtl", &planetMat);
 
-    // --------- Initialise VAO, VBO for planet ---------
+    // Every material and its maps, the planet texture comes from map_Kd and its relief from map_Bump
+    MaterialLibrary planetMaterials;
+    loadMtl("resources/planet/planet.mtl", &planetMaterials);
 
-    // Create and bind empty VAO and VBO
-    GLuint planetVAO, planetVBO;
-    glGenVertexArrays(1, &planetVAO);
-    glBindVertexArray(planetVAO);
+    // A diffuse map too big to load whole is streamed instead, --virtual-texture streams the first one whatever its size
+    // Only one image can be virtual, the first material's map that qualifies
+    VirtualTexture virtualTexture;
+    const char* virtualMap = NULL;
+    for (int i = 0; i < planetMaterials.numMaterials && virtualMap == NULL; i++){
+        const char* map = planetMaterials.materials[i].diffuseMap;
+        if (map[0] != '\0' && (forceVirtual || wantsVirtualTexture(map))){
+            virtualMap = map;
+        }
+    }
+    if (virtualMap && initVirtualTexture(&virtualTexture, virtualMap, SCR_WIDTH, SCR_HEIGHT) == 0){
+        printf("Loading (%s) whole instead\n", virtualMap);
+        virtualMap = NULL;
+    }
+    int virtualActive = virtualMap != NULL;
 
-    glGenBuffers(1, &planetVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, planetVBO); 
+    MaterialTable materialTable;
+    initMaterialTable(&materialTable, &planetMaterials, &atlas, virtualMap);
 
-    // Give the vertex data to OpenGL
-    glBufferData(GL_ARRAY_BUFFER, planet.numVertices * sizeof(Vertex), planet.vertices, GL_STATIC_DRAW);
+    // --------- Load textures ---------
 
-    // Position
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, x));
-    glEnableVertexAttribArray(0);
+    if (buildTextureAtlas(&atlas) == 0) {
+        printf("Failed to load textures\n");
+        goto freeMaterials;
+    }
 
-    // UVs
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, u));
-    glEnableVertexAttribArray(1);
+    // Material of each planet submesh
+    int submeshMaterials[MAX_SUBMESHES];
+    findSubmeshMaterials(&planet, &planetMaterials, submeshMaterials);
 
-    // Normals
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, nx));
-    glEnableVertexAttribArray(2);
+    // --------- Generate cube ---------
 
-    // --------- Initialise VAO, VBO for planet ---------
+    LoadedObject cube;
+    if (generateCube(CUBE_SIZE, &cube) == 0) {
+        goto freeMaterials;
+    }
 
-    // Create and bind empty VAO and VBO
-    GLuint cubeVAO, cubeVBO;
-    glGenVertexArrays(1, &cubeVAO);
-    glBindVertexArray(cubeVAO);
+    // --------- Initialise VAO, VBO, EBO for every mesh ---------
 
-    glGenBuffers(1, &cubeVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
-    
-    // Give vertex data to OpenGL
-    glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), cubeVertices, GL_STATIC_DRAW);
+    // Planet and cube share one vertex format and one set of buffers
+    enum { MESH_PLANET, MESH_CUBE, MESH_COUNT };
+    LoadedObject meshObjects[MESH_COUNT];
+    meshObjects[MESH_PLANET] = planet;
+    meshObjects[MESH_CUBE] = cube;
 
-    // Position 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
+    MeshBuffer meshBuffer;
+    MeshRange meshes[MESH_COUNT];
+    initMeshBuffer(&meshBuffer, meshObjects, MESH_COUNT, meshes);
 
-    // Normals 
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(2);
+    // --------- Initialise orbits ---------
 
-    // UVs 
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-    glEnableVertexAttribArray(1);
+    // The planet and every cube get a model matrix from the orbit pass
+    OrbitSystem orbits;
+    if (initOrbitSystem(&orbits, numCubes + 1) == 0) {
+        goto freeMeshes;
+    }
+    setupBodies(&orbits, numCubes);
+    uploadOrbitSystem(&orbits, useGPUOrbits);
 
-    // --------- Initialize camera ---------
+    // --------- Initialise lights ---------
 
-    Camera camera;
-    initCamera(&camera);
+    // The planet and the lamp cubes are point lights, --lights N turns N cubes into lamps
+    if (numLamps > numCubes) numLamps = numCubes;
+    LightSystem lights;
+    if (initLightSystem(&lights, numLamps + 1) == 0) {
+        goto freeOrbits;
+    }
+    setupLights(&lights, numCubes);
 
-    // --------- Shortcuts for shader interaction ---------
-    glUseProgram(shaderProgram);
+    GLuint bodyImageBuffer = 0, bodyImageTexture = 0;
+    if (initBodyImages(&bodyImageBuffer, &bodyImageTexture, numCubes, cubeImage, &lights) == 0) {
+        goto freeLights;
+    }
 
-    // Matrixes
-    GLint modelLoc = glGetUniformLocation(shaderProgram, "model");
-    GLint viewLoc  = glGetUniformLocation(shaderProgram, "view");
-    GLint projLoc  = glGetUniformLocation(shaderProgram, "projection");
-
-    // Planet Texure
-    GLint planetLoc  = glGetUniformLocation(shaderProgram, "planet");
-    glUniform1i(planetLoc, 0); 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, planetTexture);
-    
-    // Cube texture
-    GLint cubeLoc  = glGetUniformLocation(shaderProgram, "cube");
-    glUniform1i(cubeLoc, 1);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, cubeTexture);
-
-    // Lighting
-    GLint lightLoc = glGetUniformLocation(shaderProgram, "lightPos");
-    GLint isPlanetLoc = glGetUniformLocation(shaderProgram, "isPlanet");
-    GLint viewPosLoc = glGetUniformLocation(shaderProgram, "viewPos");
-    // Position remains static
-    vec3 cameraStaticPos = {0.0f, 5.0f, 30.0f};
-    glUniform3fv(viewPosLoc, 1, cameraStaticPos);
-
-    // Material
-    GLint matAmbLoc  = glGetUniformLocation(shaderProgram, "material.ambient");
-    GLint matDiffLoc = glGetUniformLocation(shaderProgram, "material.diffuse");
-    GLint matSpecLoc = glGetUniformLocation(shaderProgram, "material.specular");
-    GLint matShinLoc = glGetUniformLocation(shaderProgram, "material.shininess");
-
-    glUniform3fv(matAmbLoc, 1, planetMat.Ka);
-    glUniform3fv(matDiffLoc, 1, planetMat.Kd);
-    glUniform3fv(matSpecLoc, 1, planetMat.Ks);
-    glUniform1f(matShinLoc, planetMat.Ns);
-    
+    // The scene is lit into a float target, one pass tonemaps it into the window
+    HdrTarget hdrTarget;
+    if (initHdrTarget(&hdrTarget, SCR_WIDTH, SCR_HEIGHT, hdrFormat, HDR_UNIT) == 0) {
+        goto freeBodyImages;
+    }
+
+    // Draws of every pass, grown to the busiest frame's count and reused
+    // Scratch memory that only lasts a frame comes from the frame arena, reset at the start of each
+    RenderQueue renderQueue;
+    Arena frameArena;
+    if (initRenderQueue(&renderQueue, 64, FAR_PLANE) == 0) {
+        goto freeHdr;
+    }
+    if (initArena(&frameArena, FRAME_ARENA_SIZE) == 0) {
+        goto freeQueue;
+    }
+
+    // Surfaces are written nearest first, so the depth test rejects what they hide
+    // After a prepass the lit pass only shades what is visible, so it sorts by state instead
+    setRenderPassOrder(&renderQueue, PASS_GBUFFER, frontToBack);
+    setRenderPassOrder(&renderQueue, PASS_DEPTH, frontToBack);
+    setRenderPassOrder(&renderQueue, PASS_OPAQUE, frontToBack && !depthPrepass);
+
+    // Allocated even when starting forward, so R switches without a hitch
+    GBuffer gbuffer;
+    int deferredAvailable = initGBuffer(&gbuffer, SCR_WIDTH, SCR_HEIGHT);
+    if (!deferredAvailable) {
+        printf("Deferred lighting unavailable, rendering forward\n");
+        renderPath = RENDER_FORWARD;
+    }
+
+    // Cubes cast shadows from the planet's light, nonfatal like the G-buffer
+    ShadowMap shadowMap;
+    memset(&shadowMap, 0, sizeof(ShadowMap));
+    int shadows = shadowSize > 0 && initShadowMap(&shadowMap, shadowSize, PLANET_LIGHT_RANGE, lights.body[0], 1, numCubes,
+                                                   boundsOriginRadius(&cube.bounds), BODY_MATRIX_UNIT);
+    if (shadowSize > 0 && !shadows) {
+        printf("Shadows unavailable, lighting without them\n");
+    }
+
+    // Every shader reads the body matrices from the same unit
+    glActiveTexture(GL_TEXTURE0 + BODY_MATRIX_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, orbits.matrixTexture);
+
+    // --------- Initialise culling ---------
+
+    // The planet is body 0, the cubes are bodies 1 to numCubes
+    // Bodies spin, so the spheres are centered on the model origin
+    Culler culler;
+    initCuller(&culler, cullMode, BODY_MATRIX_UNIT);
+    culler.frontToBack = frontToBack;
+
+    CullBatch batches[2];
+    memset(batches, 0, sizeof(batches));
+    CullBatch* planetBatch = &batches[0];
+    CullBatch* cubeBatch = &batches[1];
+    if (initCullBatch(planetBatch, meshBuffer.vao, 0, 1, boundsOriginRadius(&planet.bounds), planet.lods, planet.numLods) == 0 ||
+        initCullBatch(cubeBatch, meshBuffer.vao, 1, numCubes, boundsOriginRadius(&cube.bounds), cube.lods, cube.numLods) == 0) {
+        goto freeCulling;
+    }
+
+    // --------- Textures ---------
+
+    // Units are context state, they stay bound when the program is reloaded
+    // Nothing is bound per draw, materials and bodies index into the atlas
+    glActiveTexture(GL_TEXTURE0 + ATLAS_UNIT);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, atlas.texture);
+    glActiveTexture(GL_TEXTURE0 + ATLAS_DATA_UNIT);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, atlas.dataTexture);
+    glActiveTexture(GL_TEXTURE0 + BODY_IMAGE_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, bodyImageTexture);
+    glActiveTexture(GL_TEXTURE0 + LIGHT_DATA_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, lights.lightTexture);
+    glActiveTexture(GL_TEXTURE0 + CLUSTER_GRID_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, lights.gridTexture);
+    glActiveTexture(GL_TEXTURE0 + CLUSTER_LIGHTS_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, lights.indexTexture);
+    if (deferredAvailable) {
+        bindGBufferTextures(&gbuffer, GBUFFER_ALBEDO_UNIT, GBUFFER_SURFACE_UNIT, GBUFFER_DEPTH_UNIT);
+    }
+    if (shadows) {
+        glActiveTexture(GL_TEXTURE0 + SHADOW_UNIT);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, shadowMap.texture);
+    }
+    if (virtualActive) {
+        glActiveTexture(GL_TEXTURE0 + VT_INDIRECTION_UNIT);
+        glBindTexture(GL_TEXTURE_BUFFER, virtualTexture.indirection);
+        // Left active, page uploads bind the cache here instead of on another unit
+        glActiveTexture(GL_TEXTURE0 + VT_PHYSICAL_UNIT);
+        glBindTexture(GL_TEXTURE_2D, virtualTexture.physical);
+    }
 
     // Projection Matrix (Remains Constant)
     mat4 projection;
-    glm_perspective(glm_rad(45.0f), (float)SCR_WIDTH/(float)SCR_HEIGHT, 0.1f, 100.0f, projection);
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, (float*)projection);
+    glm_perspective(glm_rad(45.0f), (float)SCR_WIDTH/(float)SCR_HEIGHT, NEAR_PLANE, FAR_PLANE, projection);
+    setCullerProjection(&culler, projection, SCR_HEIGHT);
+    setLightProjection(&lights, projection, NEAR_PLANE, FAR_PLANE, SCR_WIDTH, SCR_HEIGHT);
+
+    // --------- Shortcuts for shader interaction ---------
+
+    SceneUniforms uniforms[SCENE_VARIANTS];
+    for (int i = 0; i < SCENE_VARIANTS; i++) {
+        setupSceneProgram(scenePrograms[i], &uniforms[i], projection, &lights, &shadowMap);
+    }
+    if (virtualActive) {
+        setupVirtualTexture(&virtualTexture, scenePrograms);
+    }
+    setupQueuePrograms(&renderQueue, scenePrograms, uniforms);
+
+    // Saving either shader file rebuilds every variant in the background
+    // The reloader owns the programs from here on, shaderReloader.programs holds the current ones
+    // Without the watcher the programs are still owned and freed by the reloader, they just never reload
+    ShaderReloader shaderReloader;
+    int shadersWatched = initShaderReloader(&shaderReloader, setup->reloadContext, "shaders/vertex.glsl", "shaders/fragment.glsl",
+                       defines, scenePrograms, SCENE_VARIANTS);
+    memset(scenePrograms, 0, sizeof(scenePrograms));
+
+    // Saving a texture, the planet model or its material imports it again in the background
+    AssetRegistry assets;
+    int assetsTracked = initAssetRegistry(&assets);
+    int planetMeshAsset = -1, planetMatAsset = -1;
+    if (assetsTracked){
+        // The cube texture and every material map, the atlas holds each file once per space
+        for (int i = 0; i < atlas.numImages; i++){
+            trackAtlasImage(&assets, &atlas, i);
+        }
+        planetMatAsset = trackMtl(&assets, "resources/planet/planet.mtl", &planetMaterials);
+        if (icosphereLevel < 0){
+            planetMeshAsset = trackObj(&assets, "resources/planet/planet.obj", &planet, MAX_LODS);
+        }
+    }
 
     // --------- Main render loop ---------
 
+    double lastTitle = 0.0f;
+    int simSteps = 0;
+    double simDropped = 0.0;
+
+    // Throughput of the texture path, reported with the culling counters
+    // The scene draws are timed on the GPU with one query in flight, read back once done
+    // Shaded fragments are counted over the same frames, the overdraw that sorting and the prepass save shows there
+    GLuint sceneTimer, fragmentCounter;
+    glGenQueries(1, &sceneTimer);
+    glGenQueries(1, &fragmentCounter);
+    int timerPending = 0;
+    int numFrames = 0, numDraws = 0, numInstances = 0, numStateChanges = 0, numTimed = 0;
+    double sceneGpuTime = 0.0, sceneFragments = 0.0;
+    while(1)
+    {
+        // Input and simulation of this frame, the main thread fills the other packet meanwhile
+        const FramePacket* packet = acquireFramePacket(mailbox);
+        if (packet->quit){
+            break;
+        }
+        double crntFrame = glfwGetTime();
+        float activeTime = packet->time;
+        mat4 view;
+        vec3 cameraPosition;
+        memcpy(view, packet->view, sizeof(mat4));
+        memcpy(cameraPosition, packet->cameraPosition, sizeof(vec3));
+        simSteps += packet->steps;
+        simDropped += packet->dropped;
+        resetArena(&frameArena);
+
+        // Swap in reloaded assets, textures keep their IDs so only meshes and materials need work
+        if (assetsTracked && updateAssetRegistry(&assets) > 0){
+            if (planetMeshAsset >= 0 && assets.assets[planetMeshAsset].changed){
+                meshObjects[MESH_PLANET] = planet;
+                updateMeshBuffer(&meshBuffer, meshObjects, MESH_COUNT, meshes);
+                freeCullBatch(planetBatch);
+                // Without its batch the planet is not drawn until the next reload
+                initCullBatch(planetBatch, meshBuffer.vao, 0, 1, boundsOriginRadius(&planet.bounds), planet.lods, planet.numLods);
+                findSubmeshMaterials(&planet, &planetMaterials, submeshMaterials);
+            }
+            if (planetMatAsset >= 0 && assets.assets[planetMatAsset].changed){
+                // A map the atlas does not have yet packs it again
+                if (updateMaterialTable(&materialTable, &planetMaterials, &atlas)){
+                    buildTextureAtlas(&atlas);
+                }
+                findSubmeshMaterials(&planet, &planetMaterials, submeshMaterials);
+            }
+        }
+
+        // Filtering only changes which samplers are used, no texture is touched
+        if (packet->cycleFiltering){
+            samplers.quality = (SamplerQuality)((samplers.quality + 1) % SAMPLER_QUALITIES);
+            applySamplers(&samplers, &atlas);
+            printf("Filtering: (%s)\n", samplerQualityName(samplers.quality));
+        }
+
+        // Both paths light with the same clusters, so the switch only changes where the cubes are shaded
+        if (packet->switchRenderPath && deferredAvailable){
+            renderPath = renderPath == RENDER_FORWARD ? RENDER_DEFERRED : RENDER_FORWARD;
+            printf("Lighting: (%s)\n", renderPath == RENDER_DEFERRED ? "Deferred" : "Forward");
+        }
+
+        // Model matrices of every body, the orbit pass uses its own program
+        updateOrbits(&orbits, activeTime);
+
+        // Keep only the bodies inside the view
+        mat4 viewProjection;
+        glm_mat4_mul(projection, view, viewProjection);
+        cullBodies(&culler, &orbits, activeTime, viewProjection, cameraPosition, batches, 2);
+
+        // Pick up rebuilt programs, their uniforms start out unset
+        if (shadersWatched && updateShaderReloader(&shaderReloader)){
+            for (int i = 0; i < SCENE_VARIANTS; i++) {
+                setupSceneProgram(shaderReloader.programs[i], &uniforms[i], projection, &lights, &shadowMap);
+            }
+            if (virtualActive) {
+                setupVirtualTexture(&virtualTexture, shaderReloader.programs);
+            }
+            setupQueuePrograms(&renderQueue, shaderReloader.programs, uniforms);
+        }
+
+        // Lights follow their bodies, CPU culling has found the positions already
+        if (orbits.useGPU && culler.mode != CULL_CPU) {
+            updateOrbitPositions(&orbits, activeTime);
+        }
+        updateLightClusters(&lights, &orbits, view);
+
+        // Faces whose casters and light stayed put keep last frame's depths, a paused scene draws none
+        if (shadows) {
+            updateShadowMap(&shadowMap, &orbits, activeTime, meshBuffer.vao, &meshes[MESH_CUBE]);
+        }
+        
+        // Upload to every variant
+        for (int i = 0; i < SCENE_VARIANTS; i++) {
+            glUseProgram(shaderReloader.programs[i]);
+            glUniformMatrix4fv(uniforms[i].view, 1, GL_FALSE, (float*)view);
+        }
+
+        // --------- Queue the draws ---------
+
+        // Every draw of the frame goes into the queue, its sort orders each pass by depth or by state
+        int deferred = renderPath == RENDER_DEFERRED;
+        int prepass = depthPrepass && !deferred;
+        resetRenderQueue(&renderQueue);
+
+        // Planet, one draw per submesh and detail level in use
+        DrawCommand command;
+        command.mesh = &meshes[MESH_PLANET];
+        command.meshId = MESH_PLANET;
+        command.batch = planetBatch;
+        command.isPlanet = 1;
+        for (int lod = 0; lod < meshes[MESH_PLANET].numLods; lod++) {
+            if (planetBatch->lodVisible[lod] == 0) {
+                continue;
+            }
+            command.lod = lod;
+
+            // Depth needs no material, so the whole level goes in one draw
+            if (prepass) {
+                command.submesh = -1;
+                command.program = SCENE_DEPTH;
+                command.material = 0;
+                submitDraw(&renderQueue, PASS_DEPTH, &command, planetBatch->nearest);
+            }
+            for (int i = 0; i < meshes[MESH_PLANET].numSubmeshes; i++) {
+                command.submesh = i;
+                command.material = submeshMaterials[i];
+                if (virtualActive) {
+                    command.program = SCENE_FEEDBACK;
+                    submitDraw(&renderQueue, PASS_FEEDBACK, &command, planetBatch->nearest);
+                }
+                command.program = materialVariant(&materialTable, command.material);
+                submitDraw(&renderQueue, PASS_OPAQUE, &command, planetBatch->nearest);
+            }
+        }
+
+        // Every visible cube in one draw, model matrices come from the orbit pass
+        // Cubes reuse the planet's first material, but not its bump map, their image comes from bodyImages
+        if (cubeBatch->visible > 0) {
+            command.mesh = &meshes[MESH_CUBE];
+            command.meshId = MESH_CUBE;
+            command.batch = cubeBatch;
+            command.lod = 0;
+            command.submesh = -1;
+            command.material = 0;
+            command.isPlanet = 0;
+            if (prepass) {
+                command.program = SCENE_DEPTH;
+                submitDraw(&renderQueue, PASS_DEPTH, &command, cubeBatch->nearest);
+            }
+            command.program = deferred ? SCENE_GBUFFER : SCENE_BASE;
+            submitDraw(&renderQueue, deferred ? PASS_GBUFFER : PASS_OPAQUE, &command, cubeBatch->nearest);
+        }
+        sortRenderQueue(&renderQueue, &frameArena);
+
+        // Every mesh is in the same buffers
+        glBindVertexArray(meshBuffer.vao);
+
+        // --------- Virtual texture feedback ---------
+
+        // Pages asked for by an earlier frame are uploaded, then this frame's planet records the pages it needs
+        // The planet samples the cache through the indirection, so it never waits for a page
+        if (virtualActive) {
+            glActiveTexture(GL_TEXTURE0 + VT_PHYSICAL_UNIT);
+            updateVirtualTexture(&virtualTexture);
+
+            beginVirtualFeedback(&virtualTexture);
+            executeRenderPass(&renderQueue, PASS_FEEDBACK);
+            endVirtualFeedback(&virtualTexture, SCR_WIDTH, SCR_HEIGHT);
+        }
+
+        if (timerPending) {
+            GLint available = 0;
+            glGetQueryObjectiv(sceneTimer, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available) {
+                GLuint64 elapsed;
+                glGetQueryObjectui64v(sceneTimer, GL_QUERY_RESULT, &elapsed);
+                sceneGpuTime += elapsed * 1e-9;
+                // Ended before the timer, so it is ready too
+                GLuint64 fragments;
+                glGetQueryObjectui64v(fragmentCounter, GL_QUERY_RESULT, &fragments);
+                sceneFragments += fragments;
+                numTimed++;
+                timerPending = 0;
+            }
+        }
+        int timing = !timerPending;
+        if (timing) {
+            glBeginQuery(GL_TIME_ELAPSED, sceneTimer);
+        }
+
+        // --------- G-buffer ---------
+
+        // Deferred lighting writes the cubes' surfaces first, they are lit below with one fullscreen pass
+        if (timing && deferred) {
+            glBeginQuery(GL_SAMPLES_PASSED, fragmentCounter);
+        }
+        if (deferred) {
+            beginGBuffer(&gbuffer);
+            executeRenderPass(&renderQueue, PASS_GBUFFER);
+        }
+
+        // --------- Render into the HDR target ---------
+
+        // Lighting adds up in linear space, so the clear color is linear too
+        beginHdrTarget(&hdrTarget);
+        glClearColor(0.0033f, 0.0033f, 0.01f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        // --------- Depth prepass ---------
+
+        // Forward only, every body's depth first so the lit pass shades each pixel once
+        // The deferred path already shades only the visible G-buffer pixels
+        if (prepass) {
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            executeRenderPass(&renderQueue, PASS_DEPTH);
+
+            // Only fragments at the stored depth pass from here on
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+            glDepthMask(GL_FALSE);
+            glDepthFunc(GL_LEQUAL);
+        }
+        if (timing && !deferred) {
+            glBeginQuery(GL_SAMPLES_PASSED, fragmentCounter);
+        }
+
+        if (deferred) {
+            // Same Phong terms and clusters as the forward path, the position comes from the depth
+            mat4 inverseViewProjection;
+            glm_mat4_inv(viewProjection, inverseViewProjection);
+            glUseProgram(shaderReloader.programs[SCENE_DEFERRED]);
+            glUniformMatrix4fv(uniforms[SCENE_DEFERRED].inverseViewProjection, 1, GL_FALSE, (float*)inverseViewProjection);
+            lightGBuffer(&gbuffer, hdrTarget.framebuffer);
+            glBindVertexArray(meshBuffer.vao);
+        }
+
+        // --------- Render the lit bodies ---------
+
+        // The planet, and the cubes when they are lit forward
+        executeRenderPass(&renderQueue, PASS_OPAQUE);
+        if (prepass) {
+            glDepthMask(GL_TRUE);
+            glDepthFunc(GL_LESS);
+        }
+        numDraws += renderQueue.draws;
+        numInstances += renderQueue.instances;
+        numStateChanges += renderQueue.stateChanges;
+
+        if (timing) {
+            glEndQuery(GL_SAMPLES_PASSED);
+            glEndQuery(GL_TIME_ELAPSED);
+            timerPending = 1;
+        }
+        numFrames++;
+
+        // --------- Tonemap ---------
+
+        // Single read of the HDR target, tonemapped and written to the window as sRGB
+        resolveHdrTarget(&hdrTarget, HDR_EXPOSURE);
+
+        // Culling counters and throughput, once a second
+        if (crntFrame - lastTitle >= 1.0){
+            double seconds = crntFrame - lastTitle;
+            char title[MAX_TITLE_LENGTH];
+            snprintf(title, sizeof(title), "Somewhat Accurate Solar System | Visible: %d | Culled: %d | %s, %s, %s filtering, %s: %.0f fps, %.0f draws/s, %.0f instances/s, %.0f state changes/s, %.3f ms GPU, %.2f M fragments",
+                     planetBatch->visible + cubeBatch->visible, planetBatch->culled + cubeBatch->culled,
+                     renderPath == RENDER_DEFERRED ? "Deferred" : "Forward",
+                     bindless ? "Bindless" : "Texture array", samplerQualityName(samplers.quality), hdrFormatName(hdrTarget.format), numFrames / seconds, numDraws / seconds, numInstances / seconds, numStateChanges / seconds,
+                     numTimed > 0 ? 1000.0 * sceneGpuTime / numTimed : 0.0,
+                     numTimed > 0 ? 1e-6 * sceneFragments / numTimed : 0.0);
+            if (lights.numLights > 1) {
+                // Light count and how many a lit fragment loops over, the flat cost clustering buys
+                size_t length = strlen(title);
+                snprintf(title + length, sizeof(title) - length, " | Lights: %d, %.1f per cluster",
+                         lights.numLights, lights.occupied > 0 ? (double)lights.assigned / lights.occupied : 0.0);
+            }
+            // Spacing of the presents, the jitter is what vsync and the cap are meant to remove
+            FramePacingStats pacing;
+            readFramePacingStats(&pacer, &pacing);
+            size_t pacingLength = strlen(title);
+            snprintf(title + pacingLength, sizeof(title) - pacingLength, " | %s: %.2f ms, %.2f ms jitter, %.2f ms worst",
+                     pacingModeName(pacer.mode), pacing.meanInterval, pacing.jitter, pacing.worstInterval);
+            if (pacer.mode == PACING_CAPPED) {
+                // CPU time given back by sleeping, and burnt spinning to hit the deadline
+                size_t length = strlen(title);
+                snprintf(title + length, sizeof(title) - length, ", %.2f ms slept, %.2f ms spun", pacing.slept, pacing.spun);
+            }
+            // Steps per frame stay at the step rate over the frame rate, dropped time means the simulation fell behind
+            size_t simLength = strlen(title);
+            snprintf(title + simLength, sizeof(title) - simLength, " | Sim: %.0f Hz, %.2f steps/frame, %.0f ms dropped",
+                     simRate, numFrames > 0 ? (double)simSteps / numFrames : 0.0, 1000.0 * simDropped);
+            simSteps = 0;
+            simDropped = 0.0;
+            if (shadows) {
+                // Faces the moving casters made stale, out of six per frame
+                size_t length = strlen(title);
+                snprintf(title + length, sizeof(title) - length, " | Shadows: %d px, %.1f faces drawn per frame",
+                         shadowMap.size, numFrames > 0 ? (double)shadowMap.facesDrawn / numFrames : 0.0);
+                shadowMap.facesDrawn = shadowMap.facesReused = 0;
+            }
+            if (stateCache) {
+                // Share of the binding and uniform calls the cache kept from the driver
+                GLStateCounters stateCounters;
+                readGLStateCounters(&stateCounters, 1);
+                long long hits = 0, calls = 0;
+                for (int i = 0; i < STATE_KINDS; i++) {
+                    hits += stateCounters.hits[i];
+                    calls += stateCounters.hits[i] + stateCounters.misses[i];
+                }
+                size_t length = strlen(title);
+                snprintf(title + length, sizeof(title) - length, " | GL state: %.0f%% of %.0f calls/s redundant",
+                         calls > 0 ? 100.0 * hits / calls : 0.0, calls / seconds);
+            }
+            // Heap calls of every thread, zero per frame once the queue and the arenas have seen the busiest frame
+            HeapCounters heap;
+            readHeapCounters(&heap, 1);
+            size_t heapLength = strlen(title);
+            snprintf(title + heapLength, sizeof(title) - heapLength, " | Heap: %.2f allocations/frame, %.0f KB frame arena",
+                     numFrames > 0 ? (double)heap.allocations / numFrames : 0.0, frameArena.peak / 1024.0);
+            frameArena.peak = 0;
+            if (virtualActive) {
+                // Pages streamed in and out of the cache over the last second
+                size_t length = strlen(title);
+                snprintf(title + length, sizeof(title) - length, " | Pages: %d in, %d evicted",
+                         virtualTexture.pagesUploaded, virtualTexture.pagesEvicted);
+                virtualTexture.pagesUploaded = virtualTexture.pagesEvicted = 0;
+            }
+            postWindowTitle(mailbox, title);
+            lastTitle = crntFrame;
+            numFrames = numDraws = numInstances = numStateChanges = numTimed = 0;
+            sceneGpuTime = sceneFragments = 0.0;
+        }
+
+        // Swap buffers, held back to the frame's deadline when capped
+        paceFrame(&pacer);
+        glfwSwapBuffers(window);
+        recordFramePresented(&pacer);
+    }
+
+
+    result = 0;
+
+    // Free resources in reverse order of loading, a failed step joins at the label of what came before it
+    if (assetsTracked){
+        freeAssetRegistry(&assets);
+    }
+    glDeleteQueries(1, &sceneTimer);
+    glDeleteQueries(1, &fragmentCounter);
+    freeShaderReloader(&shaderReloader);
+freeCulling:
+    freeCullBatch(planetBatch);
+    freeCullBatch(cubeBatch);
+    freeCuller(&culler);
+    freeShadowMap(&shadowMap);
+    freeGBuffer(&gbuffer);
+    freeArena(&frameArena);
+freeQueue:
+    freeRenderQueue(&renderQueue);
+freeHdr:
+    freeHdrTarget(&hdrTarget);
+freeBodyImages:
+    glDeleteTextures(1, &bodyImageTexture);
+    glDeleteBuffers(1, &bodyImageBuffer);
+freeLights:
+    freeLightSystem(&lights);
+freeOrbits:
+    freeOrbitSystem(&orbits);
+freeMeshes:
+    freeMeshBuffer(&meshBuffer);
+    freeObj(&cube);
+freeMaterials:
+    freeMaterialTable(&materialTable);
+    if (virtualActive) freeVirtualTexture(&virtualTexture);
+    freeObj(&planet);
+freePrograms:
+    // Only those not handed to the reloader yet
+    deleteScenePrograms(scenePrograms);
+    freeSamplerSet(&samplers);
+    freeTextureAtlas(&atlas);
+    return result;
+}
+
+// Render thread, owns the window's context from here on
+void* renderThread(void* arg){
+    RendererSetup* setup = (RendererSetup*)arg;
+    glfwMakeContextCurrent(setup->window);
+    setup->result = runRenderer(setup);
+    glfwMakeContextCurrent(NULL);
+
+    // Whether it quit or failed to load, the main thread stops waiting for it
+    finishFrameMailbox(setup->mailbox);
+    return NULL;
+}
+
+int main(int argc, char** argv){
+    // Command line options
+    int numCubes = DEFAULT_CUBES;
+    int useGPUOrbits = 1;
+    CullMode cullMode = CULL_CPU;
+    int icosphereLevel = -1;
+    int allowBindless = 1;
+    int forceVirtual = 0;
+    int numLamps = 0;
+    RenderPath renderPath = RENDER_FORWARD;
+    int depthPrepass = 0;
+    int frontToBack = 1;
+    int stateCache = 1;
+    int shadowSize = DEFAULT_SHADOW_SIZE;
+    PacingMode pacingMode = PACING_VSYNC;
+    double capFps = DEFAULT_CAP_FPS;
+    double simRate = DEFAULT_SIM_RATE;
+    HdrFormat hdrFormat = HDR_RGBA16F;
+    SamplerQuality filtering = SAMPLER_HIGH;
+    for (int i = 1; i < argc; i++){
+        if (strcmp(argv[i], "--cubes") == 0 && i + 1 < argc){
+            numCubes = atoi(argv[++i]);
+            if (numCubes < 0) numCubes = 0;
+        }
+        else if (strcmp(argv[i], "--lights") == 0 && i + 1 < argc){
+            numLamps = atoi(argv[++i]);
+            if (numLamps < 0) numLamps = 0;
+        }
+        else if (strcmp(argv[i], "--pacing") == 0 && i + 1 < argc){
+            i++;
+            if (strcmp(argv[i], "adaptive") == 0) pacingMode = PACING_ADAPTIVE;
+            else if (strcmp(argv[i], "uncapped") == 0) pacingMode = PACING_UNCAPPED;
+            else if (strcmp(argv[i], "capped") == 0) pacingMode = PACING_CAPPED;
+            else pacingMode = PACING_VSYNC;
+        }
+        else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc){
+            // A frame rate only makes sense capped
+            capFps = atof(argv[++i]);
+            pacingMode = PACING_CAPPED;
+        }
+        else if (strcmp(argv[i], "--sim-rate") == 0 && i + 1 < argc){
+            simRate = atof(argv[++i]);
+            if (simRate <= 0.0) simRate = DEFAULT_SIM_RATE;
+        }
+        else if (strcmp(argv[i], "--shadow-size") == 0 && i + 1 < argc){
+            shadowSize = atoi(argv[++i]);
+            if (shadowSize < 0) shadowSize = 0;
+        }
+        else if (strcmp(argv[i], "--deferred") == 0){
+            renderPath = RENDER_DEFERRED;
+        }
+        else if (strcmp(argv[i], "--prepass") == 0){
+            depthPrepass = 1;
+        }
+        else if (strcmp(argv[i], "--no-sort") == 0){
+            frontToBack = 0;
+        }
+        else if (strcmp(argv[i], "--no-state-cache") == 0){
+            stateCache = 0;
+        }
+        else if (strcmp(argv[i], "--cpu-orbits") == 0){
+            useGPUOrbits = 0;
+        }
+        else if (strcmp(argv[i], "--cull") == 0 && i + 1 < argc){
+            i++;
+            if (strcmp(argv[i], "none") == 0) cullMode = CULL_NONE;
+            else if (strcmp(argv[i], "gpu") == 0) cullMode = CULL_GPU;
+            else cullMode = CULL_CPU;
+        }
+        else if (strcmp(argv[i], "--icosphere") == 0 && i + 1 < argc){
+            icosphereLevel = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--no-bindless") == 0){
+            allowBindless = 0;
+        }
+        else if (strcmp(argv[i], "--virtual-texture") == 0){
+            forceVirtual = 1;
+        }
+        else if (strcmp(argv[i], "--convert-pages") == 0 && i + 1 < argc){
+            // Pages an image ahead of time, with nothing else in memory, then exits
+            return convertVirtualTexture(argv[++i]) ? 0 : 1;
+        }
+        else if (strcmp(argv[i], "--hdr") == 0 && i + 1 < argc){
+            i++;
+            hdrFormat = strcmp(argv[i], "r11g11b10f") == 0 ? HDR_R11G11B10F : HDR_RGBA16F;
+        }
+        else if (strcmp(argv[i], "--filtering") == 0 && i + 1 < argc){
+            i++;
+            if (strcmp(argv[i], "low") == 0) filtering = SAMPLER_LOW;
+            else if (strcmp(argv[i], "medium") == 0) filtering = SAMPLER_MEDIUM;
+            else filtering = SAMPLER_HIGH;
+        }
+        else {
+            printf("Unknown option: (%s)\n", argv[i]);
+            printf("Usage: %s [--cubes N] [--lights N] [--shadow-size N] [--pacing vsync|adaptive|uncapped|capped] [--fps N] [--sim-rate N] [--deferred] [--prepass] [--no-sort] [--no-state-cache] [--cpu-orbits] [--cull none|cpu|gpu] [--icosphere LEVEL] [--no-bindless] [--filtering low|medium|high] [--virtual-texture] [--convert-pages PATH] [--hdr rgba16f|r11g11b10f]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    // Lets the tonemap pass write linear colors and have them stored as sRGB
+    glfwWindowHint(GLFW_SRGB_CAPABLE, GLFW_TRUE);
+    
+    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Somewhat Accurate Solar System", NULL, NULL);
+    if (window == NULL)
+    {
+        printf("Failed to create GLFW window\n");
+        glfwTerminate();
+        return 1;
+    }
+
+    // Windows can only be created here, so the shader worker's hidden one is made before handing over
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow* reloadContext = glfwCreateWindow(1, 1, "Shader Reload", NULL, window);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+
+    // --------- Start the render thread ---------
+
+    // It owns the GL context, this thread keeps the window, input and simulation
+    FrameMailbox mailbox;
+    if (initFrameMailbox(&mailbox) == 0) {
+        if (reloadContext) glfwDestroyWindow(reloadContext);
+        glfwTerminate();
+        return 1;
+    }
+    RendererSetup setup = {
+        .window = window, .reloadContext = reloadContext, .mailbox = &mailbox,
+        .numCubes = numCubes, .useGPUOrbits = useGPUOrbits, .cullMode = cullMode, .icosphereLevel = icosphereLevel,
+        .allowBindless = allowBindless, .forceVirtual = forceVirtual, .numLamps = numLamps, .renderPath = renderPath,
+        .depthPrepass = depthPrepass, .frontToBack = frontToBack, .stateCache = stateCache, .shadowSize = shadowSize,
+        .pacingMode = pacingMode, .capFps = capFps, .simRate = simRate, .hdrFormat = hdrFormat, .filtering = filtering,
+        .result = 1
+    };
+    pthread_t renderer;
+    if (pthread_create(&renderer, NULL, renderThread, &setup) != 0) {
+        printf("Failed to start render thread\n");
+        freeFrameMailbox(&mailbox);
+        if (reloadContext) glfwDestroyWindow(reloadContext);
+        glfwTerminate();
+        return 1;
+    }
+
+    // --------- Input and simulation loop ---------
+
+    // One frame ahead of the render thread, a frame costs about the slower of the two instead of both
+    Camera camera;
+    initCamera(&camera);
+
+    // Bodies move in fixed steps, every frame draws them between the last two
+    SimulationClock simClock;
+    initSimulationClock(&simClock, simRate, MAX_CATCHUP_STEPS);
+
     double lastFrame = 0.0f;
-    double activeTime = 0.0f;
-    while(!glfwWindowShouldClose(window))
+    int running = 1;
+    while (running)
     {
         // Calculate delta time
         double crntFrame = glfwGetTime();
         float deltaTime = crntFrame - lastFrame;
         lastFrame = crntFrame;
+        int steps = 0;
         if (!isPaused){
-            activeTime += deltaTime;
+            steps = advanceSimulation(&simClock, deltaTime);
         }
 
         // Process input
         processInput(window, &camera, deltaTime);
 
-        // Clear the screen
-        glClearColor(0.05f, 0.05f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        
         // View matrix
         updateCameraMatrix(&camera);
 
-        // Model matrix (for planet)
-        mat4 model;
-        glm_mat4_identity(model);
-        float planetX = sin(activeTime) * 10.0f;
-        float planetZ = cos(activeTime) * 10.0f;
-        vec3 planetPos = {planetX, 0.0f, planetZ};
-        glm_translate(model, planetPos);
-        
-        // Upload to shader
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, (float*)camera.viewMatrix);
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, (float*)model);
-
-        // Planets location is a light source
-        glUniform3fv(lightLoc, 1, planetPos); 
-
-        // --------- Render the planet ---------
+        // Waits while the render thread has not taken the last packet, stops if it failed to load
+        FramePacket* packet = beginFramePacket(&mailbox);
+        if (packet == NULL) {
+            break;
+        }
+        memcpy(packet->view, camera.viewMatrix, sizeof(mat4));
+        glm_vec3_copy(camera.position, packet->cameraPosition);
+        // Orbits are functions of time, so the state between two steps is the one at the time between them
+        packet->time = interpolatedTime(&simClock);
+        packet->steps = steps;
+        packet->dropped = simClock.timeDropped;
+        simClock.timeDropped = 0.0;
+        packet->cycleFiltering = cycleFiltering;
+        packet->switchRenderPath = switchRenderPath;
+        cycleFiltering = switchRenderPath = false;
+        packet->quit = glfwWindowShouldClose(window);
+        running = !packet->quit;
+        submitFramePacket(&mailbox);
 
-        // Used by the shader to make the planet bright
-        glUniform1i(isPlanetLoc, 1);
-        // Bind VAO for planet       
-        glBindVertexArray(planetVAO);
-        // Render planet
-        glDrawArrays(GL_TRIANGLES, 0, planet.numVertices);
+        // Counters the render thread left, only this thread may change the window
+        char title[MAX_TITLE_LENGTH];
+        if (takeWindowTitle(&mailbox, title, sizeof(title))) {
+            glfwSetWindowTitle(window, title);
+        }
 
-        // --------- Render the cubes ---------
-        
-        // Shader should add lighting
-        glUniform1i(isPlanetLoc, 0);
-        // Bind VAO for cube
-        glBindVertexArray(cubeVAO);
-        
-        // Calculate the model matrix for each cube and draw it
-        for(int i = 0; i < 6; i++) {
-            mat4 cubeModel;
-            
-            // Start with the planet's transformation 
-            glm_mat4_copy(model, cubeModel); 
-            
-            // Calculate the local orbit (assuming the planet is (0,0,0)
-            float orbitAngle = activeTime + (i * (6.28f / 6.0f));
-            vec3 localPos = { sin(orbitAngle) * 4.0f, 0.0f, cos(orbitAngle) * 4.0f };
-            
-            // Apply
-            glm_translate(cubeModel, localPos);
-            
-            // Apply self rotation
-            glm_rotate(cubeModel, activeTime * (1.0f + i * 0.5f), (vec3){0.5f, 1.0f, 0.0f});
-            
-            // Upload and draw
-            glUniformMatrix4fv(modelLoc, 1, GL_FALSE, (float*)cubeModel);
-            glDrawArrays(GL_TRIANGLES, 0, 36);
-        }
-
-        // Swap buffers and poll IO events
-        glfwSwapBuffers(window);
+        // Poll IO events
         glfwPollEvents();
     }
 
-
-    // Free resources before exiting
-    glDeleteProgram(shaderProgram);
-    glDeleteTextures(1, &cubeTexture);
-    glDeleteTextures(1, &planetTexture);
-    freeObj(&planet);
+    // The quit packet makes it free everything on its own context
+    pthread_join(renderer, NULL);
+    if (reloadContext) glfwDestroyWindow(reloadContext);
+    freeFrameMailbox(&mailbox);
     glfwTerminate();
+    return setup.result;
 }
\ No newline at end of file
@@ -0,0 +1,40 @@
+#version 330 core
+
+// One vertex per body of the batch, see source/culling.c
+flat out uint BodyIndex;
+flat out int Visible;
+
+uniform samplerBuffer bodyMatrices; // Four texels per body, written by the orbit pass
+uniform int firstBody;
+uniform float radius;
+uniform vec4 planes[6]; // Normals point inside the frustum
+
+// Distance range of the detail level being filled
+uniform vec3 cameraPos;
+uniform float minDistance;
+uniform float maxDistance;
+
+void main()
+{
+    int body = firstBody + gl_VertexID;
+
+    // Translation column of the model matrix
+    vec3 pos = texelFetch(bodyMatrices, body * 4 + 3).xyz;
+
+    // Outside if the sphere is fully behind any plane
+    bool inside = true;
+    for (int i = 0; i < 6; i++) {
+        if (dot(planes[i].xyz, pos) + planes[i].w < -radius) {
+            inside = false;
+        }
+    }
+
+    // Only the bodies of this level
+    float dist = distance(pos, cameraPos);
+    if (dist < minDistance || dist >= maxDistance) {
+        inside = false;
+    }
+
+    BodyIndex = uint(body);
+    Visible = inside ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,20 @@
+#version 330 core
+
+// Drops invisible bodies, the rest are packed by transform feedback
+layout (points) in;
+layout (points, max_vertices = 1) out;
+
+flat in uint BodyIndex[];
+flat in int Visible[];
+
+// Captured with transform feedback
+flat out uint VisibleIndex;
+
+void main()
+{
+    if (Visible[0] == 1) {
+        VisibleIndex = BodyIndex[0];
+        EmitVertex();
+        EndPrimitive();
+    }
+}
\ No newline at end of file
@@ -1,73 +1,409 @@
 #version 330 core
+#ifdef BINDLESS
+#extension GL_ARB_bindless_texture : require
+#endif
+#ifdef VT_FEEDBACK
+// Virtual texture page each pixel needs: x, y, level and 1, all 0 where nothing is streamed
+out uvec4 Feedback;
+#elif defined(GBUFFER)
+// Surface of a lit body, see source/gbuffer.c
+layout(location = 0) out vec4 GAlbedo;
+layout(location = 1) out uvec4 GSurface; // Octahedral normal in 16 bits each, material, body light + 1
+#else
 out vec4 FragColor;
+#endif
 
 in vec2 TexCoord;
 in vec3 Normal;
 in vec3 FragPos;
+flat in int BodyImage;
+flat in int BodyLight;
+#ifdef NORMAL_MAP
+in vec3 Tangent;
+in vec3 Bitangent;
+#endif
 
-// From mtl
+// Must match MAX_MATERIALS in mtl_loader.h
+#define MAX_MATERIALS 16
+
+// From mtl, every material in one table shared by all draws
 struct Material {
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-    float shininess;
+    vec4 ambient;
+    vec4 diffuse;  // w is the dissolve
+    vec4 specular; // w is the shininess
+    vec4 maps;     // x diffuse image, y bump image, -1 without, VIRTUAL_IMAGE when streamed
+};
+
+layout(std140) uniform Materials {
+    Material materials[MAX_MATERIALS];
+};
+
+// Material of the current draw
+uniform int materialIndex;
+
+// Must match MAX_ATLAS_IMAGES in texture_atlas.h
+#define MAX_ATLAS_IMAGES 32
+
+// Where each image sits in the atlas layers
+struct AtlasImage {
+    vec4 rect; // xy offset, zw size
+    float layer;
+    uvec2 handle;     // Own texture of the image when bindless, with the color sampler
+    uvec2 dataHandle; // Same texture with the data sampler
 };
 
-uniform Material material;
+layout(std140) uniform Atlas {
+    AtlasImage atlasImages[MAX_ATLAS_IMAGES];
+};
 
-uniform sampler2D planet;  
-uniform sampler2D cube;
+// Every texture of the scene, including the bump maps
+// The same array is bound twice, with the color sampler and with the data sampler for height maps
+uniform sampler2DArray atlas;
+uniform sampler2DArray atlasData;
 
-uniform vec3 lightPos; 
 uniform vec3 viewPos;
 uniform int isPlanet;     
 
+// Must match the CLUSTER_ defines in lights.h
+#define CLUSTER_TILES_X 16
+#define CLUSTER_TILES_Y 12
+#define CLUSTER_SLICES 24
+
+// Every light, two texels each: position and range, then color
+uniform samplerBuffer lightData;
+// Offset and count of each cluster's lights in clusterLights
+uniform usamplerBuffer clusterGrid;
+uniform usamplerBuffer clusterLights;
+// Tile width and height in pixels, near plane, slices per log of depth
+uniform vec4 clusterParams;
+// Same view as the vertex shader, for the depth of the fragment
+uniform mat4 view;
+
+// G-buffer read by the lighting pass, with the inverse of the view and projection to rebuild positions
+uniform sampler2D gAlbedo;
+uniform usampler2D gSurface;
+uniform sampler2D gDepth;
+uniform mat4 inverseViewProjection;
+
+// Distance to the shadow light of every direction, -1 in shadowLight draws without shadows, see source/shadow.c
+uniform samplerCubeShadow shadowMap;
+uniform int shadowLight;
+uniform vec2 shadowParams; // Range of the light, size of a texel one unit away from it
+
+// Texels the lookup is pushed off the surface, and the depth bias left after that
+#define SHADOW_NORMAL_OFFSET 1.5
+#define SHADOW_BIAS 0.002
+
+// Attenuation of every light, windowed to reach 0 at its range so the clusters have no seams
+#define LIGHT_CONSTANT 1.0
+#define LIGHT_LINEAR 0.045
+#define LIGHT_QUADRATIC 0.0075
+
+// UV derivatives, taken before any branch since images are picked per fragment
+vec2 uvDx;
+vec2 uvDy;
+
+#ifdef BINDLESS
+// Without NV_gpu_shader5 the handle must be the same across a draw, every draw uses one image per material or body
+
+// Samples one image with the color sampler
+vec4 sampleAtlas(int image, vec2 uv)
+{
+    return textureGrad(sampler2D(atlasImages[image].handle), uv, uvDx, uvDy);
+}
+
+// Samples one image with the data sampler
+vec4 sampleAtlasData(int image, vec2 uv)
+{
+    return textureGrad(sampler2D(atlasImages[image].dataHandle), uv, uvDx, uvDy);
+}
+#else
+// Samples one image of the array, repeating it like a texture of its own
+vec4 sampleLayers(sampler2DArray layers, int image, vec2 uv)
+{
+    AtlasImage entry = atlasImages[image];
+    // UVs of exactly 1 stay on the far edge instead of wrapping
+    vec2 wrapped = clamp(uv, 0.0, 1.0) == uv ? uv : fract(uv);
+    // Gradients of the unwrapped UVs, so the wrap does not pick a tiny mip level
+    return textureGrad(layers, vec3(entry.rect.xy + wrapped * entry.rect.zw, entry.layer),
+                       uvDx * entry.rect.zw, uvDy * entry.rect.zw);
+}
+
+// Samples one image with the color sampler
+vec4 sampleAtlas(int image, vec2 uv)
+{
+    return sampleLayers(atlas, image, uv);
+}
+
+// Samples one image with the data sampler
+vec4 sampleAtlasData(int image, vec2 uv)
+{
+    return sampleLayers(atlasData, image, uv);
+}
+#endif
+
+// Size of one image in texels
+vec2 atlasImageSize(int image)
+{
+#ifdef BINDLESS
+    return vec2(textureSize(sampler2D(atlasImages[image].handle), 0));
+#else
+    return vec2(textureSize(atlas, 0).xy) * atlasImages[image].rect.zw;
+#endif
+}
+
+// Must match the VT_ defines in virtual_texture.h
+#define VT_PAGE_SIZE 128
+#define VT_BORDER 4
+#define VT_MAX_LEVELS 16
+#define VT_PADDED_PAGE (VT_PAGE_SIZE + 2 * VT_BORDER)
+#define VIRTUAL_IMAGE -2
+
+// Slot x, slot y and mapped level of every page, a missing page maps to its closest cached parent
+uniform usamplerBuffer vtIndirection;
+// Cache of bordered pages
+uniform sampler2D vtPhysical;
+uniform ivec4 vtLevels[VT_MAX_LEVELS]; // xy size in texels, z pages across, w first page
+uniform int vtNumLevels;
+uniform float vtLodBias;
+
+// Level the derivatives ask for, clamped to the levels there are
+int virtualLevel()
+{
+    vec2 size = vec2(vtLevels[0].xy);
+    vec2 dx = uvDx * size;
+    vec2 dy = uvDy * size;
+    float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8)) + vtLodBias;
+    return clamp(int(floor(lod)), 0, vtNumLevels - 1);
+}
+
+// Page of a level under the UVs, repeating like a texture
+ivec2 virtualPage(vec2 uv, int level)
+{
+    ivec2 texel = ivec2(fract(uv) * vec2(vtLevels[level].xy));
+    return min(texel / VT_PAGE_SIZE, (vtLevels[level].xy - 1) / VT_PAGE_SIZE);
+}
+
+// Samples the streamed texture from the finest cached page covering the UVs
+vec4 sampleVirtual(vec2 uv)
+{
+    int level = virtualLevel();
+    ivec2 page = virtualPage(uv, level);
+    uvec4 entry = texelFetch(vtIndirection, vtLevels[level].w + page.y * vtLevels[level].z + page.x);
+
+    // Coarser than asked for while the page is still loading
+    int mapped = int(entry.z);
+    vec2 texel = fract(uv) * vec2(vtLevels[mapped].xy) - vec2(virtualPage(uv, mapped) * VT_PAGE_SIZE);
+    vec2 physical = vec2(entry.xy) * float(VT_PADDED_PAGE) + float(VT_BORDER) + texel;
+    return textureLod(vtPhysical, physical / vec2(textureSize(vtPhysical, 0)), 0.0);
+}
+
+// Samples a diffuse image, streamed or from the atlas
+vec4 sampleImage(int image, vec2 uv)
+{
+    return image == VIRTUAL_IMAGE ? sampleVirtual(uv) : sampleAtlas(image, uv);
+}
+
+// Cluster of the fragment, found from its pixel and its depth in the view
+int fragmentCluster(vec3 pos)
+{
+    ivec2 tile = min(ivec2(gl_FragCoord.xy / clusterParams.xy), ivec2(CLUSTER_TILES_X - 1, CLUSTER_TILES_Y - 1));
+    float depth = -(view * vec4(pos, 1.0)).z;
+    int slice = clamp(int(log(max(depth, clusterParams.z) / clusterParams.z) * clusterParams.w), 0, CLUSTER_SLICES - 1);
+    return (slice * CLUSTER_TILES_Y + tile.y) * CLUSTER_TILES_X + tile.x;
+}
+
+// How much of the shadow light reaches the surface, filtered over four texels by the comparison
+float shadowFactor(vec3 pos, vec3 norm, vec3 lightPos)
+{
+    // The further from the light, the bigger a texel, so the offset grows with the distance
+    float texel = length(pos - lightPos) * shadowParams.y;
+    vec3 toSurface = pos + norm * (texel * SHADOW_NORMAL_OFFSET) - lightPos;
+    // Looked up inside the light loop, so no implicit derivatives, the map has a single level anyway
+    return textureGrad(shadowMap, vec4(toSurface, length(toSurface) / shadowParams.x - SHADOW_BIAS), vec3(0.0), vec3(0.0));
+}
+
+// Phong terms of a lit surface, forward from the interpolants or deferred from the G-buffer
+// I reuse the planets mtl data, looks good enough
+// Some of the values where unused anyway since it's a light source so I use them here
+vec3 shadeSurface(vec3 pos, vec3 norm, vec3 albedo, Material material, int bodyLight)
+{
+    // Ambient
+    vec3 ambient = (material.ambient.rgb + 0.2) * albedo;
+    vec3 viewDir = normalize(viewPos - pos);
+
+    // Only the lights of this fragment's cluster, the planet is light 0
+    vec3 diffuse = vec3(0.0);
+    vec3 specular = vec3(0.0);
+    uvec2 cluster = texelFetch(clusterGrid, fragmentCluster(pos)).rg;
+    for (uint i = 0u; i < cluster.y; i++) {
+        int light = int(texelFetch(clusterLights, int(cluster.x + i)).r);
+        vec4 posRange = texelFetch(lightData, light * 2);
+        vec3 color = texelFetch(lightData, light * 2 + 1).rgb;
+
+        // Lamps sit inside their own cube, which would light its faces from behind
+        float dist = length(posRange.xyz - pos);
+        if (dist >= posRange.w || light == bodyLight) {
+            continue;
+        }
+
+        // Diffuse
+        vec3 lightDir = (posRange.xyz - pos) / dist;
+        float diff = max(dot(norm, lightDir), 0.0);
+
+        // Specular
+        vec3 reflectDir = reflect(-lightDir, norm);  
+        float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.specular.w);
+
+        // Calculate f(d), faded out towards the range
+        float attenuation = 1.0 / (LIGHT_CONSTANT + LIGHT_LINEAR * dist + LIGHT_QUADRATIC * (dist * dist));
+        float fade = clamp(1.0 - pow(dist / posRange.w, 4.0), 0.0, 1.0);
+        attenuation *= fade * fade;
+
+        // Only lit sides can be shadowed
+        if (light == shadowLight && diff > 0.0) {
+            attenuation *= shadowFactor(pos, norm, posRange.xyz);
+        }
+
+        diffuse += diff * attenuation * color;
+        specular += spec * attenuation * color;
+    }
+    diffuse *= material.diffuse.rgb * albedo;
+    specular *= material.specular.rgb;
+
+    // Lamp cubes glow in their light's color
+    if (bodyLight >= 0) {
+        ambient += texelFetch(lightData, bodyLight * 2 + 1).rgb * albedo;
+    }
+
+    // Linear and unclamped, the tonemap pass maps it to the window
+    return ambient + diffuse + specular;
+}
+
+#if defined(GBUFFER) || defined(DEFERRED_LIGHTING)
+// sign() without the 0, so the fold never collapses an axis
+vec2 signNotZero(vec2 v)
+{
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// Unit vector to two values in [-1, 1], the lower hemisphere folded over the diagonals like in tangents.c
+vec2 encodeOctahedral(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    return n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * signNotZero(n.xy);
+}
+
+// Inverse of encodeOctahedral
+vec3 decodeOctahedral(vec2 e)
+{
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (v.z < 0.0) v.xy = (1.0 - abs(v.yx)) * signNotZero(v.xy);
+    return normalize(v);
+}
+#endif
+
+#ifdef NORMAL_MAP
+// How far one texel of height tilts the normal
+#define BUMP_STRENGTH 2.0
+
+// Normal tilted along the tangent frame by the slope of the height map
+vec3 bumpedNormal(vec3 norm, int image)
+{
+    // One texel of the image in its own UVs
+    vec2 texel = 1.0 / atlasImageSize(image);
+    float height = sampleAtlasData(image, TexCoord).r;
+    float dx = sampleAtlasData(image, TexCoord + vec2(texel.x, 0.0)).r - height;
+    float dy = sampleAtlasData(image, TexCoord + vec2(0.0, texel.y)).r - height;
+
+    // Re-orthogonalize, interpolation bends the frame between vertices
+    vec3 t = normalize(Tangent - norm * dot(norm, Tangent));
+    vec3 b = normalize(Bitangent - norm * dot(norm, Bitangent));
+    return normalize(norm - BUMP_STRENGTH * (dx * t + dy * b));
+}
+#endif
+
+#ifdef DEFERRED_LIGHTING
+// Lights every G-buffer pixel that has a surface, one fullscreen pass
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepth, pixel, 0).r;
+    if (depth == 1.0) {
+        discard;
+    }
+
+    // World position back from the depth
+    vec4 clip = vec4(gl_FragCoord.xy / vec2(textureSize(gDepth, 0)) * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+    vec4 world = inverseViewProjection * clip;
+    vec3 pos = world.xyz / world.w;
+
+    uvec4 surface = texelFetch(gSurface, pixel, 0);
+    vec3 norm = decodeOctahedral(vec2(surface.xy) / 65535.0 * 2.0 - 1.0);
+    vec4 albedo = texelFetch(gAlbedo, pixel, 0);
+    FragColor = vec4(shadeSurface(pos, norm, albedo.rgb, materials[int(surface.z)], int(surface.w) - 1), albedo.a);
+}
+#elif defined(DEPTH_ONLY)
+// Prepass, only the depth is written and no color is shaded
+void main()
+{
+}
+#else
 void main()
 {
+    Material material = materials[materialIndex];
+    uvDx = dFdx(TexCoord);
+    uvDy = dFdy(TexCoord);
+
+    // The body's own image, otherwise the material's diffuse map, otherwise plain white
+    int image = BodyImage >= 0 ? BodyImage : int(material.maps.x);
+
+#ifdef VT_FEEDBACK
+    // Only records which pages are needed, the virtual texture loads them
+    if (image == VIRTUAL_IMAGE) {
+        int level = virtualLevel();
+        Feedback = uvec4(uvec2(virtualPage(TexCoord, level)), uint(level), 1u);
+    }
+    else {
+        Feedback = uvec4(0u);
+    }
+#else
+    vec4 texColor = image >= 0 || image == VIRTUAL_IMAGE ? sampleImage(image, TexCoord) : vec4(1.0);
+#endif
+
+#ifdef GBUFFER
+    // Only lit bodies are drawn here, the planet glows and is drawn forward after the lighting pass
+    vec3 norm = normalize(Normal);
+#ifdef NORMAL_MAP
+    norm = bumpedNormal(norm, int(material.maps.y));
+#endif
+    uvec2 packedNormal = uvec2(round((encodeOctahedral(norm) * 0.5 + 0.5) * 65535.0));
+    GAlbedo = texColor;
+    GSurface = uvec4(packedNormal, uint(materialIndex), uint(BodyLight + 1));
+#elif !defined(VT_FEEDBACK)
     if(isPlanet == 1) {
         // --- PLANET ---
-        vec4 texColor = texture(planet, TexCoord);
-        
         // We use the .mtl's Diffuse and Ambient for ambient lighting
-        vec3 glow = (material.diffuse + material.ambient) * texColor.rgb;
+        vec3 glow = (material.diffuse.rgb + material.ambient.rgb) * texColor.rgb;
+
+#ifdef NORMAL_MAP
+        // Unlit, so the relief only shades by how much each bump faces the viewer
+        vec3 norm = normalize(Normal);
+        vec3 viewDir = normalize(viewPos - FragPos);
+        float facing = max(dot(norm, viewDir), 0.05);
+        glow *= clamp(dot(bumpedNormal(norm, int(material.maps.y)), viewDir) / facing, 0.6, 1.2);
+#endif
         
         FragColor = vec4(glow, texColor.a);
     } 
     else {
         // --- CUBE ---
-        // I reuse the planets mtl data, looks good enough
-        // Some of the values where unused anyway since it's a light source so I use them here
-        vec4 texColor = texture(cube, TexCoord);
-
-        // Ambient
-        vec3 ambient = (material.ambient + 0.2) * texColor.rgb;
-
-        // Diffuse (The Cube faces the Planet)
         vec3 norm = normalize(Normal);
-        vec3 lightDir = normalize(lightPos - FragPos);
-        float diff = max(dot(norm, lightDir), 0.0);
-        vec3 diffuse = (diff * material.diffuse) * texColor.rgb;
-
-        // Specular
-        vec3 viewDir = normalize(viewPos - FragPos);
-        vec3 reflectDir = reflect(-lightDir, norm);  
-        float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-        vec3 specular = (spec * material.specular);
-
-        // Distance reduction
-        float constant = 1.0;  
-        float linear = 0.045;   
-        float quadratic = 0.0075; 
-        
-        // Calculate f(d)
-        float dist = length(lightPos - FragPos);
-        float attenuation = 1.0 / (constant + linear * dist + quadratic * (dist * dist));
-
-        // Apply f(d)
-        diffuse  *= attenuation;
-        specular *= attenuation;
-
-        vec3 result = ambient + diffuse + specular;
-        FragColor = vec4(result, texColor.a);
+#ifdef NORMAL_MAP
+        norm = bumpedNormal(norm, int(material.maps.y));
+#endif
+        FragColor = vec4(shadeSurface(FragPos, norm, texColor.rgb, material, BodyLight), texColor.a);
     }
-}
\ No newline at end of file
+#endif
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,42 @@
+#version 330 core
+
+// One vertex per body, see source/orbit.c
+layout (location = 0) in vec4 aOrbit;       // Radius, phase, speed, spin
+layout (location = 1) in vec4 aParentOrbit; // Radius, phase, speed, has parent
+
+// Captured with transform feedback, the columns of the model matrix
+out vec4 ModelCol0;
+out vec4 ModelCol1;
+out vec4 ModelCol2;
+out vec4 ModelCol3;
+
+uniform float time;
+uniform vec3 spinAxis; // Normalized
+
+// Position on a circle of the XZ plane
+vec3 orbitPosition(vec4 orbit)
+{
+    float angle = time * orbit.z + orbit.y;
+    return vec3(sin(angle) * orbit.x, 0.0, cos(angle) * orbit.x);
+}
+
+void main()
+{
+    // Own orbit plus the parent's
+    vec3 pos = orbitPosition(aOrbit);
+    if (aParentOrbit.w > 0.5) {
+        pos += orbitPosition(aParentOrbit);
+    }
+
+    // Axis angle rotation, same as glm_rotate
+    float angle = time * aOrbit.w;
+    float c = cos(angle);
+    float s = sin(angle);
+    vec3 a = spinAxis;
+    vec3 t = a * (1.0 - c);
+
+    ModelCol0 = vec4(a.x * t.x + c,       a.y * t.x + s * a.z, a.z * t.x - s * a.y, 0.0);
+    ModelCol1 = vec4(a.x * t.y - s * a.z, a.y * t.y + c,       a.z * t.y + s * a.x, 0.0);
+    ModelCol2 = vec4(a.x * t.z + s * a.y, a.y * t.z - s * a.x, a.z * t.z + c,       0.0);
+    ModelCol3 = vec4(pos, 1.0);
+}
\ No newline at end of file
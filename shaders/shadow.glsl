@@ -0,0 +1,24 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;  // Position
+layout (location = 3) in uint aBody; // Per instance, index of a caster left by the face's culling
+
+out vec3 FragPos;
+
+// One face of the shadow cube map, see source/shadow.c
+uniform mat4 faceViewProjection;
+
+// Model matrices of every body, four texels each, written by the orbit pass
+uniform samplerBuffer bodyMatrices;
+
+void main()
+{
+    int base = int(aBody) * 4;
+    mat4 model = mat4(texelFetch(bodyMatrices, base),
+                      texelFetch(bodyMatrices, base + 1),
+                      texelFetch(bodyMatrices, base + 2),
+                      texelFetch(bodyMatrices, base + 3));
+
+    FragPos = vec3(model * vec4(aPos, 1.0));
+    gl_Position = faceViewProjection * vec4(FragPos, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,13 @@
+#version 330 core
+
+in vec3 FragPos;
+
+uniform vec3 lightPos;
+uniform float lightRange;
+
+// Distance to the light over its range instead of the face's depth, so every face stores the same thing
+// and the lit pass compares one distance whatever face it reads
+void main()
+{
+    gl_FragDepth = length(FragPos - lightPos) / lightRange;
+}
\ No newline at end of file
@@ -0,0 +1,9 @@
+#version 330 core
+
+// One triangle covering the screen, drawn without vertex buffers, see source/hdr.c
+void main()
+{
+    // (-1, -1), (3, -1), (-1, 3)
+    vec2 pos = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(pos * 2.0 - 1.0, 0.0, 1.0);
+}
\ No newline at end of file
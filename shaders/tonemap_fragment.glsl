@@ -0,0 +1,25 @@
+#version 330 core
+
+// Resolves the HDR target into the window, its only read
+out vec4 FragColor;
+
+uniform sampler2D hdrColor; // Linear and unclamped, the size of the window
+uniform float exposure;
+uniform int encodeSrgb;     // The window does not encode to sRGB on write, do it here
+
+// Filmic curve fitted to ACES by Krzysztof Narkowicz
+vec3 acesFilm(vec3 x)
+{
+    return clamp((x * (2.51 * x + 0.03)) / (x * (2.43 * x + 0.59) + 0.14), 0.0, 1.0);
+}
+
+vec3 linearToSrgb(vec3 c)
+{
+    return mix(c * 12.92, 1.055 * pow(c, vec3(1.0 / 2.4)) - 0.055, step(vec3(0.0031308), c));
+}
+
+void main()
+{
+    vec3 color = acesFilm(texelFetch(hdrColor, ivec2(gl_FragCoord.xy), 0).rgb * exposure);
+    FragColor = vec4(encodeSrgb == 1 ? linearToSrgb(color) : color, 1.0);
+}
\ No newline at end of file
@@ -3,25 +3,80 @@
 layout (location = 0) in vec3 aPos;      // Position 
 layout (location = 1) in vec2 aTexCoord; // UVs
 layout (location = 2) in vec3 aNormal;   // Normals 
+layout (location = 3) in uint aBody;     // Per instance, index of the body left by culling
+layout (location = 4) in vec4 aTangent;  // Octahedral tangent in xy, bitangent sign in z
 
 // Sent from main
 out vec2 TexCoord;
 out vec3 Normal;
 out vec3 FragPos;
+flat out int BodyImage;
+flat out int BodyLight;
+#ifdef NORMAL_MAP
+out vec3 Tangent;
+out vec3 Bitangent;
+#endif
+
+// The depth prepass is another program, both must place every vertex at exactly the same depth
+invariant gl_Position;
 
 // Transform matrixes sent from main
-uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
+// Model matrices of every body, four texels each, written by the orbit pass
+uniform samplerBuffer bodyMatrices;
+
+// Atlas image of every body, -1 to use its material's diffuse map, then the light it carries, -1 without
+uniform isamplerBuffer bodyImages;
+
+#ifdef NORMAL_MAP
+// sign() without the 0, so the fold never collapses an axis
+vec2 signNotZero(vec2 v)
+{
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// Inverse of encodeOctahedral in tangents.c
+vec3 decodeOctahedral(vec2 e)
+{
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (v.z < 0.0) v.xy = (1.0 - abs(v.yx)) * signNotZero(v.xy);
+    return normalize(v);
+}
+#endif
+
 void main()
 {
+#ifdef DEFERRED_LIGHTING
+    // One triangle covering the screen, the lighting pass reads every surface from the G-buffer, see source/gbuffer.c
+    vec2 pos = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(pos * 2.0 - 1.0, 0.0, 1.0);
+    return;
+#endif
+
+    // Model matrix of this instance's body
+    int base = int(aBody) * 4;
+    mat4 model = mat4(texelFetch(bodyMatrices, base),
+                      texelFetch(bodyMatrices, base + 1),
+                      texelFetch(bodyMatrices, base + 2),
+                      texelFetch(bodyMatrices, base + 3));
+
     // Model transform
     FragPos = vec3(model * vec4(aPos, 1.0));
 
     TexCoord = aTexCoord;
+    ivec2 body = texelFetch(bodyImages, int(aBody)).rg;
+    BodyImage = body.x;
+    BodyLight = body.y;
     Normal = mat3(transpose(inverse(model))) * aNormal;  
 
+#ifdef NORMAL_MAP
+    // Tangents follow the surface, so the model matrix itself moves them
+    Tangent = normalize(mat3(model) * decodeOctahedral(aTangent.xy));
+    Bitangent = (aTangent.z < 0.0 ? -1.0 : 1.0) * cross(normalize(Normal), Tangent);
+#endif
+
     // View and Projection transform
     gl_Position = projection * view * vec4(FragPos, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,261 @@
+#include "../include/asset_registry.h"
+#include "../include/simplify.h"
+#include <stdio.h>
+#include <string.h>
+
+// Frees whatever the worker imported for an asset
+static void freeImported(Asset* asset){
+    if (asset->type == ASSET_TEXTURE || asset->type == ASSET_ATLAS_IMAGE){
+        freeImage(&asset->image);
+        freeAtlasImageLevels(&asset->atlasLevels);
+    }
+    else if (asset->type == ASSET_MESH){
+        freeObj(&asset->loadedObject);
+    }
+}
+
+// Imports one asset, runs on the worker without a GL context
+// 0 on failure, 1 on success
+static int importAsset(Asset* asset){
+    switch (asset->type){
+        // Mips are filtered here too, only the uploads are left for the main thread
+        case ASSET_TEXTURE:
+            return loadImage(asset->path, &asset->image) && generateImageMips(&asset->image, MIP_SRGB);
+        case ASSET_ATLAS_IMAGE:
+            if (loadImage(asset->path, &asset->image) == 0){
+                return 0;
+            }
+            // Bindless images are their own textures, texture array images are filtered as they sit in their layer
+            if (asset->atlasBindless){
+                return generateImageMips(&asset->image, asset->atlasSlot.space);
+            }
+            return filterAtlasImage(&asset->atlasSlot, &asset->image, &asset->atlasLevels);
+        case ASSET_MESH:
+            if (loadObj(asset->path, &asset->loadedObject) == 0){
+                return 0;
+            }
+            generateLods(&asset->loadedObject, asset->maxLods);
+            return 1;
+        case ASSET_MATERIAL:
+            return loadMtl(asset->path, &asset->loadedLibrary);
+    }
+    return 0;
+}
+
+// Imports queued assets one at a time
+static void* assetWorker(void* arg){
+    AssetRegistry* registry = (AssetRegistry*)arg;
+
+    pthread_mutex_lock(&registry->lock);
+    while (!registry->quit){
+        Asset* asset = NULL;
+        for (int i = 0; i < registry->numAssets; i++){
+            if (registry->assets[i].state == ASSET_QUEUED){
+                asset = &registry->assets[i];
+                break;
+            }
+        }
+        if (asset == NULL){
+            pthread_cond_wait(&registry->wake, &registry->lock);
+            continue;
+        }
+        asset->state = ASSET_LOADING;
+        asset->dirty = 0;
+        pthread_mutex_unlock(&registry->lock);
+
+        int success = importAsset(asset);
+
+        pthread_mutex_lock(&registry->lock);
+        if (success){
+            asset->state = ASSET_READY;
+        }
+        else {
+            // A half written file keeps the old asset, the next save tries again
+            printf("Asset reload failed, keeping the current one: (%s)\n", asset->path);
+            freeImported(asset);
+            asset->state = asset->dirty ? ASSET_QUEUED : ASSET_IDLE;
+        }
+    }
+    pthread_mutex_unlock(&registry->lock);
+    return NULL;
+}
+
+// Starts the import worker
+int initAssetRegistry(AssetRegistry* registry){
+    memset(registry, 0, sizeof(AssetRegistry));
+    if (initFileWatcher(&registry->watcher) == 0){
+        return 0;
+    }
+
+    pthread_mutex_init(&registry->lock, NULL);
+    pthread_cond_init(&registry->wake, NULL);
+    if (pthread_create(&registry->worker, NULL, assetWorker, registry) != 0){
+        printf("Failed to start asset worker\n");
+        pthread_mutex_destroy(&registry->lock);
+        pthread_cond_destroy(&registry->wake);
+        freeFileWatcher(&registry->watcher);
+        return 0;
+    }
+    return 1;
+}
+
+// Adds an asset, its id matches its watch id
+static Asset* trackAsset(AssetRegistry* registry, const char* path, AssetType type){
+    if (registry->numAssets >= MAX_ASSETS || watchFile(&registry->watcher, path) < 0){
+        printf("Can not track asset: (%s)\n", path);
+        return NULL;
+    }
+
+    // The worker only looks at assets below numAssets
+    pthread_mutex_lock(&registry->lock);
+    Asset* asset = &registry->assets[registry->numAssets];
+    memset(asset, 0, sizeof(Asset));
+    asset->type = type;
+    asset->path = path;
+    registry->numAssets++;
+    pthread_mutex_unlock(&registry->lock);
+    return asset;
+}
+
+// Tracks a texture made by loadTexture
+int trackTexture(AssetRegistry* registry, const char* path, GLuint texture){
+    Asset* asset = trackAsset(registry, path, ASSET_TEXTURE);
+    if (asset == NULL){
+        return -1;
+    }
+    asset->texture = texture;
+    return (int)(asset - registry->assets);
+}
+
+// Tracks an image of a built atlas
+int trackAtlasImage(AssetRegistry* registry, TextureAtlas* atlas, int image){
+    Asset* asset = trackAsset(registry, atlas->images[image].path, ASSET_ATLAS_IMAGE);
+    if (asset == NULL){
+        return -1;
+    }
+    // The main thread may rebuild the atlas while the worker imports
+    pthread_mutex_lock(&registry->lock);
+    asset->atlas = atlas;
+    asset->atlasImage = image;
+    asset->atlasBindless = atlas->bindless;
+    getAtlasSlot(atlas, image, &asset->atlasSlot);
+    pthread_mutex_unlock(&registry->lock);
+    return (int)(asset - registry->assets);
+}
+
+// Tracks an object made by loadObj
+int trackObj(AssetRegistry* registry, const char* path, LoadedObject* object, int maxLods){
+    Asset* asset = trackAsset(registry, path, ASSET_MESH);
+    if (asset == NULL){
+        return -1;
+    }
+    asset->object = object;
+    asset->maxLods = maxLods;
+    return (int)(asset - registry->assets);
+}
+
+// Tracks a material library made by loadMtl
+int trackMtl(AssetRegistry* registry, const char* path, MaterialLibrary* library){
+    Asset* asset = trackAsset(registry, path, ASSET_MATERIAL);
+    if (asset == NULL){
+        return -1;
+    }
+    asset->library = library;
+    return (int)(asset - registry->assets);
+}
+
+// Puts an imported asset in place of the old one, on the main thread
+static void applyAsset(Asset* asset){
+    switch (asset->type){
+        case ASSET_TEXTURE: {
+            // Keep whatever the active unit had bound
+            GLint bound;
+            glGetIntegerv(GL_TEXTURE_BINDING_2D, &bound);
+            uploadTexture(asset->texture, &asset->image);
+            glBindTexture(GL_TEXTURE_2D, bound);
+            freeImage(&asset->image);
+            break;
+        }
+        case ASSET_ATLAS_IMAGE: {
+            // Bindless images are plain 2D textures
+            GLint bound, bound2D;
+            glGetIntegerv(GL_TEXTURE_BINDING_2D_ARRAY, &bound);
+            glGetIntegerv(GL_TEXTURE_BINDING_2D, &bound2D);
+            if (updateAtlasImage(asset->atlas, asset->atlasImage, &asset->image, &asset->atlasLevels) == 0){
+                buildTextureAtlas(asset->atlas);
+            }
+            glBindTexture(GL_TEXTURE_2D_ARRAY, bound);
+            glBindTexture(GL_TEXTURE_2D, bound2D);
+            freeImage(&asset->image);
+            freeAtlasImageLevels(&asset->atlasLevels);
+
+            // Other images moved by a new packing find out when they are next applied, and are filtered here that once
+            getAtlasSlot(asset->atlas, asset->atlasImage, &asset->atlasSlot);
+            break;
+        }
+        case ASSET_MESH:
+            freeObj(asset->object);
+            *asset->object = asset->loadedObject;
+            memset(&asset->loadedObject, 0, sizeof(LoadedObject));
+            break;
+        case ASSET_MATERIAL:
+            *asset->library = asset->loadedLibrary;
+            break;
+    }
+    asset->changed = 1;
+    printf("Asset reloaded: (%s)\n", asset->path);
+}
+
+// Call once per frame on the main thread, between frames
+int updateAssetRegistry(AssetRegistry* registry){
+    int changed[MAX_WATCHED_FILES];
+    int numChanged = pollFileChanges(&registry->watcher, changed, MAX_WATCHED_FILES);
+
+    int numApplied = 0;
+    pthread_mutex_lock(&registry->lock);
+
+    // Queue changed files, or mark them to go again if the worker already has them
+    for (int i = 0; i < numChanged; i++){
+        Asset* asset = &registry->assets[changed[i]];
+        if (asset->state == ASSET_IDLE){
+            asset->state = ASSET_QUEUED;
+        }
+        else {
+            asset->dirty = 1;
+        }
+    }
+
+    // Swap in finished imports, the worker does not touch ready assets
+    for (int i = 0; i < registry->numAssets; i++){
+        Asset* asset = &registry->assets[i];
+        asset->changed = 0;
+        if (asset->state == ASSET_READY){
+            applyAsset(asset);
+            asset->state = asset->dirty ? ASSET_QUEUED : ASSET_IDLE;
+            numApplied++;
+        }
+    }
+
+    if (numChanged > 0){
+        pthread_cond_signal(&registry->wake);
+    }
+    pthread_mutex_unlock(&registry->lock);
+    return numApplied;
+}
+
+// Stops the worker and frees pending imports
+void freeAssetRegistry(AssetRegistry* registry){
+    pthread_mutex_lock(&registry->lock);
+    registry->quit = 1;
+    pthread_cond_signal(&registry->wake);
+    pthread_mutex_unlock(&registry->lock);
+    pthread_join(registry->worker, NULL);
+
+    for (int i = 0; i < registry->numAssets; i++){
+        freeImported(&registry->assets[i]);
+    }
+    pthread_mutex_destroy(&registry->lock);
+    pthread_cond_destroy(&registry->wake);
+    freeFileWatcher(&registry->watcher);
+    memset(registry, 0, sizeof(AssetRegistry));
+}
\ No newline at end of file
@@ -0,0 +1,27 @@
+#include "../include/bindless.h"
+#include <GLFW/glfw3.h>
+#include <stdio.h>
+
+PFNGLGETTEXTUREHANDLEARBPROC glGetTextureHandleARB = NULL;
+PFNGLGETTEXTURESAMPLERHANDLEARBPROC glGetTextureSamplerHandleARB = NULL;
+PFNGLMAKETEXTUREHANDLERESIDENTARBPROC glMakeTextureHandleResidentARB = NULL;
+PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC glMakeTextureHandleNonResidentARB = NULL;
+
+// Checks the extension string and loads the entry points
+int loadBindlessTexture(void){
+    if (!glfwExtensionSupported("GL_ARB_bindless_texture")){
+        printf("Bindless textures: not supported\n");
+        return 0;
+    }
+
+    glGetTextureHandleARB = (PFNGLGETTEXTUREHANDLEARBPROC)glfwGetProcAddress("glGetTextureHandleARB");
+    glGetTextureSamplerHandleARB = (PFNGLGETTEXTURESAMPLERHANDLEARBPROC)glfwGetProcAddress("glGetTextureSamplerHandleARB");
+    glMakeTextureHandleResidentARB = (PFNGLMAKETEXTUREHANDLERESIDENTARBPROC)glfwGetProcAddress("glMakeTextureHandleResidentARB");
+    glMakeTextureHandleNonResidentARB = (PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC)glfwGetProcAddress("glMakeTextureHandleNonResidentARB");
+    if (!glGetTextureHandleARB || !glGetTextureSamplerHandleARB || !glMakeTextureHandleResidentARB || !glMakeTextureHandleNonResidentARB){
+        printf("Bindless textures: entry points missing\n");
+        return 0;
+    }
+    printf("Bindless textures: supported\n");
+    return 1;
+}
\ No newline at end of file
@@ -0,0 +1,48 @@
+#include "../include/bounds.h"
+#include <math.h>
+#include <string.h>
+
+// Calculates the bounds of a vertex array
+void computeBounds(const void* vertices, int numVertices, size_t stride, Bounds* bounds){
+    memset(bounds, 0, sizeof(Bounds));
+    if (numVertices <= 0){
+        return;
+    }
+
+    // Box
+    const char* data = (const char*)vertices;
+    const float* first = (const float*)data;
+    for (int k = 0; k < 3; k++){
+        bounds->min[k] = bounds->max[k] = first[k];
+    }
+    for (int i = 1; i < numVertices; i++){
+        const float* pos = (const float*)(data + i * stride);
+        for (int k = 0; k < 3; k++){
+            if (pos[k] < bounds->min[k]) bounds->min[k] = pos[k];
+            if (pos[k] > bounds->max[k]) bounds->max[k] = pos[k];
+        }
+    }
+
+    // Sphere centered on the box, radius from the farthest vertex
+    for (int k = 0; k < 3; k++){
+        bounds->center[k] = (bounds->min[k] + bounds->max[k]) * 0.5f;
+    }
+    float maxDist = 0.0f;
+    for (int i = 0; i < numVertices; i++){
+        const float* pos = (const float*)(data + i * stride);
+        float dx = pos[0] - bounds->center[0];
+        float dy = pos[1] - bounds->center[1];
+        float dz = pos[2] - bounds->center[2];
+        float dist = dx * dx + dy * dy + dz * dz;
+        if (dist > maxDist) maxDist = dist;
+    }
+    bounds->radius = sqrtf(maxDist);
+}
+
+// Radius of a sphere around the model origin that contains the bounds under any rotation
+float boundsOriginRadius(const Bounds* bounds){
+    float c = sqrtf(bounds->center[0] * bounds->center[0] +
+                    bounds->center[1] * bounds->center[1] +
+                    bounds->center[2] * bounds->center[2]);
+    return c + bounds->radius;
+}
\ No newline at end of file
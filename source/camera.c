@@ -50,6 +50,7 @@ void updateCameraMatrix(Camera* camera){
 
     // Position never changes
     vec3 cameraPos = {STATIC_POS_X, STATIC_POS_Y, STATIC_POS_Z};
+    glm_vec3_copy(cameraPos, camera->position);
 
     // Calculate target
     vec3 target;
@@ -0,0 +1,328 @@
+#include "../include/culling.h"
+#include "../include/shader.h"
+#include "../include/radix_sort.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+
+// Four bodies per test when SSE is available
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#define CULL_SIMD 1
+#endif
+
+// Prepares the culler, the GPU mode falls back to CPU if its shaders fail
+void initCuller(Culler* culler, CullMode mode, int matrixUnit){
+    memset(culler, 0, sizeof(Culler));
+    culler->mode = mode;
+    if (mode != CULL_GPU){
+        return;
+    }
+
+    // Visible body indices are emitted by the geometry shader
+    const char* varyings[] = {"VisibleIndex"};
+    culler->program = loadFeedbackShader("shaders/cull.glsl", "shaders/cull_geometry.glsl", varyings, 1);
+    if (culler->program == 0){
+        printf("Culling: GPU shaders failed, falling back to CPU culling\n");
+        culler->mode = CULL_CPU;
+        return;
+    }
+    culler->firstBodyLoc = glGetUniformLocation(culler->program, "firstBody");
+    culler->radiusLoc = glGetUniformLocation(culler->program, "radius");
+    culler->planesLoc = glGetUniformLocation(culler->program, "planes");
+    culler->cameraPosLoc = glGetUniformLocation(culler->program, "cameraPos");
+    culler->minDistanceLoc = glGetUniformLocation(culler->program, "minDistance");
+    culler->maxDistanceLoc = glGetUniformLocation(culler->program, "maxDistance");
+
+    glUseProgram(culler->program);
+    glUniform1i(glGetUniformLocation(culler->program, "bodyMatrices"), matrixUnit);
+
+    // The pass reads no attributes, but core profile needs a VAO to draw
+    glGenVertexArrays(1, &culler->emptyVAO);
+}
+
+// Sets the projection used to pick detail levels
+// An error of e model units at distance d covers e * lodScale / d pixels
+void setCullerProjection(Culler* culler, mat4 projection, int screenHeight){
+    culler->lodScale = projection[1][1] * screenHeight * 0.5f / LOD_PIXEL_ERROR;
+}
+
+// Creates the index buffer of a batch and sets it as attribute 3 (divisor 1) of the given VAO
+int initCullBatch(CullBatch* batch, GLuint vao, int firstBody, int numBodies, float radius, const MeshLod* lods, int numLods){
+    memset(batch, 0, sizeof(CullBatch));
+    batch->firstBody = firstBody;
+    batch->numBodies = numBodies;
+    batch->radius = radius;
+
+    batch->numLods = lods ? numLods : 1;
+    for (int i = 0; i < batch->numLods; i++){
+        batch->lodError[i] = lods ? lods[i].error : 0.0f;
+    }
+
+    // Every body is visible at full detail until the first cull
+    int capacity = numBodies * batch->numLods;
+    batch->cpuIndices = (GLuint*)calloc(capacity > 0 ? capacity : 1, sizeof(GLuint));
+    batch->sortKeys = (uint32_t*)malloc((capacity > 0 ? capacity : 1) * sizeof(uint32_t));
+    batch->tempKeys = (uint32_t*)malloc((numBodies > 0 ? numBodies : 1) * sizeof(uint32_t));
+    batch->tempIndices = (uint32_t*)malloc((numBodies > 0 ? numBodies : 1) * sizeof(uint32_t));
+    if (!batch->cpuIndices || !batch->sortKeys || !batch->tempKeys || !batch->tempIndices){
+        printf("Failed to allocate cull batch: (%d) bodies\n", numBodies);
+        freeCullBatch(batch);
+        return 0;
+    }
+    for (int i = 0; i < numBodies; i++){
+        batch->cpuIndices[i] = firstBody + i;
+    }
+    batch->visible = numBodies;
+    batch->lodVisible[0] = numBodies;
+
+    glBindVertexArray(vao);
+    glGenBuffers(1, &batch->indexVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, batch->indexVBO);
+    glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(GLuint), batch->cpuIndices, GL_DYNAMIC_COPY);
+
+    // Body index, one per instance
+    glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+    glEnableVertexAttribArray(3);
+    glVertexAttribDivisor(3, 1);
+
+    glGenQueries(batch->numLods, batch->queries);
+    return 1;
+}
+
+// Points attribute 3 of the bound VAO at the visible bodies of the given level
+void bindCullBatchLod(CullBatch* batch, int lod){
+    glBindBuffer(GL_ARRAY_BUFFER, batch->indexVBO);
+    size_t offset = (size_t)lod * batch->numBodies * sizeof(GLuint);
+    glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)offset);
+}
+
+// Extracts the six planes from a projection * view matrix
+// Each plane is a sum or difference of the fourth row with one of the others
+void extractFrustum(mat4 viewProjection, Frustum* frustum){
+    for (int i = 0; i < 6; i++){
+        int row = i / 2;
+        float sign = (i % 2 == 0) ? 1.0f : -1.0f;
+        for (int col = 0; col < 4; col++){
+            frustum->planes[i][col] = viewProjection[col][3] + sign * viewProjection[col][row];
+        }
+
+        // Normalize so the distances are in world units
+        float length = sqrtf(frustum->planes[i][0] * frustum->planes[i][0] +
+                             frustum->planes[i][1] * frustum->planes[i][1] +
+                             frustum->planes[i][2] * frustum->planes[i][2]);
+        glm_vec4_scale(frustum->planes[i], 1.0f / length, frustum->planes[i]);
+    }
+}
+
+// Squared distance from which each level of the batch may be used
+static void lodDistances(Culler* culler, CullBatch* batch, float* minDistance2){
+    for (int i = 0; i < batch->numLods; i++){
+        float d = batch->lodError[i] * culler->lodScale;
+        minDistance2[i] = d * d;
+    }
+}
+
+// Adds a visible body to the list of its detail level
+static void emitVisible(CullBatch* batch, const float* minDistance2, float distance2, GLuint body){
+    int lod = batch->numLods - 1;
+    while (lod > 0 && distance2 < minDistance2[lod]){
+        lod--;
+    }
+    int slot = lod * batch->numBodies + batch->lodVisible[lod]++;
+    batch->cpuIndices[slot] = body;
+    batch->sortKeys[slot] = floatSortKey(distance2);
+    if (distance2 < batch->nearest){
+        batch->nearest = distance2;
+    }
+}
+
+// Tests the spheres of a batch's bodies against the frustum and sorts the visible ones by level
+static void cullBatchCPU(Culler* culler, OrbitSystem* orbits, vec3 cameraPos, CullBatch* batch){
+    const Frustum* frustum = &culler->frustum;
+    int first = batch->firstBody;
+    int count = batch->numBodies;
+    float radius = batch->radius;
+    const float* px = orbits->posX + first;
+    const float* py = orbits->posY + first;
+    const float* pz = orbits->posZ + first;
+
+    float minDistance2[MAX_LODS];
+    lodDistances(culler, batch, minDistance2);
+    memset(batch->lodVisible, 0, sizeof(batch->lodVisible));
+    batch->nearest = FLT_MAX;
+    int i = 0;
+
+#ifdef CULL_SIMD
+    __m128 negRadius = _mm_set1_ps(-radius);
+    for (; i + 4 <= count; i += 4){
+        __m128 x = _mm_loadu_ps(px + i);
+        __m128 y = _mm_loadu_ps(py + i);
+        __m128 z = _mm_loadu_ps(pz + i);
+
+        // A sphere is outside if it is fully behind any plane
+        __m128 inside = _mm_setzero_ps();
+        for (int p = 0; p < 6; p++){
+            __m128 d = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(frustum->planes[p][0])),
+                           _mm_mul_ps(y, _mm_set1_ps(frustum->planes[p][1]))),
+                _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(frustum->planes[p][2])),
+                           _mm_set1_ps(frustum->planes[p][3])));
+            __m128 test = _mm_cmpge_ps(d, negRadius);
+            inside = (p == 0) ? test : _mm_and_ps(inside, test);
+        }
+
+        // Squared distances to the camera, for the detail level
+        __m128 dx = _mm_sub_ps(x, _mm_set1_ps(cameraPos[0]));
+        __m128 dy = _mm_sub_ps(y, _mm_set1_ps(cameraPos[1]));
+        __m128 dz = _mm_sub_ps(z, _mm_set1_ps(cameraPos[2]));
+        float distance2[4];
+        _mm_storeu_ps(distance2, _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+
+        // Compact the four results
+        int mask = _mm_movemask_ps(inside);
+        for (int k = 0; k < 4; k++){
+            if (mask & (1 << k)){
+                emitVisible(batch, minDistance2, distance2[k], first + i + k);
+            }
+        }
+    }
+#endif
+
+    // Remainder, or everything without SSE
+    for (; i < count; i++){
+        int inside = 1;
+        for (int p = 0; p < 6 && inside; p++){
+            float d = frustum->planes[p][0] * px[i] + frustum->planes[p][1] * py[i] +
+                      frustum->planes[p][2] * pz[i] + frustum->planes[p][3];
+            inside = d >= -radius;
+        }
+        if (inside){
+            float dx = px[i] - cameraPos[0], dy = py[i] - cameraPos[1], dz = pz[i] - cameraPos[2];
+            emitVisible(batch, minDistance2, dx * dx + dy * dy + dz * dz, first + i);
+        }
+    }
+
+    // Nearest first within each level, stable so equal distances keep body order
+    if (culler->frontToBack){
+        for (int lod = 0; lod < batch->numLods; lod++){
+            size_t offset = (size_t)lod * count;
+            radixSort32(batch->sortKeys + offset, batch->cpuIndices + offset, batch->lodVisible[lod],
+                        batch->tempKeys, batch->tempIndices);
+        }
+    }
+    batch->nearest = batch->nearest < FLT_MAX ? sqrtf(batch->nearest) : FLT_MAX;
+
+    // Upload the used part of every level's region
+    batch->visible = 0;
+    glBindBuffer(GL_ARRAY_BUFFER, batch->indexVBO);
+    for (int lod = 0; lod < batch->numLods; lod++){
+        if (batch->lodVisible[lod] > 0){
+            size_t offset = (size_t)lod * count * sizeof(GLuint);
+            glBufferSubData(GL_ARRAY_BUFFER, offset, batch->lodVisible[lod] * sizeof(GLuint), batch->cpuIndices + lod * count);
+        }
+        batch->visible += batch->lodVisible[lod];
+    }
+    batch->culled = count - batch->visible;
+}
+
+// Runs the feedback pass of every batch and level, then reads back the visible counts
+static void cullBodiesGPU(Culler* culler, vec3 cameraPos, CullBatch* batches, int numBatches){
+    glUseProgram(culler->program);
+    glUniform4fv(culler->planesLoc, 6, (float*)culler->frustum.planes);
+    glUniform3fv(culler->cameraPosLoc, 1, cameraPos);
+
+    glEnable(GL_RASTERIZER_DISCARD);
+    glBindVertexArray(culler->emptyVAO);
+    for (int i = 0; i < numBatches; i++){
+        CullBatch* batch = &batches[i];
+        if (batch->numBodies == 0){
+            continue;
+        }
+        glUniform1i(culler->firstBodyLoc, batch->firstBody);
+        glUniform1f(culler->radiusLoc, batch->radius);
+
+        // Each level keeps the bodies in its distance range
+        for (int lod = 0; lod < batch->numLods; lod++){
+            float minDistance = lod == 0 ? 0.0f : batch->lodError[lod] * culler->lodScale;
+            float maxDistance = lod == batch->numLods - 1 ? FLT_MAX : batch->lodError[lod + 1] * culler->lodScale;
+            glUniform1f(culler->minDistanceLoc, minDistance);
+            glUniform1f(culler->maxDistanceLoc, maxDistance);
+
+            // One point per body, only the visible ones reach the level's region
+            size_t regionSize = batch->numBodies * sizeof(GLuint);
+            glBindBufferRange(GL_TRANSFORM_FEEDBACK_BUFFER, 0, batch->indexVBO, lod * regionSize, regionSize);
+            glBeginQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN, batch->queries[lod]);
+            glBeginTransformFeedback(GL_POINTS);
+            glDrawArrays(GL_POINTS, 0, batch->numBodies);
+            glEndTransformFeedback();
+            glEndQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
+        }
+    }
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    glDisable(GL_RASTERIZER_DISCARD);
+
+    // The instance counts are needed this frame, so this waits for the passes above
+    // Indirect draws would avoid the wait but need GL 4.0
+    for (int i = 0; i < numBatches; i++){
+        CullBatch* batch = &batches[i];
+        batch->visible = 0;
+        for (int lod = 0; lod < batch->numLods; lod++){
+            GLuint written = 0;
+            if (batch->numBodies > 0){
+                glGetQueryObjectuiv(batch->queries[lod], GL_QUERY_RESULT, &written);
+            }
+            batch->lodVisible[lod] = written;
+            batch->visible += written;
+        }
+        batch->culled = batch->numBodies - batch->visible;
+        batch->nearest = 0.0f;
+    }
+}
+
+// Tests every body of the given batches and fills their visible index lists
+void cullBodies(Culler* culler, OrbitSystem* orbits, float time, mat4 viewProjection, vec3 cameraPos,
+                CullBatch* batches, int numBatches){
+    if (culler->mode == CULL_NONE){
+        for (int i = 0; i < numBatches; i++){
+            memset(batches[i].lodVisible, 0, sizeof(batches[i].lodVisible));
+            batches[i].lodVisible[0] = batches[i].numBodies;
+            batches[i].visible = batches[i].numBodies;
+            batches[i].culled = 0;
+            batches[i].nearest = 0.0f;
+        }
+        return;
+    }
+
+    extractFrustum(viewProjection, &culler->frustum);
+    if (culler->mode == CULL_GPU){
+        cullBodiesGPU(culler, cameraPos, batches, numBatches);
+        return;
+    }
+
+    // The CPU orbit path has filled the positions already
+    if (orbits->useGPU){
+        updateOrbitPositions(orbits, time);
+    }
+    for (int i = 0; i < numBatches; i++){
+        cullBatchCPU(culler, orbits, cameraPos, &batches[i]);
+    }
+}
+
+// Frees the GPU objects
+void freeCullBatch(CullBatch* batch){
+    free(batch->cpuIndices);
+    free(batch->sortKeys);
+    free(batch->tempKeys);
+    free(batch->tempIndices);
+    if (batch->indexVBO) glDeleteBuffers(1, &batch->indexVBO);
+    if (batch->queries[0]) glDeleteQueries(batch->numLods, batch->queries);
+    memset(batch, 0, sizeof(CullBatch));
+}
+
+void freeCuller(Culler* culler){
+    if (culler->program) glDeleteProgram(culler->program);
+    if (culler->emptyVAO) glDeleteVertexArrays(1, &culler->emptyVAO);
+    memset(culler, 0, sizeof(Culler));
+}
\ No newline at end of file
@@ -0,0 +1,130 @@
+#include "../include/file_watch.h"
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// Modification time of a file, 0 if it can not be read
+static time_t modifiedTime(const char* path){
+    struct stat info;
+    if (stat(path, &info) != 0){
+        return 0;
+    }
+    return info.st_mtime;
+}
+
+// Adds an id to the list unless it is already there
+static int addChange(int* changed, int count, int maxChanged, int id){
+    for (int i = 0; i < count; i++){
+        if (changed[i] == id){
+            return count;
+        }
+    }
+    if (count < maxChanged){
+        changed[count++] = id;
+    }
+    return count;
+}
+
+// Sets up an empty watcher
+int initFileWatcher(FileWatcher* watcher){
+    memset(watcher, 0, sizeof(FileWatcher));
+    watcher->fd = -1;
+#ifdef __linux__
+    watcher->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watcher->fd < 0){
+        printf("inotify unavailable, polling file times instead\n");
+    }
+#endif
+    return 1;
+}
+
+// Starts following a file
+int watchFile(FileWatcher* watcher, const char* path){
+    if (watcher->numFiles >= MAX_WATCHED_FILES || strlen(path) >= WATCH_PATH_LENGTH){
+        printf("Can not watch file: (%s)\n", path);
+        return -1;
+    }
+
+    int id = watcher->numFiles;
+    strcpy(watcher->paths[id], path);
+    const char* slash = strrchr(watcher->paths[id], '/');
+    watcher->names[id] = slash ? slash + 1 : watcher->paths[id];
+    watcher->modified[id] = modifiedTime(path);
+    watcher->watches[id] = -1;
+
+#ifdef __linux__
+    // Editors often write a new file and rename it over the old one, so follow the directory
+    if (watcher->fd >= 0){
+        char directory[WATCH_PATH_LENGTH];
+        if (slash){
+            int length = (int)(slash - watcher->paths[id]);
+            memcpy(directory, path, length);
+            directory[length] = '\0';
+        }
+        else {
+            strcpy(directory, ".");
+        }
+        watcher->watches[id] = inotify_add_watch(watcher->fd, directory, IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+        if (watcher->watches[id] < 0){
+            printf("Failed to watch directory: (%s)\n", directory);
+        }
+    }
+#endif
+
+    watcher->numFiles++;
+    return id;
+}
+
+// Writes the ids of the files changed since the last call
+int pollFileChanges(FileWatcher* watcher, int* changed, int maxChanged){
+    int count = 0;
+
+#ifdef __linux__
+    if (watcher->fd >= 0){
+        // Drain every pending event, the descriptor is non blocking
+        char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+        ssize_t length;
+        while ((length = read(watcher->fd, buffer, sizeof(buffer))) > 0){
+            for (char* p = buffer; p < buffer + length; ){
+                const struct inotify_event* event = (const struct inotify_event*)p;
+                if (event->len > 0){
+                    for (int i = 0; i < watcher->numFiles; i++){
+                        if (watcher->watches[i] == event->wd && strcmp(watcher->names[i], event->name) == 0){
+                            count = addChange(changed, count, maxChanged, i);
+                        }
+                    }
+                }
+                p += sizeof(struct inotify_event) + event->len;
+            }
+        }
+        return count;
+    }
+#endif
+
+    // No inotify, compare modification times
+    for (int i = 0; i < watcher->numFiles; i++){
+        time_t modified = modifiedTime(watcher->paths[i]);
+        if (modified != 0 && modified != watcher->modified[i]){
+            watcher->modified[i] = modified;
+            count = addChange(changed, count, maxChanged, i);
+        }
+    }
+    return count;
+}
+
+// Stops following every file
+void freeFileWatcher(FileWatcher* watcher){
+#ifdef __linux__
+    // Closing the descriptor removes every watch
+    if (watcher->fd >= 0){
+        close(watcher->fd);
+    }
+#endif
+    memset(watcher, 0, sizeof(FileWatcher));
+    watcher->fd = -1;
+}
\ No newline at end of file
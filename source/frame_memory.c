@@ -0,0 +1,193 @@
+#include "../include/frame_memory.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Header in front of an overflow block, rounded up so what follows stays aligned
+#define OVERFLOW_HEADER ((sizeof(ArenaOverflow) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1))
+
+static size_t alignSize(size_t size){
+    return (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+}
+
+// --------- Arena ---------
+
+// Allocates the arena's first block
+int initArena(Arena* arena, size_t capacity){
+    memset(arena, 0, sizeof(Arena));
+    capacity = alignSize(capacity > 0 ? capacity : ARENA_ALIGNMENT);
+    arena->base = (unsigned char*)malloc(capacity);
+    if (arena->base == NULL){
+        printf("Failed to allocate frame arena: (%zu bytes)\n", capacity);
+        return 0;
+    }
+    arena->capacity = capacity;
+    return 1;
+}
+
+// Takes the next aligned bytes, or an overflow block when the arena is full
+void* arenaAlloc(Arena* arena, size_t size){
+    size = alignSize(size > 0 ? size : 1);
+
+    void* memory;
+    if (arena->used + size <= arena->capacity){
+        memory = arena->base + arena->used;
+        arena->used += size;
+    }
+    else {
+        ArenaOverflow* block = (ArenaOverflow*)malloc(OVERFLOW_HEADER + size);
+        if (block == NULL){
+            printf("Failed to allocate frame arena overflow: (%zu bytes)\n", size);
+            return NULL;
+        }
+        block->next = arena->overflow;
+        arena->overflow = block;
+        arena->overflowUsed += size;
+        memory = (unsigned char*)block + OVERFLOW_HEADER;
+    }
+
+    size_t inUse = arena->used + arena->overflowUsed;
+    if (inUse > arena->peak){
+        arena->peak = inUse;
+    }
+    return memory;
+}
+
+// Frees the overflow blocks, then grows the arena so a frame like the last one fits
+void resetArena(Arena* arena){
+    size_t total = arena->used + arena->overflowUsed;
+    while (arena->overflow){
+        ArenaOverflow* next = arena->overflow->next;
+        free(arena->overflow);
+        arena->overflow = next;
+    }
+
+    if (arena->overflowUsed > 0){
+        // Half again the frame's use, so a slowly growing scene doesn't grow it every frame
+        size_t capacity = alignSize(total + total / 2);
+        unsigned char* base = (unsigned char*)malloc(capacity);
+        if (base){
+            free(arena->base);
+            arena->base = base;
+            arena->capacity = capacity;
+            arena->grown++;
+        }
+    }
+    arena->used = 0;
+    arena->overflowUsed = 0;
+}
+
+void freeArena(Arena* arena){
+    resetArena(arena);
+    free(arena->base);
+    memset(arena, 0, sizeof(Arena));
+}
+
+// --------- Pool ---------
+
+// Allocates the blocks and links them all into the free list
+int initPool(Pool* pool, size_t blockSize, int capacity){
+    memset(pool, 0, sizeof(Pool));
+    // A free block holds the link to the next one
+    blockSize = alignSize(blockSize > sizeof(void*) ? blockSize : sizeof(void*));
+    pool->blocks = (unsigned char*)malloc(blockSize * (capacity > 0 ? capacity : 1));
+    if (pool->blocks == NULL){
+        printf("Failed to allocate pool: (%d blocks of %zu bytes)\n", capacity, blockSize);
+        return 0;
+    }
+    pool->blockSize = blockSize;
+    pool->capacity = capacity;
+
+    // Linked back to front, so the first allocations come from the start of the memory
+    for (int i = capacity - 1; i >= 0; i--){
+        void** block = (void**)(pool->blocks + i * blockSize);
+        *block = pool->freeList;
+        pool->freeList = block;
+    }
+    return 1;
+}
+
+// Pops the free list
+void* poolAlloc(Pool* pool){
+    if (pool->freeList == NULL){
+        pool->exhausted++;
+        return NULL;
+    }
+    void** block = (void**)pool->freeList;
+    pool->freeList = *block;
+    pool->used++;
+    if (pool->used > pool->peak){
+        pool->peak = pool->used;
+    }
+    return block;
+}
+
+// Pushes the block back on the free list
+void poolFree(Pool* pool, void* block){
+    if (block == NULL){
+        return;
+    }
+    *(void**)block = pool->freeList;
+    pool->freeList = block;
+    pool->used--;
+}
+
+void freePool(Pool* pool){
+    free(pool->blocks);
+    memset(pool, 0, sizeof(Pool));
+}
+
+// --------- Heap counters ---------
+
+// The makefile links with --wrap for each of these, so every call in this program's objects lands here first
+// Calls inside GLFW, the driver and libc itself are not counted
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* memory, size_t size);
+void __real_free(void* memory);
+
+// Updated from any thread
+static long long heapAllocations;
+static long long heapFrees;
+static long long heapBytes;
+
+static void countAllocation(size_t bytes){
+    __atomic_fetch_add(&heapAllocations, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&heapBytes, (long long)bytes, __ATOMIC_RELAXED);
+}
+
+void* __wrap_malloc(size_t size){
+    countAllocation(size);
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size){
+    countAllocation(count * size);
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* memory, size_t size){
+    countAllocation(size);
+    return __real_realloc(memory, size);
+}
+
+void __wrap_free(void* memory){
+    if (memory){
+        __atomic_fetch_add(&heapFrees, 1, __ATOMIC_RELAXED);
+    }
+    __real_free(memory);
+}
+
+// Copies the counters, then resets them if asked
+void readHeapCounters(HeapCounters* counters, int reset){
+    if (reset){
+        counters->allocations = __atomic_exchange_n(&heapAllocations, 0, __ATOMIC_RELAXED);
+        counters->frees = __atomic_exchange_n(&heapFrees, 0, __ATOMIC_RELAXED);
+        counters->bytes = __atomic_exchange_n(&heapBytes, 0, __ATOMIC_RELAXED);
+    }
+    else {
+        counters->allocations = __atomic_load_n(&heapAllocations, __ATOMIC_RELAXED);
+        counters->frees = __atomic_load_n(&heapFrees, __ATOMIC_RELAXED);
+        counters->bytes = __atomic_load_n(&heapBytes, __ATOMIC_RELAXED);
+    }
+}
\ No newline at end of file
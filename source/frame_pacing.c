@@ -0,0 +1,115 @@
+#include "../include/frame_pacing.h"
+#include <GLFW/glfw3.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+// Sets the swap interval of the current context for the mode
+void initFramePacer(FramePacer* pacer, PacingMode mode, double capFps){
+    memset(pacer, 0, sizeof(FramePacer));
+    pacer->margin = PACING_MAX_MARGIN;
+
+    // A negative interval is adaptive vsync, only valid with the tear extension of the platform
+    if (mode == PACING_ADAPTIVE && !glfwExtensionSupported("WGL_EXT_swap_control_tear") &&
+        !glfwExtensionSupported("GLX_EXT_swap_control_tear")){
+        printf("Adaptive vsync unsupported, using vsync\n");
+        mode = PACING_VSYNC;
+    }
+    if (mode == PACING_CAPPED && capFps <= 0.0){
+        mode = PACING_UNCAPPED;
+    }
+    pacer->mode = mode;
+
+    switch (mode){
+        case PACING_VSYNC: glfwSwapInterval(1); break;
+        case PACING_ADAPTIVE: glfwSwapInterval(-1); break;
+        default: glfwSwapInterval(0); break;
+    }
+    if (mode == PACING_CAPPED){
+        pacer->interval = 1.0 / capFps;
+        printf("Frame pacing: (%s) at %.1f fps\n", pacingModeName(mode), capFps);
+    }
+    else {
+        printf("Frame pacing: (%s)\n", pacingModeName(mode));
+    }
+    pacer->lastPresent = glfwGetTime();
+    pacer->deadline = pacer->lastPresent + pacer->interval;
+}
+
+// Holds the frame until its deadline in the capped mode
+void paceFrame(FramePacer* pacer){
+    if (pacer->mode != PACING_CAPPED){
+        return;
+    }
+
+    // Sleep through most of the wait, the thread gives its core back
+    double start = glfwGetTime();
+    double wake = pacer->deadline - pacer->margin;
+    if (wake > start){
+        double seconds = wake - start;
+        struct timespec request;
+        request.tv_sec = (time_t)seconds;
+        request.tv_nsec = (long)((seconds - request.tv_sec) * 1e9);
+        nanosleep(&request, NULL);
+
+        // Widen the margin to the worst oversleep, narrow it back a little every frame
+        double woke = glfwGetTime();
+        double oversleep = woke - wake;
+        pacer->margin = fmax(pacer->margin * 0.99, oversleep * 1.25);
+        pacer->margin = fmin(fmax(pacer->margin, PACING_MIN_MARGIN), PACING_MAX_MARGIN);
+        pacer->slept += woke - start;
+    }
+
+    // Spin the rest, far more precise than any sleep
+    double spinStart = glfwGetTime();
+    double now = spinStart;
+    while (now < pacer->deadline){
+        now = glfwGetTime();
+    }
+    pacer->spun += now - spinStart;
+
+    // A frame that missed its deadline by a whole interval starts a new schedule instead of rushing the next ones
+    pacer->deadline += pacer->interval;
+    if (pacer->deadline < now){
+        pacer->deadline = now + pacer->interval;
+    }
+}
+
+// Records the interval since the last present
+void recordFramePresented(FramePacer* pacer){
+    double now = glfwGetTime();
+    double interval = now - pacer->lastPresent;
+    pacer->lastPresent = now;
+
+    pacer->samples++;
+    pacer->sum += interval;
+    pacer->sumSquares += interval * interval;
+    if (interval > pacer->worst){
+        pacer->worst = interval;
+    }
+}
+
+// Copies the statistics since the last read, then resets them
+void readFramePacingStats(FramePacer* pacer, FramePacingStats* stats){
+    memset(stats, 0, sizeof(FramePacingStats));
+    stats->frames = pacer->samples;
+    if (pacer->samples > 0){
+        double mean = pacer->sum / pacer->samples;
+        double variance = pacer->sumSquares / pacer->samples - mean * mean;
+        stats->meanInterval = 1000.0 * mean;
+        stats->jitter = 1000.0 * sqrt(variance > 0.0 ? variance : 0.0);
+        stats->worstInterval = 1000.0 * pacer->worst;
+        stats->slept = 1000.0 * pacer->slept / pacer->samples;
+        stats->spun = 1000.0 * pacer->spun / pacer->samples;
+    }
+    pacer->samples = 0;
+    pacer->sum = pacer->sumSquares = pacer->worst = 0.0;
+    pacer->slept = pacer->spun = 0.0;
+}
+
+// Name of a mode for the window title
+const char* pacingModeName(PacingMode mode){
+    static const char* const names[PACING_MODES] = { "Vsync", "Adaptive vsync", "Uncapped", "Capped" };
+    return names[mode];
+}
\ No newline at end of file
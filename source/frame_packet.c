@@ -0,0 +1,94 @@
+#include "../include/frame_packet.h"
+#include <stdio.h>
+#include <string.h>
+
+int initFrameMailbox(FrameMailbox* mailbox){
+    memset(mailbox, 0, sizeof(FrameMailbox));
+    for (int i = 0; i < 2; i++){
+        if (initArena(&mailbox->arenas[i], FRAME_ARENA_SIZE) == 0){
+            freeArena(&mailbox->arenas[0]);
+            return 0;
+        }
+        mailbox->packets[i].arena = &mailbox->arenas[i];
+    }
+    pthread_mutex_init(&mailbox->lock, NULL);
+    pthread_cond_init(&mailbox->changed, NULL);
+    return 1;
+}
+
+// Waits until the render thread has taken the last packet and returns the next one to fill
+// The render thread draws the other packet meanwhile, so this one is free
+FramePacket* beginFramePacket(FrameMailbox* mailbox){
+    pthread_mutex_lock(&mailbox->lock);
+    while (mailbox->pending && !mailbox->finished){
+        pthread_cond_wait(&mailbox->changed, &mailbox->lock);
+    }
+    FramePacket* packet = mailbox->finished ? NULL : &mailbox->packets[mailbox->writeIndex];
+    pthread_mutex_unlock(&mailbox->lock);
+
+    // Only this thread touches a packet until it is submitted
+    if (packet){
+        resetArena(packet->arena);
+    }
+    return packet;
+}
+
+// Hands the filled packet over
+void submitFramePacket(FrameMailbox* mailbox){
+    pthread_mutex_lock(&mailbox->lock);
+    mailbox->pending = 1;
+    pthread_cond_broadcast(&mailbox->changed);
+    pthread_mutex_unlock(&mailbox->lock);
+}
+
+// Waits for a submitted packet and takes it
+// The packet drawn before becomes the next one the main thread fills
+const FramePacket* acquireFramePacket(FrameMailbox* mailbox){
+    pthread_mutex_lock(&mailbox->lock);
+    while (!mailbox->pending){
+        pthread_cond_wait(&mailbox->changed, &mailbox->lock);
+    }
+    mailbox->readIndex = mailbox->writeIndex;
+    mailbox->writeIndex ^= 1;
+    mailbox->pending = 0;
+    pthread_cond_broadcast(&mailbox->changed);
+    const FramePacket* packet = &mailbox->packets[mailbox->readIndex];
+    pthread_mutex_unlock(&mailbox->lock);
+    return packet;
+}
+
+// Marks the render thread stopped
+void finishFrameMailbox(FrameMailbox* mailbox){
+    pthread_mutex_lock(&mailbox->lock);
+    mailbox->finished = 1;
+    pthread_cond_broadcast(&mailbox->changed);
+    pthread_mutex_unlock(&mailbox->lock);
+}
+
+// Leaves a title for the main thread to set
+void postWindowTitle(FrameMailbox* mailbox, const char* title){
+    pthread_mutex_lock(&mailbox->lock);
+    snprintf(mailbox->title, sizeof(mailbox->title), "%s", title);
+    mailbox->titleChanged = 1;
+    pthread_mutex_unlock(&mailbox->lock);
+}
+
+// Copies the title left since the last call
+int takeWindowTitle(FrameMailbox* mailbox, char* title, int size){
+    pthread_mutex_lock(&mailbox->lock);
+    int changed = mailbox->titleChanged;
+    if (changed){
+        snprintf(title, size, "%s", mailbox->title);
+        mailbox->titleChanged = 0;
+    }
+    pthread_mutex_unlock(&mailbox->lock);
+    return changed;
+}
+
+void freeFrameMailbox(FrameMailbox* mailbox){
+    freeArena(&mailbox->arenas[0]);
+    freeArena(&mailbox->arenas[1]);
+    pthread_mutex_destroy(&mailbox->lock);
+    pthread_cond_destroy(&mailbox->changed);
+    memset(mailbox, 0, sizeof(FrameMailbox));
+}
\ No newline at end of file
@@ -0,0 +1,99 @@
+#include "../include/gbuffer.h"
+#include <stdio.h>
+#include <string.h>
+
+// Creates a texture of the G-buffer, read with texelFetch so no filtering and no mip levels
+static GLuint createTarget(GLenum internalFormat, GLenum format, GLenum type, int width, int height){
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
+
+// Creates the targets at the given size
+int initGBuffer(GBuffer* gbuffer, int width, int height){
+    memset(gbuffer, 0, sizeof(GBuffer));
+    gbuffer->width = width;
+    gbuffer->height = height;
+
+    gbuffer->albedo = createTarget(GL_SRGB8_ALPHA8, GL_RGBA, GL_UNSIGNED_BYTE, width, height);
+    gbuffer->surface = createTarget(GL_RGBA16UI, GL_RGBA_INTEGER, GL_UNSIGNED_SHORT, width, height);
+    gbuffer->depth = createTarget(GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, width, height);
+
+    glGenFramebuffers(1, &gbuffer->framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, gbuffer->framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gbuffer->albedo, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gbuffer->surface, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, gbuffer->depth, 0);
+    GLenum buffers[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+    glDrawBuffers(2, buffers);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (status != GL_FRAMEBUFFER_COMPLETE){
+        printf("Failed to create G-buffer: (0x%x)\n", status);
+        freeGBuffer(gbuffer);
+        return 0;
+    }
+    glGenVertexArrays(1, &gbuffer->vao);
+
+    printf("G-buffer: (%d x %d), 16 bytes per pixel\n", width, height);
+    return 1;
+}
+
+// Binds the G-buffer units
+void bindGBufferTextures(const GBuffer* gbuffer, int albedoUnit, int surfaceUnit, int depthUnit){
+    glActiveTexture(GL_TEXTURE0 + albedoUnit);
+    glBindTexture(GL_TEXTURE_2D, gbuffer->albedo);
+    glActiveTexture(GL_TEXTURE0 + surfaceUnit);
+    glBindTexture(GL_TEXTURE_2D, gbuffer->surface);
+    glActiveTexture(GL_TEXTURE0 + depthUnit);
+    glBindTexture(GL_TEXTURE_2D, gbuffer->depth);
+}
+
+// Binds and clears the G-buffer
+void beginGBuffer(const GBuffer* gbuffer){
+    glBindFramebuffer(GL_FRAMEBUFFER, gbuffer->framebuffer);
+    glViewport(0, 0, gbuffer->width, gbuffer->height);
+
+    // Albedo is linear in the shader, stored as sRGB so 8 bits keep the dark shades
+    glEnable(GL_FRAMEBUFFER_SRGB);
+
+    // Depth 1 marks the pixels with no lit surface, the lighting pass skips them
+    GLuint noSurface[4] = {0, 0, 0, 0};
+    glClear(GL_DEPTH_BUFFER_BIT);
+    glClearBufferuiv(GL_COLOR, 1, noSurface);
+}
+
+// Copies the depth into the given framebuffer and draws the fullscreen lighting pass into it
+void lightGBuffer(const GBuffer* gbuffer, GLuint targetFramebuffer){
+    glDisable(GL_FRAMEBUFFER_SRGB);
+
+    // Bodies drawn forward afterwards stay behind the lit ones
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, gbuffer->framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, targetFramebuffer);
+    glBlitFramebuffer(0, 0, gbuffer->width, gbuffer->height, 0, 0, gbuffer->width, gbuffer->height,
+                      GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, targetFramebuffer);
+
+    // Every pixel once, the shader discards the ones without a surface
+    glDisable(GL_DEPTH_TEST);
+    glBindVertexArray(gbuffer->vao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glEnable(GL_DEPTH_TEST);
+}
+
+// Frees the targets
+void freeGBuffer(GBuffer* gbuffer){
+    if (gbuffer->vao) glDeleteVertexArrays(1, &gbuffer->vao);
+    if (gbuffer->framebuffer) glDeleteFramebuffers(1, &gbuffer->framebuffer);
+    if (gbuffer->albedo) glDeleteTextures(1, &gbuffer->albedo);
+    if (gbuffer->surface) glDeleteTextures(1, &gbuffer->surface);
+    if (gbuffer->depth) glDeleteTextures(1, &gbuffer->depth);
+    memset(gbuffer, 0, sizeof(GBuffer));
+}
\ No newline at end of file
@@ -0,0 +1,348 @@
+#include "../include/gl_state.h"
+#include <pthread.h>
+#include <string.h>
+
+// Units and targets tracked, binds outside them go straight to the driver
+#define CACHED_UNITS 16
+#define CACHED_TEXTURE_TARGETS 4
+#define CACHED_BUFFER_TARGETS 9
+
+// Uniform values, open addressing on program and location
+#define UNIFORM_CACHE_SIZE 1024
+#define UNIFORM_PROBES 16
+
+// Value of state not known to the cache
+#define UNKNOWN_STATE 0xFFFFFFFFu
+
+typedef struct {
+    GLuint program; // 0 for an empty slot
+    GLint location;
+    GLuint bits;    // The int, or the float's bits
+} CachedUniform;
+
+// Driver entry points replaced by the cache
+static PFNGLUSEPROGRAMPROC realUseProgram;
+static PFNGLLINKPROGRAMPROC realLinkProgram;
+static PFNGLDELETEPROGRAMPROC realDeleteProgram;
+static PFNGLBINDVERTEXARRAYPROC realBindVertexArray;
+static PFNGLDELETEVERTEXARRAYSPROC realDeleteVertexArrays;
+static PFNGLBINDBUFFERPROC realBindBuffer;
+static PFNGLBINDBUFFERBASEPROC realBindBufferBase;
+static PFNGLBINDBUFFERRANGEPROC realBindBufferRange;
+static PFNGLDELETEBUFFERSPROC realDeleteBuffers;
+static PFNGLACTIVETEXTUREPROC realActiveTexture;
+static PFNGLBINDTEXTUREPROC realBindTexture;
+static PFNGLDELETETEXTURESPROC realDeleteTextures;
+static PFNGLBINDSAMPLERPROC realBindSampler;
+static PFNGLDELETESAMPLERSPROC realDeleteSamplers;
+static PFNGLUNIFORM1IPROC realUniform1i;
+static PFNGLUNIFORM1FPROC realUniform1f;
+
+// State of the context current on the owning thread
+static pthread_t owner;
+static GLuint program;
+static GLuint vertexArray;
+static GLuint buffers[CACHED_BUFFER_TARGETS];
+static GLuint activeUnit; // Offset from GL_TEXTURE0
+static GLuint textures[CACHED_UNITS][CACHED_TEXTURE_TARGETS];
+static GLuint samplers[CACHED_UNITS];
+static CachedUniform uniforms[UNIFORM_CACHE_SIZE];
+static GLStateCounters counters;
+
+// Slot of a texture target, -1 when it is not tracked
+static int textureTargetIndex(GLenum target){
+    switch (target){
+        case GL_TEXTURE_2D: return 0;
+        case GL_TEXTURE_2D_ARRAY: return 1;
+        case GL_TEXTURE_BUFFER: return 2;
+        case GL_TEXTURE_CUBE_MAP: return 3;
+        default: return -1;
+    }
+}
+
+// Slot of a buffer target, -1 when it is not tracked
+static int bufferTargetIndex(GLenum target){
+    switch (target){
+        case GL_ARRAY_BUFFER: return 0;
+        case GL_ELEMENT_ARRAY_BUFFER: return 1;
+        case GL_UNIFORM_BUFFER: return 2;
+        case GL_TEXTURE_BUFFER: return 3;
+        case GL_PIXEL_PACK_BUFFER: return 4;
+        case GL_PIXEL_UNPACK_BUFFER: return 5;
+        case GL_TRANSFORM_FEEDBACK_BUFFER: return 6;
+        case GL_COPY_READ_BUFFER: return 7;
+        case GL_COPY_WRITE_BUFFER: return 8;
+        default: return -1;
+    }
+}
+
+// Whether the call comes from the thread whose context is cached
+static int ownsContext(void){
+    return pthread_equal(pthread_self(), owner);
+}
+
+// Counts a call, returns whether it must reach the driver
+static int changes(GLStateKind kind, GLuint* cached, GLuint value){
+    if (*cached == value){
+        counters.hits[kind]++;
+        return 0;
+    }
+    counters.misses[kind]++;
+    *cached = value;
+    return 1;
+}
+
+// Uniform values of every program, forgotten whenever a program is linked or deleted
+// Only happens on load and reload, so clearing the whole table costs nothing per frame
+static void forgetUniforms(void){
+    memset(uniforms, 0, sizeof(uniforms));
+}
+
+// Finds the slot of a uniform of the current program, or an empty slot for it, NULL when the probes run out
+static CachedUniform* findUniform(GLint location){
+    unsigned int hash = (program * 2654435761u) ^ ((unsigned int)location * 40503u);
+    for (int i = 0; i < UNIFORM_PROBES; i++){
+        CachedUniform* slot = &uniforms[(hash + i) & (UNIFORM_CACHE_SIZE - 1)];
+        if (slot->program == 0 || (slot->program == program && slot->location == location)){
+            return slot;
+        }
+    }
+    return NULL;
+}
+
+// Counts a uniform call, returns whether it must reach the driver
+static int uniformChanges(GLint location, GLuint bits){
+    // Location -1 is ignored by GL, so the call can always be dropped
+    if (location < 0){
+        counters.hits[STATE_UNIFORM]++;
+        return 0;
+    }
+    CachedUniform* slot = (program != 0 && program != UNKNOWN_STATE) ? findUniform(location) : NULL;
+    if (slot == NULL){
+        counters.misses[STATE_UNIFORM]++;
+        return 1;
+    }
+    if (slot->program == program && slot->bits == bits){
+        counters.hits[STATE_UNIFORM]++;
+        return 0;
+    }
+    counters.misses[STATE_UNIFORM]++;
+    slot->program = program;
+    slot->location = location;
+    slot->bits = bits;
+    return 1;
+}
+
+static void APIENTRY cachedUseProgram(GLuint value){
+    if (!ownsContext() || changes(STATE_PROGRAM, &program, value)){
+        realUseProgram(value);
+    }
+}
+
+static void APIENTRY cachedLinkProgram(GLuint value){
+    if (ownsContext()) forgetUniforms();
+    realLinkProgram(value);
+}
+
+// A deleted program stays in use until another replaces it, but its name can be given to a new one
+static void APIENTRY cachedDeleteProgram(GLuint value){
+    if (ownsContext()){
+        if (value != 0 && value == program) program = UNKNOWN_STATE;
+        forgetUniforms();
+    }
+    realDeleteProgram(value);
+}
+
+// The element array buffer belongs to the VAO, so it is unknown after a switch
+static void APIENTRY cachedBindVertexArray(GLuint value){
+    if (!ownsContext()){
+        realBindVertexArray(value);
+        return;
+    }
+    if (changes(STATE_VERTEX_ARRAY, &vertexArray, value)){
+        buffers[1] = UNKNOWN_STATE;
+        realBindVertexArray(value);
+    }
+}
+
+// Deleting a bound object binds 0 in its place
+static void APIENTRY cachedDeleteVertexArrays(GLsizei n, const GLuint* arrays){
+    if (ownsContext()){
+        for (int i = 0; i < n; i++){
+            if (arrays[i] != 0 && arrays[i] == vertexArray){
+                vertexArray = 0;
+                buffers[1] = UNKNOWN_STATE;
+            }
+        }
+    }
+    realDeleteVertexArrays(n, arrays);
+}
+
+static void APIENTRY cachedBindBuffer(GLenum target, GLuint value){
+    int index = bufferTargetIndex(target);
+    if (!ownsContext() || index < 0){
+        realBindBuffer(target, value);
+        return;
+    }
+    if (changes(STATE_BUFFER, &buffers[index], value)){
+        realBindBuffer(target, value);
+    }
+}
+
+// Indexed binds also bind the generic target, they always reach the driver
+static void APIENTRY cachedBindBufferBase(GLenum target, GLuint bindingIndex, GLuint value){
+    int index = bufferTargetIndex(target);
+    if (ownsContext() && index >= 0) buffers[index] = value;
+    realBindBufferBase(target, bindingIndex, value);
+}
+
+static void APIENTRY cachedBindBufferRange(GLenum target, GLuint bindingIndex, GLuint value, GLintptr offset, GLsizeiptr size){
+    int index = bufferTargetIndex(target);
+    if (ownsContext() && index >= 0) buffers[index] = value;
+    realBindBufferRange(target, bindingIndex, value, offset, size);
+}
+
+static void APIENTRY cachedDeleteBuffers(GLsizei n, const GLuint* values){
+    if (ownsContext()){
+        for (int i = 0; i < n; i++){
+            for (int t = 0; t < CACHED_BUFFER_TARGETS; t++){
+                if (values[i] != 0 && buffers[t] == values[i]) buffers[t] = 0;
+            }
+        }
+    }
+    realDeleteBuffers(n, values);
+}
+
+static void APIENTRY cachedActiveTexture(GLenum unit){
+    if (!ownsContext() || changes(STATE_TEXTURE, &activeUnit, unit - GL_TEXTURE0)){
+        realActiveTexture(unit);
+    }
+}
+
+static void APIENTRY cachedBindTexture(GLenum target, GLuint value){
+    int index = textureTargetIndex(target);
+    if (!ownsContext() || index < 0 || activeUnit >= CACHED_UNITS){
+        realBindTexture(target, value);
+        return;
+    }
+    if (changes(STATE_TEXTURE, &textures[activeUnit][index], value)){
+        realBindTexture(target, value);
+    }
+}
+
+static void APIENTRY cachedDeleteTextures(GLsizei n, const GLuint* values){
+    if (ownsContext()){
+        for (int i = 0; i < n; i++){
+            for (int u = 0; u < CACHED_UNITS; u++){
+                for (int t = 0; t < CACHED_TEXTURE_TARGETS; t++){
+                    if (values[i] != 0 && textures[u][t] == values[i]) textures[u][t] = 0;
+                }
+            }
+        }
+    }
+    realDeleteTextures(n, values);
+}
+
+static void APIENTRY cachedBindSampler(GLuint unit, GLuint value){
+    if (!ownsContext() || unit >= CACHED_UNITS || changes(STATE_SAMPLER, &samplers[unit], value)){
+        realBindSampler(unit, value);
+    }
+}
+
+static void APIENTRY cachedDeleteSamplers(GLsizei n, const GLuint* values){
+    if (ownsContext()){
+        for (int i = 0; i < n; i++){
+            for (int u = 0; u < CACHED_UNITS; u++){
+                if (values[i] != 0 && samplers[u] == values[i]) samplers[u] = 0;
+            }
+        }
+    }
+    realDeleteSamplers(n, values);
+}
+
+static void APIENTRY cachedUniform1i(GLint location, GLint value){
+    if (!ownsContext() || uniformChanges(location, (GLuint)value)){
+        realUniform1i(location, value);
+    }
+}
+
+static void APIENTRY cachedUniform1f(GLint location, GLfloat value){
+    GLuint bits;
+    memcpy(&bits, &value, sizeof(bits));
+    if (!ownsContext() || uniformChanges(location, bits)){
+        realUniform1f(location, value);
+    }
+}
+
+// Swaps the cached entry points into GLAD's pointers
+void installGLStateCache(void){
+    owner = pthread_self();
+
+    realUseProgram = glad_glUseProgram;
+    realLinkProgram = glad_glLinkProgram;
+    realDeleteProgram = glad_glDeleteProgram;
+    realBindVertexArray = glad_glBindVertexArray;
+    realDeleteVertexArrays = glad_glDeleteVertexArrays;
+    realBindBuffer = glad_glBindBuffer;
+    realBindBufferBase = glad_glBindBufferBase;
+    realBindBufferRange = glad_glBindBufferRange;
+    realDeleteBuffers = glad_glDeleteBuffers;
+    realActiveTexture = glad_glActiveTexture;
+    realBindTexture = glad_glBindTexture;
+    realDeleteTextures = glad_glDeleteTextures;
+    realBindSampler = glad_glBindSampler;
+    realDeleteSamplers = glad_glDeleteSamplers;
+    realUniform1i = glad_glUniform1i;
+    realUniform1f = glad_glUniform1f;
+
+    glad_glUseProgram = cachedUseProgram;
+    glad_glLinkProgram = cachedLinkProgram;
+    glad_glDeleteProgram = cachedDeleteProgram;
+    glad_glBindVertexArray = cachedBindVertexArray;
+    glad_glDeleteVertexArrays = cachedDeleteVertexArrays;
+    glad_glBindBuffer = cachedBindBuffer;
+    glad_glBindBufferBase = cachedBindBufferBase;
+    glad_glBindBufferRange = cachedBindBufferRange;
+    glad_glDeleteBuffers = cachedDeleteBuffers;
+    glad_glActiveTexture = cachedActiveTexture;
+    glad_glBindTexture = cachedBindTexture;
+    glad_glDeleteTextures = cachedDeleteTextures;
+    glad_glBindSampler = cachedBindSampler;
+    glad_glDeleteSamplers = cachedDeleteSamplers;
+    glad_glUniform1i = cachedUniform1i;
+    glad_glUniform1f = cachedUniform1f;
+
+    invalidateGLStateCache();
+    memset(&counters, 0, sizeof(counters));
+}
+
+// Marks every binding unknown, so the next call of each reaches the driver
+void invalidateGLStateCache(void){
+    program = UNKNOWN_STATE;
+    vertexArray = UNKNOWN_STATE;
+    activeUnit = UNKNOWN_STATE;
+    for (int t = 0; t < CACHED_BUFFER_TARGETS; t++){
+        buffers[t] = UNKNOWN_STATE;
+    }
+    for (int u = 0; u < CACHED_UNITS; u++){
+        samplers[u] = UNKNOWN_STATE;
+        for (int t = 0; t < CACHED_TEXTURE_TARGETS; t++){
+            textures[u][t] = UNKNOWN_STATE;
+        }
+    }
+    forgetUniforms();
+}
+
+// Copies the counters, then resets them if asked
+void readGLStateCounters(GLStateCounters* result, int reset){
+    *result = counters;
+    if (reset){
+        memset(&counters, 0, sizeof(counters));
+    }
+}
+
+// Name of a kind for printing
+const char* glStateKindName(GLStateKind kind){
+    static const char* const names[STATE_KINDS] = { "program", "VAO", "buffer", "texture", "sampler", "uniform" };
+    return names[kind];
+}
\ No newline at end of file
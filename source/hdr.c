@@ -0,0 +1,110 @@
+#include "../include/hdr.h"
+#include "../include/shader.h"
+#include <stdio.h>
+#include <string.h>
+
+// Creates the target and loads the tonemap program
+int initHdrTarget(HdrTarget* target, int width, int height, HdrFormat format, int unit){
+    memset(target, 0, sizeof(HdrTarget));
+    target->width = width;
+    target->height = height;
+    target->format = format;
+    target->unit = unit;
+
+    // Read once per pixel with texelFetch, so no filtering and no mip levels
+    glGenTextures(1, &target->color);
+    glBindTexture(GL_TEXTURE_2D, target->color);
+    if (format == HDR_R11G11B10F){
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R11F_G11F_B10F, width, height, 0, GL_RGB, GL_FLOAT, NULL);
+    }
+    else {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenRenderbuffers(1, &target->depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, target->depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &target->framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, target->framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target->color, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, target->depth);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+
+    // Whether the window converts linear writes to sRGB itself
+    GLint encoding = GL_LINEAR;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glGetFramebufferAttachmentParameteriv(GL_FRAMEBUFFER, GL_BACK_LEFT, GL_FRAMEBUFFER_ATTACHMENT_COLOR_ENCODING, &encoding);
+    target->encodeSrgb = encoding != GL_SRGB;
+
+    if (status != GL_FRAMEBUFFER_COMPLETE){
+        printf("Failed to create HDR target: (%s) (0x%x)\n", hdrFormatName(format), status);
+        freeHdrTarget(target);
+        return 0;
+    }
+
+    target->program = loadShaders("shaders/tonemap.glsl", "shaders/tonemap_fragment.glsl");
+    if (target->program == 0){
+        printf("Failed to load tonemap shaders\n");
+        freeHdrTarget(target);
+        return 0;
+    }
+    glUseProgram(target->program);
+    glUniform1i(glGetUniformLocation(target->program, "hdrColor"), unit);
+    glUniform1i(glGetUniformLocation(target->program, "encodeSrgb"), target->encodeSrgb);
+    target->exposureLoc = glGetUniformLocation(target->program, "exposure");
+
+    // The pass reads no attributes, but core profile needs a VAO to draw
+    glGenVertexArrays(1, &target->vao);
+
+    printf("HDR target: (%s) (%d x %d), sRGB encoded by the %s\n", hdrFormatName(format), width, height,
+           target->encodeSrgb ? "tonemap shader" : "framebuffer");
+    return 1;
+}
+
+// Binds the target and its viewport
+void beginHdrTarget(const HdrTarget* target){
+    glBindFramebuffer(GL_FRAMEBUFFER, target->framebuffer);
+    glViewport(0, 0, target->width, target->height);
+}
+
+// Tonemaps the target into the window's framebuffer
+void resolveHdrTarget(const HdrTarget* target, float exposure){
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, target->width, target->height);
+
+    // Every pixel is written, so no clear and no depth
+    glDisable(GL_DEPTH_TEST);
+    if (!target->encodeSrgb){
+        glEnable(GL_FRAMEBUFFER_SRGB);
+    }
+    glActiveTexture(GL_TEXTURE0 + target->unit);
+    glBindTexture(GL_TEXTURE_2D, target->color);
+    glUseProgram(target->program);
+    glUniform1f(target->exposureLoc, exposure);
+    glBindVertexArray(target->vao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    glDisable(GL_FRAMEBUFFER_SRGB);
+    glEnable(GL_DEPTH_TEST);
+}
+
+// Name for the window title
+const char* hdrFormatName(HdrFormat format){
+    return format == HDR_R11G11B10F ? "R11G11B10F" : "RGBA16F";
+}
+
+// Frees the target and the program
+void freeHdrTarget(HdrTarget* target){
+    if (target->program) glDeleteProgram(target->program);
+    if (target->vao) glDeleteVertexArrays(1, &target->vao);
+    if (target->framebuffer) glDeleteFramebuffers(1, &target->framebuffer);
+    if (target->depth) glDeleteRenderbuffers(1, &target->depth);
+    if (target->color) glDeleteTextures(1, &target->color);
+    memset(target, 0, sizeof(HdrTarget));
+}
\ No newline at end of file
@@ -0,0 +1,275 @@
+#include "../include/lights.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Four lights per view transform when SSE is available
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#define LIGHTS_SIMD 1
+#endif
+
+// Light indices allocated per cluster at first, grown when the lights spread over more clusters
+#define INITIAL_INDICES_PER_CLUSTER 4
+
+// Creates a buffer texture of the given format and size
+static void createBufferTexture(GLuint* buffer, GLuint* texture, GLenum format, size_t size){
+    glGenBuffers(1, buffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, *buffer);
+    glBufferData(GL_TEXTURE_BUFFER, size, NULL, GL_STREAM_DRAW);
+    glGenTextures(1, texture);
+    glBindTexture(GL_TEXTURE_BUFFER, *texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, format, *buffer);
+}
+
+// Allocates the arrays and buffers for the given amount of lights
+// 0 on failure, 1 on success
+int initLightSystem(LightSystem* lights, int numLights){
+    memset(lights, 0, sizeof(LightSystem));
+    lights->numLights = numLights;
+
+    // Room for a whole group of four past the end, so the SIMD path needs no remainder loop
+    int padded = (numLights + 3) & ~3;
+    lights->body = (int*)calloc(numLights, sizeof(int));
+    lights->range = (float*)calloc(numLights, sizeof(float));
+    lights->colorR = (float*)calloc(numLights, sizeof(float));
+    lights->colorG = (float*)calloc(numLights, sizeof(float));
+    lights->colorB = (float*)calloc(numLights, sizeof(float));
+    lights->viewX = (float*)calloc(padded, sizeof(float));
+    lights->viewY = (float*)calloc(padded, sizeof(float));
+    lights->viewZ = (float*)calloc(padded, sizeof(float));
+    lights->bounds = (int*)calloc(numLights * 6, sizeof(int));
+    lights->lightData = (float*)calloc(numLights * 8, sizeof(float));
+    lights->grid = (GLuint*)calloc(CLUSTER_COUNT * 2, sizeof(GLuint));
+    lights->indexCapacity = CLUSTER_COUNT * INITIAL_INDICES_PER_CLUSTER;
+    lights->indices = (GLuint*)malloc(lights->indexCapacity * sizeof(GLuint));
+
+    if (!lights->body || !lights->range || !lights->colorR || !lights->colorG || !lights->colorB ||
+        !lights->viewX || !lights->viewY || !lights->viewZ || !lights->bounds || !lights->lightData ||
+        !lights->grid || !lights->indices){
+        printf("Failed to allocate light system for (%d) lights\n", numLights);
+        freeLightSystem(lights);
+        return 0;
+    }
+
+    // GL 3.3 has no storage buffers, the shader fetches from buffer textures
+    createBufferTexture(&lights->lightBuffer, &lights->lightTexture, GL_RGBA32F, (numLights > 0 ? numLights : 1) * 8 * sizeof(float));
+    createBufferTexture(&lights->gridBuffer, &lights->gridTexture, GL_RG32UI, CLUSTER_COUNT * 2 * sizeof(GLuint));
+    createBufferTexture(&lights->indexBuffer, &lights->indexTexture, GL_R32UI, lights->indexCapacity * sizeof(GLuint));
+
+    printf("Lights: (%d) lights over (%d x %d x %d) clusters\n", numLights, CLUSTER_TILES_X, CLUSTER_TILES_Y, CLUSTER_SLICES);
+    return 1;
+}
+
+// Sets the projection and screen size the clusters divide
+void setLightProjection(LightSystem* lights, mat4 projection, float near, float far, int width, int height){
+    // Exponential slices keep the clusters about as deep as they are wide
+    lights->near = near;
+    lights->far = far;
+    lights->sliceScale = CLUSTER_SLICES / logf(far / near);
+    lights->projX = projection[0][0];
+    lights->projY = projection[1][1];
+    lights->tileWidth = (float)width / CLUSTER_TILES_X;
+    lights->tileHeight = (float)height / CLUSTER_TILES_Y;
+}
+
+// Sets the cluster uniforms of the scene program
+void setLightUniforms(const LightSystem* lights, GLuint program, int lightUnit, int gridUnit, int indexUnit){
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "lightData"), lightUnit);
+    glUniform1i(glGetUniformLocation(program, "clusterGrid"), gridUnit);
+    glUniform1i(glGetUniformLocation(program, "clusterLights"), indexUnit);
+    glUniform4f(glGetUniformLocation(program, "clusterParams"), lights->tileWidth, lights->tileHeight,
+                lights->near, lights->sliceScale);
+}
+
+// Slice of a view depth, clamped to the grid
+static int depthSlice(const LightSystem* lights, float depth){
+    if (depth <= lights->near) return 0;
+    int slice = (int)(logf(depth / lights->near) * lights->sliceScale);
+    return slice < CLUSTER_SLICES ? slice : CLUSTER_SLICES - 1;
+}
+
+// Tile of a projected coordinate in [-1, 1], clamped to the grid
+static int screenTile(float ndc, int tiles){
+    int tile = (int)floorf((ndc * 0.5f + 0.5f) * tiles);
+    if (tile < 0) return 0;
+    return tile < tiles ? tile : tiles - 1;
+}
+
+// Moves the lights to their bodies and into view space
+static void transformLights(LightSystem* lights, const OrbitSystem* orbits, mat4 view){
+    for (int i = 0; i < lights->numLights; i++){
+        int body = lights->body[i];
+        float* data = lights->lightData + (size_t)i * 8;
+        data[0] = orbits->posX[body];
+        data[1] = orbits->posY[body];
+        data[2] = orbits->posZ[body];
+        data[3] = lights->range[i];
+        data[4] = lights->colorR[i];
+        data[5] = lights->colorG[i];
+        data[6] = lights->colorB[i];
+        data[7] = 0.0f;
+
+        // World positions go through the view arrays, then get replaced in place
+        lights->viewX[i] = data[0];
+        lights->viewY[i] = data[1];
+        lights->viewZ[i] = data[2];
+    }
+
+    int i = 0;
+#ifdef LIGHTS_SIMD
+    for (; i < lights->numLights; i += 4){
+        __m128 x = _mm_loadu_ps(lights->viewX + i);
+        __m128 y = _mm_loadu_ps(lights->viewY + i);
+        __m128 z = _mm_loadu_ps(lights->viewZ + i);
+        float* rows[3] = {lights->viewX + i, lights->viewY + i, lights->viewZ + i};
+        for (int r = 0; r < 3; r++){
+            __m128 v = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(view[0][r])), _mm_mul_ps(y, _mm_set1_ps(view[1][r]))),
+                _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(view[2][r])), _mm_set1_ps(view[3][r])));
+            _mm_storeu_ps(rows[r], v);
+        }
+    }
+#endif
+
+    // Remainder, or everything without SSE
+    for (; i < lights->numLights; i++){
+        float x = lights->viewX[i], y = lights->viewY[i], z = lights->viewZ[i];
+        lights->viewX[i] = view[0][0] * x + view[1][0] * y + view[2][0] * z + view[3][0];
+        lights->viewY[i] = view[0][1] * x + view[1][1] * y + view[2][1] * z + view[3][1];
+        lights->viewZ[i] = view[0][2] * x + view[1][2] * y + view[2][2] * z + view[3][2];
+    }
+}
+
+// Finds the clusters a light's sphere may touch, -1 in x0 when it is outside the view
+static void lightBounds(const LightSystem* lights, int i, int* bounds){
+    float radius = lights->range[i];
+    float depth = -lights->viewZ[i];
+    float x = lights->viewX[i], y = lights->viewY[i];
+    bounds[0] = -1;
+    if (depth + radius < lights->near || depth - radius > lights->far){
+        return;
+    }
+
+    // Parts in front of the near plane are clipped, so the sphere's box is cut there
+    float minDepth = depth - radius > lights->near ? depth - radius : lights->near;
+    float maxDepth = depth + radius < lights->far ? depth + radius : lights->far;
+
+    // x / depth is monotonic in depth, so the box's projection is bounded by its nearest and farthest faces
+    float left = fminf((x - radius) / minDepth, (x - radius) / maxDepth) * lights->projX;
+    float right = fmaxf((x + radius) / minDepth, (x + radius) / maxDepth) * lights->projX;
+    float bottom = fminf((y - radius) / minDepth, (y - radius) / maxDepth) * lights->projY;
+    float top = fmaxf((y + radius) / minDepth, (y + radius) / maxDepth) * lights->projY;
+    if (left > 1.0f || right < -1.0f || bottom > 1.0f || top < -1.0f){
+        return;
+    }
+
+    bounds[0] = screenTile(left, CLUSTER_TILES_X);
+    bounds[1] = screenTile(right, CLUSTER_TILES_X);
+    bounds[2] = screenTile(bottom, CLUSTER_TILES_Y);
+    bounds[3] = screenTile(top, CLUSTER_TILES_Y);
+    bounds[4] = depthSlice(lights, minDepth);
+    bounds[5] = depthSlice(lights, maxDepth);
+}
+
+// Moves every light to its body, assigns the lights to clusters and uploads the lists
+void updateLightClusters(LightSystem* lights, const OrbitSystem* orbits, mat4 view){
+    transformLights(lights, orbits, view);
+
+    // Count the lights of every cluster, counts are in the second half of each grid entry
+    memset(lights->grid, 0, CLUSTER_COUNT * 2 * sizeof(GLuint));
+    for (int i = 0; i < lights->numLights; i++){
+        int* b = lights->bounds + i * 6;
+        lightBounds(lights, i, b);
+        if (b[0] < 0) continue;
+        for (int z = b[4]; z <= b[5]; z++){
+            for (int y = b[2]; y <= b[3]; y++){
+                GLuint* entry = lights->grid + ((z * CLUSTER_TILES_Y + y) * CLUSTER_TILES_X + b[0]) * 2;
+                for (int x = b[0]; x <= b[1]; x++, entry += 2){
+                    if (entry[1] < MAX_CLUSTER_LIGHTS) entry[1]++;
+                }
+            }
+        }
+    }
+
+    // Offsets of each list, the counts start over as fill positions
+    GLuint total = 0;
+    lights->occupied = 0;
+    for (int c = 0; c < CLUSTER_COUNT; c++){
+        lights->grid[c * 2] = total;
+        total += lights->grid[c * 2 + 1];
+        lights->occupied += lights->grid[c * 2 + 1] > 0;
+        lights->grid[c * 2 + 1] = 0;
+    }
+    lights->assigned = total;
+
+    // Grow the index list, the buffer is given its new size on upload
+    int grown = 0;
+    if ((int)total > lights->indexCapacity){
+        int capacity = lights->indexCapacity;
+        while (capacity < (int)total) capacity *= 2;
+        GLuint* indices = (GLuint*)realloc(lights->indices, capacity * sizeof(GLuint));
+        if (!indices){
+            printf("Failed to allocate (%d) light indices\n", capacity);
+            return;
+        }
+        lights->indices = indices;
+        lights->indexCapacity = capacity;
+        grown = 1;
+    }
+
+    // Same walk again, writing the indices, lights past the cap of a full cluster are dropped like in the count
+    for (int i = 0; i < lights->numLights; i++){
+        const int* b = lights->bounds + i * 6;
+        if (b[0] < 0) continue;
+        for (int z = b[4]; z <= b[5]; z++){
+            for (int y = b[2]; y <= b[3]; y++){
+                GLuint* entry = lights->grid + ((z * CLUSTER_TILES_Y + y) * CLUSTER_TILES_X + b[0]) * 2;
+                for (int x = b[0]; x <= b[1]; x++, entry += 2){
+                    if (entry[1] < MAX_CLUSTER_LIGHTS) lights->indices[entry[0] + entry[1]++] = i;
+                }
+            }
+        }
+    }
+
+    // Orphaned before each write, so the draws of the last frame can keep reading the old lists
+    glBindBuffer(GL_TEXTURE_BUFFER, lights->lightBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, (lights->numLights > 0 ? lights->numLights : 1) * 8 * sizeof(float), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, lights->numLights * 8 * sizeof(float), lights->lightData);
+
+    glBindBuffer(GL_TEXTURE_BUFFER, lights->gridBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, CLUSTER_COUNT * 2 * sizeof(GLuint), lights->grid, GL_STREAM_DRAW);
+
+    glBindBuffer(GL_TEXTURE_BUFFER, lights->indexBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, lights->indexCapacity * sizeof(GLuint), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, total * sizeof(GLuint), lights->indices);
+    if (grown){
+        printf("Lights: index list grown to (%d)\n", lights->indexCapacity);
+    }
+}
+
+// Frees the arrays and GPU objects of the system
+void freeLightSystem(LightSystem* lights){
+    free(lights->body);
+    free(lights->range);
+    free(lights->colorR);
+    free(lights->colorG);
+    free(lights->colorB);
+    free(lights->viewX);
+    free(lights->viewY);
+    free(lights->viewZ);
+    free(lights->bounds);
+    free(lights->lightData);
+    free(lights->grid);
+    free(lights->indices);
+
+    if (lights->lightTexture) glDeleteTextures(1, &lights->lightTexture);
+    if (lights->lightBuffer) glDeleteBuffers(1, &lights->lightBuffer);
+    if (lights->gridTexture) glDeleteTextures(1, &lights->gridTexture);
+    if (lights->gridBuffer) glDeleteBuffers(1, &lights->gridBuffer);
+    if (lights->indexTexture) glDeleteTextures(1, &lights->indexTexture);
+    if (lights->indexBuffer) glDeleteBuffers(1, &lights->indexBuffer);
+    memset(lights, 0, sizeof(LightSystem));
+}
\ No newline at end of file
@@ -0,0 +1,91 @@
+#include "../include/material.h"
+#include <stdio.h>
+#include <string.h>
+
+// Atlas image of a map, -1 without one
+static int addMap(TextureAtlas* atlas, const char* path, MipSpace space){
+    return path[0] == '\0' ? -1 : addAtlasImage(atlas, path, space);
+}
+
+// Packs the library in std140 layout and uploads it
+static void uploadMaterials(MaterialTable* table, const MaterialLibrary* library){
+    GpuMaterial gpuMaterials[MAX_MATERIALS];
+    memset(gpuMaterials, 0, sizeof(gpuMaterials));
+
+    for (int i = 0; i < library->numMaterials; i++){
+        const MaterialData* material = &library->materials[i];
+        memcpy(gpuMaterials[i].ambient, material->Ka, sizeof(material->Ka));
+        memcpy(gpuMaterials[i].diffuse, material->Kd, sizeof(material->Kd));
+        memcpy(gpuMaterials[i].specular, material->Ks, sizeof(material->Ks));
+        gpuMaterials[i].diffuse[3] = material->d;
+        gpuMaterials[i].specular[3] = material->Ns;
+    }
+
+    // Nothing loaded, a plain white material so index 0 is always valid
+    if (library->numMaterials == 0){
+        gpuMaterials[0].diffuse[0] = gpuMaterials[0].diffuse[1] = gpuMaterials[0].diffuse[2] = 1.0f;
+        gpuMaterials[0].diffuse[3] = 1.0f;
+        gpuMaterials[0].specular[3] = 1.0f;
+    }
+
+    for (int i = 0; i < MAX_MATERIALS; i++){
+        gpuMaterials[i].maps[0] = (float)table->diffuseImages[i];
+        gpuMaterials[i].maps[1] = (float)table->bumpImages[i];
+    }
+
+    glBindBuffer(GL_UNIFORM_BUFFER, table->ubo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(gpuMaterials), gpuMaterials);
+}
+
+// Uploads the library and adds its diffuse and bump maps to the atlas
+int initMaterialTable(MaterialTable* table, const MaterialLibrary* library, TextureAtlas* atlas, const char* virtualMap){
+    memset(table, 0, sizeof(MaterialTable));
+    if (virtualMap){
+        snprintf(table->virtualMap, sizeof(table->virtualMap), "%s", virtualMap);
+    }
+
+    // Whole table is always allocated, so the shader's fixed size array is backed
+    glGenBuffers(1, &table->ubo);
+    glBindBuffer(GL_UNIFORM_BUFFER, table->ubo);
+    glBufferData(GL_UNIFORM_BUFFER, MAX_MATERIALS * sizeof(GpuMaterial), NULL, GL_STATIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, MATERIAL_BINDING, table->ubo);
+
+    int added = updateMaterialTable(table, library, atlas);
+    printf("Material table: (%d) materials\n", table->numMaterials);
+    return added;
+}
+
+// Uploads a changed library, maps already in the atlas keep their image
+int updateMaterialTable(MaterialTable* table, const MaterialLibrary* library, TextureAtlas* atlas){
+    int numImages = atlas->numImages;
+    table->numMaterials = library->numMaterials > 0 ? library->numMaterials : 1;
+    for (int i = 0; i < MAX_MATERIALS; i++){
+        int used = i < library->numMaterials;
+        const char* diffuseMap = library->materials[i].diffuseMap;
+        if (used && table->virtualMap[0] != '\0' && strcmp(diffuseMap, table->virtualMap) == 0){
+            // Streamed, never loaded whole
+            table->diffuseImages[i] = VIRTUAL_IMAGE;
+        }
+        else {
+            table->diffuseImages[i] = used ? addMap(atlas, diffuseMap, MIP_SRGB) : -1;
+        }
+        // Heights are data, their mips average the stored values
+        table->bumpImages[i] = used ? addMap(atlas, library->materials[i].bumpMap, MIP_LINEAR) : -1;
+    }
+    uploadMaterials(table, library);
+    return atlas->numImages > numImages;
+}
+
+// Points a program's "Materials" block at the table
+void bindMaterialTable(GLuint program){
+    GLuint block = glGetUniformBlockIndex(program, "Materials");
+    if (block != GL_INVALID_INDEX){
+        glUniformBlockBinding(program, block, MATERIAL_BINDING);
+    }
+}
+
+// Frees the buffer, the images stay in the atlas
+void freeMaterialTable(MaterialTable* table){
+    if (table->ubo) glDeleteBuffers(1, &table->ubo);
+    memset(table, 0, sizeof(MaterialTable));
+}
\ No newline at end of file
@@ -0,0 +1,109 @@
+#include "../include/mesh.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Uploads the given meshes back to back and fills one range per mesh
+void initMeshBuffer(MeshBuffer* buffer, const LoadedObject* objects, int numObjects, MeshRange* ranges){
+    memset(buffer, 0, sizeof(MeshBuffer));
+
+    // Create and bind empty VAO, VBO and EBO
+    glGenVertexArrays(1, &buffer->vao);
+    glBindVertexArray(buffer->vao);
+
+    glGenBuffers(1, &buffer->vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer->vbo);
+
+    glGenBuffers(1, &buffer->ebo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer->ebo);
+
+    setVertexFormat();
+    updateMeshBuffer(buffer, objects, numObjects, ranges);
+}
+
+// Replaces the contents of the buffer with new meshes, the VAO and buffer IDs stay the same
+void updateMeshBuffer(MeshBuffer* buffer, const LoadedObject* objects, int numObjects, MeshRange* ranges){
+    // Place every mesh after the previous one
+    int numVertices = 0, numIndices = 0;
+    for (int i = 0; i < numObjects; i++){
+        ranges[i].baseVertex = numVertices;
+        ranges[i].numLods = objects[i].numLods;
+        ranges[i].numSubmeshes = objects[i].numSubmeshes;
+        for (int lod = 0; lod < objects[i].numLods; lod++){
+            ranges[i].lods[lod] = objects[i].lods[lod];
+            ranges[i].lods[lod].indexOffset += numIndices;
+        }
+        numVertices += objects[i].numVertices;
+        numIndices += objects[i].numIndices;
+    }
+
+    glBindVertexArray(buffer->vao);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer->vbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer->ebo);
+
+    // Storage is only re-specified when the size changes, the VAO keeps pointing at the same buffers
+    if (numVertices != buffer->numVertices){
+        glBufferData(GL_ARRAY_BUFFER, numVertices * sizeof(Vertex), NULL, GL_STATIC_DRAW);
+        buffer->numVertices = numVertices;
+    }
+    if (numIndices != buffer->numIndices){
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, numIndices * sizeof(unsigned int), NULL, GL_STATIC_DRAW);
+        buffer->numIndices = numIndices;
+    }
+
+    // Indices stay relative to their mesh, the base vertex is added when drawing
+    int vertexOffset = 0, indexOffset = 0;
+    for (int i = 0; i < numObjects; i++){
+        glBufferSubData(GL_ARRAY_BUFFER, vertexOffset * sizeof(Vertex), objects[i].numVertices * sizeof(Vertex), objects[i].vertices);
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, indexOffset * sizeof(unsigned int), objects[i].numIndices * sizeof(unsigned int), objects[i].indices);
+        vertexOffset += objects[i].numVertices;
+        indexOffset += objects[i].numIndices;
+    }
+
+    printf("Mesh buffer: (%d) meshes, (%d) vertices, (%d) indices\n", numObjects, buffer->numVertices, buffer->numIndices);
+}
+
+// Sets the Vertex attributes (0 to 2, and 4) of the bound VAO for the bound array buffer
+void setVertexFormat(void){
+    // Position
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, x));
+    glEnableVertexAttribArray(0);
+
+    // UVs
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, u));
+    glEnableVertexAttribArray(1);
+
+    // Normals
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, nx));
+    glEnableVertexAttribArray(2);
+
+    // Packed tangents, 3 is the per instance body index
+    glVertexAttribPointer(4, 4, GL_BYTE, GL_TRUE, sizeof(Vertex), (void*)offsetof(Vertex, tangent));
+    glEnableVertexAttribArray(4);
+}
+
+// Draws a detail level of a mesh, the buffer's VAO must be bound
+void drawMeshInstanced(const MeshRange* range, int lod, int instanceCount){
+    const MeshLod* level = &range->lods[lod];
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, level->numIndices, GL_UNSIGNED_INT,
+                                      (void*)(level->indexOffset * sizeof(unsigned int)), instanceCount, range->baseVertex);
+}
+
+// Draws one submesh of a detail level, the buffer's VAO must be bound
+void drawSubmeshInstanced(const MeshRange* range, int lod, int submesh, int instanceCount){
+    const MeshLod* level = &range->lods[lod];
+    int offset = level->indexOffset;
+    for (int i = 0; i < submesh; i++){
+        offset += level->submeshIndices[i];
+    }
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, level->submeshIndices[submesh], GL_UNSIGNED_INT,
+                                      (void*)(offset * sizeof(unsigned int)), instanceCount, range->baseVertex);
+}
+
+// Frees the GPU objects
+void freeMeshBuffer(MeshBuffer* buffer){
+    if (buffer->vao) glDeleteVertexArrays(1, &buffer->vao);
+    if (buffer->vbo) glDeleteBuffers(1, &buffer->vbo);
+    if (buffer->ebo) glDeleteBuffers(1, &buffer->ebo);
+    memset(buffer, 0, sizeof(MeshBuffer));
+}
\ No newline at end of file
@@ -0,0 +1,159 @@
+#include "../include/mesh_optimize.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Returns the next vertex with triangles left, from the dead end stack or the input order
+static int skipDeadEnd(const int* liveTriangles, int* deadEnd, int* deadEndCount, int* cursor, int vertexCount){
+    while (*deadEndCount > 0){
+        int v = deadEnd[--(*deadEndCount)];
+        if (liveTriangles[v] > 0){
+            return v;
+        }
+    }
+    while (*cursor < vertexCount){
+        int v = (*cursor)++;
+        if (liveTriangles[v] > 0){
+            return v;
+        }
+    }
+    return -1;
+}
+
+// Reorders the triangles so consecutive ones reuse recently transformed vertices (Tipsify)
+// Fans around a vertex, then moves to the neighbour that will still be in the cache the longest
+int optimizeVertexCache(unsigned int* indices, int indexCount, int vertexCount){
+    int triangleCount = indexCount / 3;
+    if (triangleCount == 0){
+        return 1;
+    }
+
+    // Triangles around each vertex
+    int* liveTriangles = (int*)calloc(vertexCount, sizeof(int));
+    int* adjOffsets = (int*)calloc(vertexCount + 1, sizeof(int));
+    int* adjTriangles = (int*)malloc(indexCount * sizeof(int));
+    int* fill = (int*)malloc(vertexCount * sizeof(int));
+
+    // Cache time stamps, emitted triangles and the new index order
+    int* timeStamps = (int*)calloc(vertexCount, sizeof(int));
+    unsigned char* emitted = (unsigned char*)calloc(triangleCount, 1);
+    unsigned int* result = (unsigned int*)malloc(indexCount * sizeof(unsigned int));
+    int* deadEnd = (int*)malloc(indexCount * sizeof(int));
+    int* candidates = (int*)malloc(indexCount * sizeof(int));
+
+    // Nothing is reordered unless all of it is there
+    int success = liveTriangles && adjOffsets && adjTriangles && fill && timeStamps && emitted && result && deadEnd && candidates;
+    if (!success){
+        printf("Failed to allocate memory for vertex cache optimization: (%d) indices\n", indexCount);
+        free(fill);
+        goto cleanup;
+    }
+
+    for (int i = 0; i < indexCount; i++){
+        liveTriangles[indices[i]]++;
+    }
+    for (int v = 0; v < vertexCount; v++){
+        adjOffsets[v + 1] = adjOffsets[v] + liveTriangles[v];
+    }
+    memcpy(fill, adjOffsets, vertexCount * sizeof(int));
+    for (int i = 0; i < indexCount; i++){
+        adjTriangles[fill[indices[i]]++] = i / 3;
+    }
+    free(fill);
+
+    int deadEndCount = 0, resultCount = 0;
+    int time = VERTEX_CACHE_SIZE + 1;
+    int cursor = 0;
+
+    int fanning = indices[0];
+    while (fanning >= 0){
+        // Emit every triangle left around the fanning vertex
+        int candidateCount = 0;
+        for (int k = adjOffsets[fanning]; k < adjOffsets[fanning + 1]; k++){
+            int t = adjTriangles[k];
+            if (emitted[t]){
+                continue;
+            }
+            emitted[t] = 1;
+            for (int c = 0; c < 3; c++){
+                int v = indices[t * 3 + c];
+                result[resultCount++] = v;
+                deadEnd[deadEndCount++] = v;
+                candidates[candidateCount++] = v;
+                liveTriangles[v]--;
+                // Vertex isn't in the cache anymore, it is transformed again
+                if (time - timeStamps[v] > VERTEX_CACHE_SIZE){
+                    timeStamps[v] = time++;
+                }
+            }
+        }
+
+        // Best candidate is the one that stays in the cache while its triangles are emitted
+        int next = -1, bestPriority = -1;
+        for (int i = 0; i < candidateCount; i++){
+            int v = candidates[i];
+            if (liveTriangles[v] <= 0){
+                continue;
+            }
+            int priority = 0;
+            if (time - timeStamps[v] + 2 * liveTriangles[v] <= VERTEX_CACHE_SIZE){
+                priority = time - timeStamps[v];
+            }
+            if (priority > bestPriority){
+                bestPriority = priority;
+                next = v;
+            }
+        }
+        if (next == -1){
+            next = skipDeadEnd(liveTriangles, deadEnd, &deadEndCount, &cursor, vertexCount);
+        }
+        fanning = next;
+    }
+    memcpy(indices, result, indexCount * sizeof(unsigned int));
+
+cleanup:
+    free(liveTriangles);
+    free(adjOffsets);
+    free(adjTriangles);
+    free(timeStamps);
+    free(emitted);
+    free(result);
+    free(deadEnd);
+    free(candidates);
+    return success;
+}
+
+// Reorders the vertices in the order the indices first use them, and rewrites the indices
+int optimizeVertexFetch(Vertex* vertices, unsigned int* indices, int indexCount, int vertexCount){
+    // Both up front, so a failure leaves the vertices and indices as they were
+    unsigned int* remap = (unsigned int*)malloc(vertexCount * sizeof(unsigned int));
+    Vertex* copy = (Vertex*)malloc(vertexCount * sizeof(Vertex));
+    if (!remap || !copy){
+        printf("Failed to allocate memory for vertex fetch optimization: (%d) vertices\n", vertexCount);
+        free(remap);
+        free(copy);
+        return 0;
+    }
+    memset(remap, 0xff, vertexCount * sizeof(unsigned int));
+
+    int newCount = 0;
+    for (int i = 0; i < indexCount; i++){
+        unsigned int v = indices[i];
+        if (remap[v] == 0xffffffffu){
+            remap[v] = newCount++;
+        }
+        indices[i] = remap[v];
+    }
+
+    // Move every vertex to its new slot through a copy
+    memcpy(copy, vertices, vertexCount * sizeof(Vertex));
+    for (int v = 0; v < vertexCount; v++){
+        if (remap[v] != 0xffffffffu){
+            vertices[remap[v]] = copy[v];
+        }
+    }
+
+    free(copy);
+    free(remap);
+    return newCount;
+}
\ No newline at end of file
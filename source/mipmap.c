@@ -0,0 +1,432 @@
+#include "../include/mipmap.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// One RGBA texel per step when SSE is available
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#define MIP_SIMD 1
+#endif
+
+// A destination texel covers at most this many source texels per axis, less than 3 plus the partial ones
+#define MAX_TAPS 4
+
+// Resolution of the linear to sRGB table, fine enough that every dark sRGB value keeps its own entries
+#define ENCODE_STEPS 65535
+
+// Source texels under one destination texel along an axis, weighted by how much of each it covers
+typedef struct {
+    int first;
+    int count;
+    float weights[MAX_TAPS];
+} MipTaps;
+
+// Texels of a level held in memory, a whole level or the window of it that starts at texel (x, y) with rows of pitch texels
+typedef struct {
+    unsigned char* pixels;
+    int x, y;
+    int pitch;
+} MipWindow;
+
+// 8 bit value to linear, per space, alpha is always linear
+static float decodeTable[2][256];
+// Linear to 8 bit sRGB
+static unsigned char encodeTable[ENCODE_STEPS + 1];
+static pthread_once_t tablesOnce = PTHREAD_ONCE_INIT;
+
+static float srgbToLinear(float c){
+    return c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static float linearToSrgb(float c){
+    return c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+}
+
+static void initTables(void){
+    for (int i = 0; i < 256; i++){
+        decodeTable[MIP_SRGB][i] = srgbToLinear(i / 255.0f);
+        decodeTable[MIP_LINEAR][i] = i / 255.0f;
+    }
+    for (int i = 0; i <= ENCODE_STEPS; i++){
+        encodeTable[i] = (unsigned char)lroundf(linearToSrgb((float)i / ENCODE_STEPS) * 255.0f);
+    }
+}
+
+// Source range [i * n / d, (i + 1) * n / d) of destination texel i
+static void computeTaps(int i, int size, int destSize, MipTaps* taps){
+    double scale = (double)size / destSize;
+    double start = i * scale, end = start + scale;
+    taps->first = (int)start;
+    taps->count = 0;
+    // Rounding can put the end a hair past the last texel
+    for (int s = taps->first; s < end && s < size && taps->count < MAX_TAPS; s++){
+        double lo = s > start ? s : start;
+        double hi = s + 1 < end ? s + 1 : end;
+        taps->weights[taps->count++] = (float)((hi - lo) / scale);
+    }
+}
+
+static unsigned char encodeValue(float v, int srgb){
+    if (v < 0.0f) v = 0.0f;
+    if (v > 1.0f) v = 1.0f;
+    return srgb ? encodeTable[(int)(v * ENCODE_STEPS + 0.5f)] : (unsigned char)(v * 255.0f + 0.5f);
+}
+
+// Filters destination texels [x0, x1) x [y0, y1) of the next level, src must hold every texel they cover
+// Rows are filtered horizontally into a linear accumulator, one source row at a time
+static void filterRect(const MipWindow* src, int width, int height, const MipWindow* dest, int channels, MipSpace space,
+                       int x0, int x1, int y0, int y1){
+    pthread_once(&tablesOnce, initTables);
+    int destWidth = width > 1 ? width / 2 : 1;
+    int destHeight = height > 1 ? height / 2 : 1;
+    int columns = x1 - x0;
+
+    // Grey and alpha or RGBA carry alpha last
+    int alpha = channels == 2 || channels == 4 ? channels - 1 : -1;
+    const float* decode = decodeTable[space];
+    const float* decodeAlpha = decodeTable[MIP_LINEAR];
+
+    MipTaps* columnTaps = (MipTaps*)malloc(sizeof(MipTaps) * columns);
+    float* sum = (float*)malloc(sizeof(float) * columns * channels);
+    if (!columnTaps || !sum){
+        printf("Failed to allocate memory for mipmaps\n");
+        free(columnTaps);
+        free(sum);
+        return;
+    }
+    // Taps index the window's columns from here on
+    for (int x = x0; x < x1; x++){
+        computeTaps(x, width, destWidth, &columnTaps[x - x0]);
+        columnTaps[x - x0].first -= src->x;
+    }
+
+    for (int y = y0; y < y1; y++){
+        MipTaps rowTaps;
+        computeTaps(y, height, destHeight, &rowTaps);
+        memset(sum, 0, sizeof(float) * columns * channels);
+
+        for (int r = 0; r < rowTaps.count; r++){
+            const unsigned char* row = src->pixels + (size_t)(rowTaps.first + r - src->y) * src->pitch * channels;
+            float rowWeight = rowTaps.weights[r];
+            for (int x = 0; x < columns; x++){
+                const MipTaps* taps = &columnTaps[x];
+                float* texelSum = sum + (size_t)x * channels;
+#ifdef MIP_SIMD
+                if (channels == 4){
+                    __m128 acc = _mm_setzero_ps();
+                    for (int t = 0; t < taps->count; t++){
+                        const unsigned char* p = row + (size_t)(taps->first + t) * 4;
+                        __m128 texel = _mm_set_ps(decodeAlpha[p[3]], decode[p[2]], decode[p[1]], decode[p[0]]);
+                        acc = _mm_add_ps(acc, _mm_mul_ps(texel, _mm_set1_ps(taps->weights[t])));
+                    }
+                    acc = _mm_mul_ps(acc, _mm_set1_ps(rowWeight));
+                    _mm_storeu_ps(texelSum, _mm_add_ps(_mm_loadu_ps(texelSum), acc));
+                    continue;
+                }
+#endif
+                for (int t = 0; t < taps->count; t++){
+                    const unsigned char* p = row + (size_t)(taps->first + t) * channels;
+                    float weight = taps->weights[t] * rowWeight;
+                    for (int c = 0; c < channels; c++){
+                        texelSum[c] += (c == alpha ? decodeAlpha[p[c]] : decode[p[c]]) * weight;
+                    }
+                }
+            }
+        }
+
+        unsigned char* out = dest->pixels + ((size_t)(y - dest->y) * dest->pitch + (x0 - dest->x)) * channels;
+        for (int i = 0; i < columns * channels; i++){
+            int c = i % channels;
+            out[i] = encodeValue(sum[i], space == MIP_SRGB && c != alpha);
+        }
+    }
+    free(columnTaps);
+    free(sum);
+}
+
+// Filters a level into the next one
+void downsampleMip(const unsigned char* src, int width, int height, unsigned char* dest, int channels, MipSpace space){
+    int destWidth = width > 1 ? width / 2 : 1;
+    int destHeight = height > 1 ? height / 2 : 1;
+    MipWindow srcLevel = {(unsigned char*)src, 0, 0, width};
+    MipWindow destLevel = {dest, 0, 0, destWidth};
+    filterRect(&srcLevel, width, height, &destLevel, channels, space, 0, destWidth, 0, destHeight);
+}
+
+// Filters every level below the pixels
+int generateMipChain(const unsigned char* pixels, int width, int height, int channels, MipSpace space, MipChain* chain){
+    memset(chain, 0, sizeof(MipChain));
+    chain->channels = channels;
+    chain->space = space;
+    chain->levels[0] = (unsigned char*)pixels;
+    chain->widths[0] = width;
+    chain->heights[0] = height;
+    chain->numLevels = 1;
+
+    while (chain->numLevels < MAX_MIP_LEVELS && (width > 1 || height > 1)){
+        int level = chain->numLevels;
+        int destWidth = width > 1 ? width / 2 : 1;
+        int destHeight = height > 1 ? height / 2 : 1;
+        chain->levels[level] = (unsigned char*)malloc((size_t)destWidth * destHeight * channels);
+        if (!chain->levels[level]){
+            printf("Failed to allocate memory for mipmaps\n");
+            freeMipChain(chain);
+            return 0;
+        }
+        downsampleMip(chain->levels[level - 1], width, height, chain->levels[level], channels, space);
+        chain->widths[level] = width = destWidth;
+        chain->heights[level] = height = destHeight;
+        chain->numLevels++;
+    }
+    return 1;
+}
+
+// Destination texel d covers [d * size / destSize, (d + 1) * size / destSize), so odd sizes don't just halve a range
+// First texel of the next level that texel i of this one contributes to
+static int scaleRangeStart(int i, int size, int destSize){
+    return (int)((long long)i * destSize / size);
+}
+
+// One past the last texel of the next level that the texels before i contribute to
+static int scaleRangeEnd(int i, int size, int destSize){
+    int end = (int)(((long long)i * destSize + size - 1) / size);
+    return end < destSize ? end : destSize;
+}
+
+// Filters one rectangle of level 0 down the chain again in another space
+void refilterMipRegion(MipChain* chain, int x, int y, int width, int height, MipSpace space){
+    // Range of the level above, carried down so every level widens it by what its own filter reaches
+    int x0 = x, y0 = y;
+    int x1 = x + width, y1 = y + height;
+    for (int level = 1; level < chain->numLevels; level++){
+        // Every texel of this level that any texel of the range above contributes to
+        int srcWidth = chain->widths[level - 1], srcHeight = chain->heights[level - 1];
+        x0 = scaleRangeStart(x0, srcWidth, chain->widths[level]);
+        y0 = scaleRangeStart(y0, srcHeight, chain->heights[level]);
+        x1 = scaleRangeEnd(x1, srcWidth, chain->widths[level]);
+        y1 = scaleRangeEnd(y1, srcHeight, chain->heights[level]);
+        if (x0 >= x1 || y0 >= y1){
+            return;
+        }
+        MipWindow src = {chain->levels[level - 1], 0, 0, srcWidth};
+        MipWindow dest = {chain->levels[level], 0, 0, chain->widths[level]};
+        filterRect(&src, srcWidth, srcHeight, &dest, chain->channels, space, x0, x1, y0, y1);
+    }
+}
+
+// Texels [start, end) of the next level whose every tap lies in [srcStart, srcEnd) of this one
+// Starts from the exact bounds and steps inwards where rounding puts a tap a hair outside
+static void innerRange(int srcStart, int srcEnd, int size, int destSize, int* start, int* end){
+    *start = (int)(((long long)srcStart * destSize + size - 1) / size);
+    *end = (int)((long long)srcEnd * destSize / size);
+    MipTaps taps;
+    while (*start < *end){
+        computeTaps(*start, size, destSize, &taps);
+        if (taps.first >= srcStart) break;
+        (*start)++;
+    }
+    while (*start < *end){
+        computeTaps(*end - 1, size, destSize, &taps);
+        if (taps.first + taps.count <= srcEnd) break;
+        (*end)--;
+    }
+}
+
+// Filters the levels of one rectangle of a bigger image, each holding the texels only the rectangle reaches
+int generateMipRegion(const unsigned char* pixels, int width, int height, MipRect rect, int channels, MipSpace space,
+                      MipRegion* region){
+    memset(region, 0, sizeof(MipRegion));
+    MipChain* mips = &region->mips;
+    mips->channels = channels;
+    mips->space = space;
+    mips->levels[0] = (unsigned char*)pixels;
+    mips->widths[0] = rect.x1 - rect.x0;
+    mips->heights[0] = rect.y1 - rect.y0;
+    mips->numLevels = 1;
+    region->rects[0] = rect;
+
+    // Stops where the rectangle no longer has a texel of its own, the rest of the levels mix it with its neighbours
+    while (mips->numLevels < MAX_MIP_LEVELS && (width > 1 || height > 1)){
+        int level = mips->numLevels;
+        int destWidth = width > 1 ? width / 2 : 1;
+        int destHeight = height > 1 ? height / 2 : 1;
+        const MipRect* above = &region->rects[level - 1];
+        MipRect* inner = &region->rects[level];
+        innerRange(above->x0, above->x1, width, destWidth, &inner->x0, &inner->x1);
+        innerRange(above->y0, above->y1, height, destHeight, &inner->y0, &inner->y1);
+        if (inner->x0 >= inner->x1 || inner->y0 >= inner->y1){
+            memset(inner, 0, sizeof(MipRect));
+            break;
+        }
+
+        mips->widths[level] = inner->x1 - inner->x0;
+        mips->heights[level] = inner->y1 - inner->y0;
+        mips->levels[level] = (unsigned char*)malloc((size_t)mips->widths[level] * mips->heights[level] * channels);
+        if (!mips->levels[level]){
+            printf("Failed to allocate memory for mipmaps\n");
+            freeMipChain(mips);
+            return 0;
+        }
+        MipWindow src = {mips->levels[level - 1], above->x0, above->y0, mips->widths[level - 1]};
+        MipWindow dest = {mips->levels[level], inner->x0, inner->y0, mips->widths[level]};
+        filterRect(&src, width, height, &dest, channels, space, inner->x0, inner->x1, inner->y0, inner->y1);
+        mips->numLevels++;
+        width = destWidth;
+        height = destHeight;
+    }
+    return 1;
+}
+
+// Filters one range of a chain level from the level above, skipped when empty
+static void filterChainRect(MipChain* chain, int level, MipSpace space, int x0, int x1, int y0, int y1){
+    if (x0 >= x1 || y0 >= y1){
+        return;
+    }
+    MipWindow src = {chain->levels[level - 1], 0, 0, chain->widths[level - 1]};
+    MipWindow dest = {chain->levels[level], 0, 0, chain->widths[level]};
+    filterRect(&src, chain->widths[level - 1], chain->heights[level - 1], &dest, chain->channels, space, x0, x1, y0, y1);
+}
+
+// Copies a region into the chain it was filtered for, then filters the texels around it that mix it with its neighbours
+void spliceMipRegion(MipChain* chain, const MipRegion* region, MipRect* changed){
+    const MipChain* mips = &region->mips;
+    MipRect range = region->rects[0];
+    memset(changed, 0, sizeof(MipRect) * chain->numLevels);
+    for (int level = 0; level < chain->numLevels; level++){
+        if (level > 0){
+            // Every texel that any changed texel of the level above contributes to
+            int srcWidth = chain->widths[level - 1], srcHeight = chain->heights[level - 1];
+            range.x0 = scaleRangeStart(range.x0, srcWidth, chain->widths[level]);
+            range.y0 = scaleRangeStart(range.y0, srcHeight, chain->heights[level]);
+            range.x1 = scaleRangeEnd(range.x1, srcWidth, chain->widths[level]);
+            range.y1 = scaleRangeEnd(range.y1, srcHeight, chain->heights[level]);
+        }
+        if (range.x0 >= range.x1 || range.y0 >= range.y1){
+            return;
+        }
+        changed[level] = range;
+
+        // Texels the region filtered on its own are already final
+        MipRect inner = {0, 0, 0, 0};
+        if (level < mips->numLevels){
+            inner = region->rects[level];
+            if (inner.x0 < range.x0) inner.x0 = range.x0;
+            if (inner.y0 < range.y0) inner.y0 = range.y0;
+            if (inner.x1 > range.x1) inner.x1 = range.x1;
+            if (inner.y1 > range.y1) inner.y1 = range.y1;
+        }
+        if (inner.x0 >= inner.x1 || inner.y0 >= inner.y1){
+            filterChainRect(chain, level, mips->space, range.x0, range.x1, range.y0, range.y1);
+            continue;
+        }
+        size_t rowSize = (size_t)(inner.x1 - inner.x0) * chain->channels;
+        for (int y = inner.y0; y < inner.y1; y++){
+            const unsigned char* src = mips->levels[level]
+                                     + ((size_t)(y - region->rects[level].y0) * mips->widths[level] + (inner.x0 - region->rects[level].x0)) * chain->channels;
+            memcpy(chain->levels[level] + ((size_t)y * chain->widths[level] + inner.x0) * chain->channels, src, rowSize);
+        }
+
+        // The ring between the two, rows above and below, then columns left and right
+        if (level > 0){
+            filterChainRect(chain, level, mips->space, range.x0, range.x1, range.y0, inner.y0);
+            filterChainRect(chain, level, mips->space, range.x0, range.x1, inner.y1, range.y1);
+            filterChainRect(chain, level, mips->space, range.x0, inner.x0, inner.y0, inner.y1);
+            filterChainRect(chain, level, mips->space, inner.x1, range.x1, inner.y0, inner.y1);
+        }
+    }
+}
+
+// Frees the levels below level 0
+void freeMipRegion(MipRegion* region){
+    freeMipChain(&region->mips);
+    memset(region, 0, sizeof(MipRegion));
+}
+
+// Grey and alpha color has no sRGB format of its own, it is stored as RGBA so only the grey is decoded
+static int expandsToRgba(const MipChain* chain){
+    return chain->channels == 2 && chain->space == MIP_SRGB;
+}
+
+// Uploads one level to the bound 2D texture, allocating it or replacing its pixels
+// rgba holds room for the level when the chain expands to RGBA
+static void uploadLevel(const MipChain* chain, int level, GLenum internalFormat, int replace, unsigned char* rgba){
+    static const GLenum formats[4] = {GL_RED, GL_RG, GL_RGB, GL_RGBA};
+    GLenum format = formats[chain->channels - 1];
+    const unsigned char* pixels = chain->levels[level];
+    if (expandsToRgba(chain)){
+        size_t count = (size_t)chain->widths[level] * chain->heights[level];
+        for (size_t i = 0; i < count; i++){
+            rgba[i * 4 + 0] = rgba[i * 4 + 1] = rgba[i * 4 + 2] = pixels[i * 2];
+            rgba[i * 4 + 3] = pixels[i * 2 + 1];
+        }
+        format = GL_RGBA;
+        pixels = rgba;
+    }
+    if (replace){
+        glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, chain->widths[level], chain->heights[level], format, GL_UNSIGNED_BYTE, pixels);
+    }
+    else {
+        glTexImage2D(GL_TEXTURE_2D, level, internalFormat, chain->widths[level], chain->heights[level], 0,
+                     format, GL_UNSIGNED_BYTE, pixels);
+    }
+}
+
+// Uploads or replaces every level, level 0 is the largest so its room serves all of them
+static void uploadLevels(const MipChain* chain, GLenum internalFormat, int replace){
+    unsigned char* rgba = NULL;
+    if (expandsToRgba(chain)){
+        rgba = (unsigned char*)malloc((size_t)chain->widths[0] * chain->heights[0] * 4);
+        if (!rgba){
+            printf("Failed to allocate memory for mipmaps\n");
+            return;
+        }
+    }
+
+    // Odd levels of RGB images have rows that are not 4 byte aligned
+    GLint alignment;
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (int level = 0; level < chain->numLevels; level++){
+        uploadLevel(chain, level, internalFormat, replace, rgba);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+    free(rgba);
+}
+
+// Uploads every level of the chain to the bound 2D texture
+void uploadMipChain(const MipChain* chain){
+    // Color is decoded to linear by the sampler, there is no one or two channel sRGB format so grey takes three or four
+    static const GLenum internalFormats[2][4] = {
+        {GL_SRGB8, GL_SRGB8_ALPHA8, GL_SRGB8, GL_SRGB8_ALPHA8}, // MIP_SRGB
+        {GL_R8, GL_RG8, GL_RGB8, GL_RGBA8}                      // MIP_LINEAR
+    };
+    uploadLevels(chain, internalFormats[chain->space][chain->channels - 1], 0);
+
+    // Levels left from a bigger image would make the texture incomplete
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, chain->numLevels - 1);
+
+    // Grey images read as grey, with their alpha when they have one, and the texture may have held one before
+    GLint swizzle[4] = {GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA};
+    if (chain->channels <= 2 && !expandsToRgba(chain)){
+        GLint grey[4] = {GL_RED, GL_RED, GL_RED, chain->channels == 2 ? GL_GREEN : GL_ONE};
+        memcpy(swizzle, grey, sizeof(swizzle));
+    }
+    glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+}
+
+// Replaces the pixels of every level of the bound 2D texture
+void replaceMipChain(const MipChain* chain){
+    uploadLevels(chain, GL_NONE, 1);
+}
+
+// Frees the levels below level 0
+void freeMipChain(MipChain* chain){
+    for (int level = 1; level < chain->numLevels; level++){
+        free(chain->levels[level]);
+    }
+    memset(chain, 0, sizeof(MipChain));
+}
\ No newline at end of file
@@ -3,8 +3,30 @@
 #include <stdio.h>
 #include <string.h>
 
-int loadMtl(const char* path, MaterialData* materialData){
+// Default values for a material the file leaves incomplete
+static void initMaterial(MaterialData* material, const char* name){
+    memset(material, 0, sizeof(MaterialData));
+    snprintf(material->name, MATERIAL_NAME_LENGTH, "%s", name);
+    material->Kd[0] = material->Kd[1] = material->Kd[2] = 1.0f;
+    material->Ns = 1.0f;
+    material->d = 1.0f;
+}
+
+// Texture paths in the file are relative to the file itself
+static void readMapPath(const char* line, const char* directory, int directoryLength, char* destination){
+    // Skip the directive, options are not supported so the name is the last word
+    const char* name = strrchr(line, ' ');
+    if (name == NULL){
+        return;
+    }
+    name++;
+    int length = (int)strcspn(name, "\r\n");
+    snprintf(destination, MATERIAL_PATH_LENGTH, "%.*s%.*s", directoryLength, directory, length, name);
+}
+
+int loadMtl(const char* path, MaterialLibrary* library){
     printf("Loading MTL file: (%s)\n", path);
+    memset(library, 0, sizeof(MaterialLibrary));
 
      // Open the file
     FILE* file = fopen(path, "r");
@@ -13,9 +35,30 @@ int loadMtl(const char* path, MaterialData* materialData){
         return 0;
     }
 
-    char line_buffer[128];
+    // Directory part of the path, with its trailing slash
+    const char* slash = strrchr(path, '/');
+    int directoryLength = slash ? (int)(slash - path) + 1 : 0;
+
+    MaterialData* materialData = NULL;
+    char line_buffer[512];
     // Read the file line by line
     while (fgets(line_buffer, sizeof(line_buffer), file)) {
+        // New material, everything after it belongs to it
+        if (strncmp(line_buffer, "newmtl ", 7) == 0) {
+            if (library->numMaterials >= MAX_MATERIALS) {
+                printf("Too many materials in: (%s)\n", path);
+                break;
+            }
+            char name[MATERIAL_NAME_LENGTH];
+            sscanf(line_buffer, "newmtl %63s", name);
+            materialData = &library->materials[library->numMaterials++];
+            initMaterial(materialData, name);
+            continue;
+        }
+        if (materialData == NULL) {
+            continue;
+        }
+
         // Ambient
         if (strncmp(line_buffer, "Ka ", 3) == 0) {
             sscanf(line_buffer, "Ka %f %f %f", &materialData->Ka[0], &materialData->Ka[1], &materialData->Ka[2]);
@@ -40,8 +83,27 @@ int loadMtl(const char* path, MaterialData* materialData){
         else if (strncmp(line_buffer, "illum ", 6) == 0) {
             sscanf(line_buffer, "illum %d", &materialData->illum);
         }
+        // Diffuse texture
+        else if (strncmp(line_buffer, "map_Kd ", 7) == 0) {
+            readMapPath(line_buffer, path, directoryLength, materialData->diffuseMap);
+        }
+        // Bump or normal map, both spellings are in use
+        else if (strncmp(line_buffer, "map_Bump ", 9) == 0 || strncmp(line_buffer, "bump ", 5) == 0) {
+            readMapPath(line_buffer, path, directoryLength, materialData->bumpMap);
+        }
     }
 
     fclose(file);
+    printf("Loaded (%d) materials\n", library->numMaterials);
     return 1;
+}
+
+// Finds a material by its newmtl name
+int findMaterial(const MaterialLibrary* library, const char* name){
+    for (int i = 0; i < library->numMaterials; i++){
+        if (strcmp(library->materials[i].name, name) == 0){
+            return i;
+        }
+    }
+    return -1;
 }
\ No newline at end of file
@@ -1,20 +1,78 @@
 #include "../include/obj_loader.h"
+#include "../include/tangents.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 // Helper to realloc temporary arrays if needed
-void capacityCheck(float** array, int* capacity,int count){
+// 0 on failure, the array and capacity are left as they were, 1 on success
+int capacityCheck(float** array, int* capacity,int count){
     if (count >= *capacity){
+        float* grown = (float*)realloc(*array, (*capacity) * 2 * sizeof(float));
+        if (grown == NULL){
+            printf("Failed to grow OBJ array: (%d) floats\n", (*capacity) * 2);
+            return 0;
+        }
+        *array = grown;
         *capacity *= 2;
-        *array = (float*)realloc(*array, (*capacity) * sizeof(float));
     }
+    return 1;
+}
+
+// Finds the submesh of a usemtl name, adding it on first use
+// Past MAX_SUBMESHES further materials share the last submesh
+static int addSubmesh(LoadedObject* obj, const char* name){
+    for (int i = 0; i < obj->numSubmeshes; i++){
+        if (strcmp(obj->submeshMaterials[i], name) == 0){
+            return i;
+        }
+    }
+    if (obj->numSubmeshes >= MAX_SUBMESHES){
+        printf("Too many materials, (%s) shares the last submesh\n", name);
+        return MAX_SUBMESHES - 1;
+    }
+    snprintf(obj->submeshMaterials[obj->numSubmeshes], MATERIAL_NAME_LENGTH, "%s", name);
+    return obj->numSubmeshes++;
+}
+
+// Reorders the triangles of level 0 by submesh, keeping their order inside each one
+// 0 on failure, 1 on success
+static int groupSubmeshes(LoadedObject* obj, const unsigned char* face_submeshes){
+    int triangleCount = obj->numIndices / 3;
+    MeshLod* lod = &obj->lods[0];
+    for (int t = 0; t < triangleCount; t++){
+        lod->submeshIndices[face_submeshes[t]] += 3;
+    }
+    if (obj->numSubmeshes <= 1 || triangleCount == 0){
+        return 1;
+    }
+
+    // Counting sort, one start offset per submesh
+    int starts[MAX_SUBMESHES];
+    int offset = 0;
+    for (int i = 0; i < obj->numSubmeshes; i++){
+        starts[i] = offset;
+        offset += lod->submeshIndices[i];
+    }
+    unsigned int* sorted = (unsigned int*)malloc(obj->numIndices * sizeof(unsigned int));
+    if (sorted == NULL){
+        printf("Failed to allocate submesh order: (%d) indices\n", obj->numIndices);
+        return 0;
+    }
+    for (int t = 0; t < triangleCount; t++){
+        memcpy(&sorted[starts[face_submeshes[t]]], &obj->indices[t * 3], 3 * sizeof(unsigned int));
+        starts[face_submeshes[t]] += 3;
+    }
+    free(obj->indices);
+    obj->indices = sorted;
+    return 1;
 }
 
 // Loads an OBJ file from the given path into the provided LoadedObject structure
 // 0 on failure, 1 on success
 int loadObj(const char* path,LoadedObject* returnObject){
     printf("Loading OBJ file: (%s)\n", path);
+    memset(returnObject, 0, sizeof(LoadedObject));
 
     // Open the file
     FILE* file = fopen(path, "r");
@@ -40,28 +98,49 @@ int loadObj(const char* path,LoadedObject* returnObject){
     unsigned int* uv_indices = (unsigned int*)malloc(max_indices * sizeof(unsigned int));
     unsigned int* normal_indices = (unsigned int*)malloc(max_indices * sizeof(unsigned int));
 
+    // Submesh of every face, set by the last usemtl line
+    unsigned char* face_submeshes = (unsigned char*)malloc(max_indices / 3 + 1);
+    int current_submesh = -1;
+
+    // Vertex dedup table, allocated once the faces are read
+    unsigned int* table = NULL;
+    unsigned int* keys = NULL;
+
+    // Like a missing file, running out of memory leaves returnObject empty
+    int success = 0;
+    if (!temp_vertices || !temp_uvs || !temp_normals || !vertex_indices || !uv_indices || !normal_indices || !face_submeshes){
+        printf("Failed to allocate OBJ arrays: (%s)\n", path);
+        goto cleanup;
+    }
+
     char line_buffer[128];
     // Read the file line by line
     while (fgets(line_buffer, sizeof(line_buffer), file)) {
 
         // Vertex
         if (strncmp(line_buffer, "v ", 2) == 0) {
-            capacityCheck(&temp_vertices, &max_vertices, vertex_count + 3);
+            if (capacityCheck(&temp_vertices, &max_vertices, vertex_count + 3) == 0) goto cleanup;
             sscanf(line_buffer, "v %f %f %f", &temp_vertices[vertex_count], &temp_vertices[vertex_count+1], &temp_vertices[vertex_count+2]);
             vertex_count += 3;
         }
         // Texture Coordinates
         else if (strncmp(line_buffer, "vt ", 3) == 0) {
-            capacityCheck(&temp_uvs, &max_uvs, uv_count + 2);
+            if (capacityCheck(&temp_uvs, &max_uvs, uv_count + 2) == 0) goto cleanup;
             sscanf(line_buffer, "vt %f %f", &temp_uvs[uv_count], &temp_uvs[uv_count+1]);
             uv_count += 2;
         }
         // Normals
         else if (strncmp(line_buffer, "vn ", 3) == 0) {
-            capacityCheck(&temp_normals, &max_normals, normal_count + 3);
+            if (capacityCheck(&temp_normals, &max_normals, normal_count + 3) == 0) goto cleanup;
             sscanf(line_buffer, "vn %f %f %f", &temp_normals[normal_count], &temp_normals[normal_count+1], &temp_normals[normal_count+2]);
             normal_count += 3;
         }
+        // Material of the following faces
+        else if (strncmp(line_buffer, "usemtl ", 7) == 0) {
+            char name[MATERIAL_NAME_LENGTH];
+            sscanf(line_buffer, "usemtl %63s", name);
+            current_submesh = addSubmesh(returnObject, name);
+        }
         // Face
         else if (strncmp(line_buffer, "f ", 2) == 0) {
             unsigned int vertexIndex[3], uvIndex[3], normalIndex[3];
@@ -72,11 +151,27 @@ int loadObj(const char* path,LoadedObject* returnObject){
             
             if (matches == 9) {
                 if (index_count + 3 >= max_indices) {
+                    // Each array keeps its old block if growing it fails, so cleanup frees them all
                     max_indices *= 2;
-                    vertex_indices = (unsigned int*)realloc(vertex_indices, max_indices * sizeof(unsigned int));
-                    uv_indices     = (unsigned int*)realloc(uv_indices,     max_indices * sizeof(unsigned int));
-                    normal_indices = (unsigned int*)realloc(normal_indices, max_indices * sizeof(unsigned int));
+                    unsigned int* grown_vertices = (unsigned int*)realloc(vertex_indices, max_indices * sizeof(unsigned int));
+                    if (grown_vertices) vertex_indices = grown_vertices;
+                    unsigned int* grown_uvs = (unsigned int*)realloc(uv_indices, max_indices * sizeof(unsigned int));
+                    if (grown_uvs) uv_indices = grown_uvs;
+                    unsigned int* grown_normals = (unsigned int*)realloc(normal_indices, max_indices * sizeof(unsigned int));
+                    if (grown_normals) normal_indices = grown_normals;
+                    unsigned char* grown_submeshes = (unsigned char*)realloc(face_submeshes, max_indices / 3 + 1);
+                    if (grown_submeshes) face_submeshes = grown_submeshes;
+                    if (!grown_vertices || !grown_uvs || !grown_normals || !grown_submeshes){
+                        printf("Failed to grow OBJ face arrays: (%d) indices\n", max_indices);
+                        goto cleanup;
+                    }
+                }
+
+                // Faces before any usemtl get a submesh without a material
+                if (current_submesh < 0) {
+                    current_submesh = addSubmesh(returnObject, "");
                 }
+                face_submeshes[index_count / 3] = (unsigned char)current_submesh;
 
                 // Store the indices
                 // Will be used to correctly package the data later
@@ -91,44 +186,118 @@ int loadObj(const char* path,LoadedObject* returnObject){
     }
 
     // Allocate the return structs
-    returnObject->numVertices = index_count;
+    // At most one vertex per face corner, shrunk once duplicates are merged
+    returnObject->numIndices = index_count;
+    returnObject->indices = (unsigned int*)malloc(index_count * sizeof(unsigned int));
     returnObject->vertices = (Vertex*)malloc(index_count * sizeof(Vertex));
+    returnObject->numVertices = 0;
+
+    // Hash table of the v/vt/vn triples already turned into vertices
+    // Slots hold the vertex index + 1, 0 marks an empty slot
+    unsigned int table_size = 1;
+    while (table_size < (unsigned int)index_count * 2) table_size <<= 1;
+    table = (unsigned int*)calloc(table_size, sizeof(unsigned int));
+    keys = (unsigned int*)malloc(index_count * 3 * sizeof(unsigned int));
+
+    // A file without faces asks for zero bytes, which may come back as NULL
+    if (!table || (index_count > 0 && (!returnObject->indices || !returnObject->vertices || !keys))){
+        printf("Failed to allocate OBJ mesh: (%d) indices\n", index_count);
+        goto cleanup;
+    }
 
     // Fill struct with the faces read 
     // Each face is basically three consequative slots in the three '_indices' arrays. 
+    // Corners that share all three indices share one vertex
     for (int i = 0; i < index_count; i++) {
         unsigned int v_idx = vertex_indices[i] - 1;
         unsigned int uv_idx = uv_indices[i] - 1;
         unsigned int n_idx = normal_indices[i] - 1;
 
+        // Look for the triple
+        unsigned int slot = ((v_idx * 73856093u) ^ (uv_idx * 19349663u) ^ (n_idx * 83492791u)) & (table_size - 1);
+        while (table[slot] != 0) {
+            unsigned int* key = &keys[(table[slot] - 1) * 3];
+            if (key[0] == v_idx && key[1] == uv_idx && key[2] == n_idx) {
+                break;
+            }
+            slot = (slot + 1) & (table_size - 1);
+        }
+        if (table[slot] != 0) {
+            returnObject->indices[i] = table[slot] - 1;
+            continue;
+        }
+
+        // New vertex
+        int k = returnObject->numVertices++;
+        table[slot] = k + 1;
+        keys[k * 3 + 0] = v_idx;
+        keys[k * 3 + 1] = uv_idx;
+        keys[k * 3 + 2] = n_idx;
+        returnObject->indices[i] = k;
+
         // Position
-        returnObject->vertices[i].x = temp_vertices[v_idx * 3 + 0];
-        returnObject->vertices[i].y = temp_vertices[v_idx * 3 + 1];
-        returnObject->vertices[i].z = temp_vertices[v_idx * 3 + 2];
+        returnObject->vertices[k].x = temp_vertices[v_idx * 3 + 0];
+        returnObject->vertices[k].y = temp_vertices[v_idx * 3 + 1];
+        returnObject->vertices[k].z = temp_vertices[v_idx * 3 + 2];
 
         // Texture Cooirdinates
-        returnObject->vertices[i].u = temp_uvs[uv_idx * 2 + 0];
-        returnObject->vertices[i].v = temp_uvs[uv_idx * 2 + 1];
+        returnObject->vertices[k].u = temp_uvs[uv_idx * 2 + 0];
+        returnObject->vertices[k].v = temp_uvs[uv_idx * 2 + 1];
 
         // Normals
-        returnObject->vertices[i].nx = temp_normals[n_idx * 3 + 0];
-        returnObject->vertices[i].ny = temp_normals[n_idx * 3 + 1];
-        returnObject->vertices[i].nz = temp_normals[n_idx * 3 + 2];
+        returnObject->vertices[k].nx = temp_normals[n_idx * 3 + 0];
+        returnObject->vertices[k].ny = temp_normals[n_idx * 3 + 1];
+        returnObject->vertices[k].nz = temp_normals[n_idx * 3 + 2];
     }
-    
+    if (returnObject->numVertices > 0) {
+        // Shrinking can only fail by keeping the larger block
+        Vertex* trimmed = (Vertex*)realloc(returnObject->vertices, returnObject->numVertices * sizeof(Vertex));
+        if (trimmed) returnObject->vertices = trimmed;
+    }
+    printf("Loaded (%d) vertices, (%d) triangles\n", returnObject->numVertices, index_count / 3);
+
+    // Tangent frames for normal mapping
+    if (generateTangents(returnObject->vertices, returnObject->numVertices, returnObject->indices, index_count) == 0){
+        goto cleanup;
+    }
+
+    // Only the full detail level until generateLods is called
+    returnObject->numLods = 1;
+    returnObject->lods[0].indexOffset = 0;
+    returnObject->lods[0].numIndices = index_count;
+    returnObject->lods[0].error = 0.0f;
+
+    // Group the triangles by submesh so every material is one index range
+    if (groupSubmeshes(returnObject, face_submeshes) == 0){
+        goto cleanup;
+    }
+
+    // Bounding box and sphere of the mesh
+    computeBounds(returnObject->vertices, returnObject->numVertices, sizeof(Vertex), &returnObject->bounds);
+    success = 1;
+
     // Free temporary arrays
+cleanup:
+    free(table);
+    free(keys);
     free(temp_vertices);
     free(temp_uvs);
     free(temp_normals);
     free(vertex_indices);
     free(uv_indices);
     free(normal_indices);
+    free(face_submeshes);
     fclose(file);
 
-    return 1;
+    if (!success){
+        freeObj(returnObject);
+        memset(returnObject, 0, sizeof(LoadedObject));
+    }
+    return success;
 }
 
 // Frees the final arrays in the LoadedObject
 void freeObj(LoadedObject* obj){
     free(obj->vertices);
+    free(obj->indices);
 }
\ No newline at end of file
@@ -0,0 +1,210 @@
+#include "../include/orbit.h"
+#include "../include/shader.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Axis every body spins around
+static vec3 SPIN_AXIS = {0.5f, 1.0f, 0.0f};
+
+// Layout of the per body parameters given to the feedback pass
+typedef struct {
+    float orbit[4];       // radius, phase, speed, spin
+    float parentOrbit[4]; // radius, phase, speed, has parent
+} OrbitParams;
+
+// Allocates the parameter arrays for the given amount of bodies
+// 0 on failure, 1 on success
+int initOrbitSystem(OrbitSystem* orbits, int numBodies){
+    memset(orbits, 0, sizeof(OrbitSystem));
+    orbits->numBodies = numBodies;
+
+    orbits->radius = (float*)calloc(numBodies, sizeof(float));
+    orbits->phase = (float*)calloc(numBodies, sizeof(float));
+    orbits->speed = (float*)calloc(numBodies, sizeof(float));
+    orbits->spin = (float*)calloc(numBodies, sizeof(float));
+    orbits->parent = (int*)malloc(numBodies * sizeof(int));
+    orbits->posX = (float*)calloc(numBodies, sizeof(float));
+    orbits->posY = (float*)calloc(numBodies, sizeof(float));
+    orbits->posZ = (float*)calloc(numBodies, sizeof(float));
+    orbits->cpuMatrices = (mat4*)malloc(numBodies * sizeof(mat4));
+
+    if (!orbits->radius || !orbits->phase || !orbits->speed || !orbits->spin || !orbits->parent ||
+        !orbits->posX || !orbits->posY || !orbits->posZ || !orbits->cpuMatrices){
+        printf("Failed to allocate orbit system for (%d) bodies\n", numBodies);
+        freeOrbitSystem(orbits);
+        return 0;
+    }
+
+    // Everything orbits the origin by default
+    for (int i = 0; i < numBodies; i++){
+        orbits->parent[i] = -1;
+    }
+    return 1;
+}
+
+// Uploads the body parameters and creates the GPU buffers
+void uploadOrbitSystem(OrbitSystem* orbits, int useGPU){
+    // Matrix buffer, filled every frame by one of the two paths
+    glGenBuffers(1, &orbits->matrixVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, orbits->matrixVBO);
+    glBufferData(GL_ARRAY_BUFFER, orbits->numBodies * sizeof(mat4), NULL, GL_DYNAMIC_COPY);
+
+    // Shaders fetch the matrices by body index
+    glGenTextures(1, &orbits->matrixTexture);
+    glBindTexture(GL_TEXTURE_BUFFER, orbits->matrixTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, orbits->matrixVBO);
+
+    orbits->useGPU = 0;
+    if (!useGPU){
+        printf("Orbits: CPU path for (%d) bodies\n", orbits->numBodies);
+        return;
+    }
+
+    // The four columns of the model matrix are captured back to back
+    const char* varyings[] = {"ModelCol0", "ModelCol1", "ModelCol2", "ModelCol3"};
+    orbits->program = loadFeedbackShader("shaders/orbit.glsl", NULL, varyings, 4);
+    if (orbits->program == 0){
+        printf("Orbits: feedback shader failed, falling back to the CPU path\n");
+        return;
+    }
+    orbits->timeLoc = glGetUniformLocation(orbits->program, "time");
+    orbits->spinAxisLoc = glGetUniformLocation(orbits->program, "spinAxis");
+
+    // Pack the parameters, a body carries a copy of its parent's orbit
+    OrbitParams* params = (OrbitParams*)malloc(orbits->numBodies * sizeof(OrbitParams));
+    if (params == NULL){
+        printf("Failed to allocate orbit parameters, falling back to the CPU path\n");
+        glDeleteProgram(orbits->program);
+        orbits->program = 0;
+        return;
+    }
+    for (int i = 0; i < orbits->numBodies; i++){
+        params[i].orbit[0] = orbits->radius[i];
+        params[i].orbit[1] = orbits->phase[i];
+        params[i].orbit[2] = orbits->speed[i];
+        params[i].orbit[3] = orbits->spin[i];
+
+        int p = orbits->parent[i];
+        params[i].parentOrbit[0] = p >= 0 ? orbits->radius[p] : 0.0f;
+        params[i].parentOrbit[1] = p >= 0 ? orbits->phase[p] : 0.0f;
+        params[i].parentOrbit[2] = p >= 0 ? orbits->speed[p] : 0.0f;
+        params[i].parentOrbit[3] = p >= 0 ? 1.0f : 0.0f;
+    }
+
+    // Create the VAO read by the feedback pass
+    glGenVertexArrays(1, &orbits->paramsVAO);
+    glBindVertexArray(orbits->paramsVAO);
+
+    glGenBuffers(1, &orbits->paramsVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, orbits->paramsVBO);
+    glBufferData(GL_ARRAY_BUFFER, orbits->numBodies * sizeof(OrbitParams), params, GL_STATIC_DRAW);
+    free(params);
+
+    // Orbit
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(OrbitParams), (void*)offsetof(OrbitParams, orbit));
+    glEnableVertexAttribArray(0);
+
+    // Parent orbit
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(OrbitParams), (void*)offsetof(OrbitParams, parentOrbit));
+    glEnableVertexAttribArray(1);
+
+    glBindVertexArray(0);
+
+    // The axis never changes
+    glUseProgram(orbits->program);
+    vec3 axis;
+    glm_normalize_to(SPIN_AXIS, axis);
+    glUniform3fv(orbits->spinAxisLoc, 1, axis);
+
+    orbits->useGPU = 1;
+    printf("Orbits: transform feedback path for (%d) bodies\n", orbits->numBodies);
+}
+
+// Calculates the position of a single body on the CPU
+void getOrbitPosition(OrbitSystem* orbits, int body, float time, vec3 dest){
+    float angle = time * orbits->speed[body] + orbits->phase[body];
+    dest[0] = sinf(angle) * orbits->radius[body];
+    dest[1] = 0.0f;
+    dest[2] = cosf(angle) * orbits->radius[body];
+
+    // Move to the parent's position
+    int p = orbits->parent[body];
+    if (p >= 0){
+        float parentAngle = time * orbits->speed[p] + orbits->phase[p];
+        dest[0] += sinf(parentAngle) * orbits->radius[p];
+        dest[2] += cosf(parentAngle) * orbits->radius[p];
+    }
+}
+
+// Calculates the positions of every body on the CPU into posX, posY, posZ
+void updateOrbitPositions(OrbitSystem* orbits, float time){
+    // Own orbits first
+    for (int i = 0; i < orbits->numBodies; i++){
+        float angle = time * orbits->speed[i] + orbits->phase[i];
+        orbits->posX[i] = sinf(angle) * orbits->radius[i];
+        orbits->posY[i] = 0.0f;
+        orbits->posZ[i] = cosf(angle) * orbits->radius[i];
+    }
+
+    // Parents have no parents, so their positions are final already
+    for (int i = 0; i < orbits->numBodies; i++){
+        int p = orbits->parent[i];
+        if (p >= 0){
+            orbits->posX[i] += orbits->posX[p];
+            orbits->posY[i] += orbits->posY[p];
+            orbits->posZ[i] += orbits->posZ[p];
+        }
+    }
+}
+
+// Advances every body to the given time and writes its model matrix to matrixVBO
+void updateOrbits(OrbitSystem* orbits, float time){
+    if (orbits->useGPU){
+        // One point per body, nothing is rasterized
+        glUseProgram(orbits->program);
+        glUniform1f(orbits->timeLoc, time);
+
+        glEnable(GL_RASTERIZER_DISCARD);
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, orbits->matrixVBO);
+        glBindVertexArray(orbits->paramsVAO);
+
+        glBeginTransformFeedback(GL_POINTS);
+        glDrawArrays(GL_POINTS, 0, orbits->numBodies);
+        glEndTransformFeedback();
+
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+        glDisable(GL_RASTERIZER_DISCARD);
+        return;
+    }
+
+    // CPU path, same math as shaders/orbit.glsl
+    updateOrbitPositions(orbits, time);
+    for (int i = 0; i < orbits->numBodies; i++){
+        vec3 pos = {orbits->posX[i], orbits->posY[i], orbits->posZ[i]};
+        glm_translate_make(orbits->cpuMatrices[i], pos);
+        glm_rotate(orbits->cpuMatrices[i], time * orbits->spin[i], SPIN_AXIS);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, orbits->matrixVBO);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, orbits->numBodies * sizeof(mat4), orbits->cpuMatrices);
+}
+
+// Frees the arrays and GPU objects of the system
+void freeOrbitSystem(OrbitSystem* orbits){
+    free(orbits->radius);
+    free(orbits->phase);
+    free(orbits->speed);
+    free(orbits->spin);
+    free(orbits->parent);
+    free(orbits->posX);
+    free(orbits->posY);
+    free(orbits->posZ);
+    free(orbits->cpuMatrices);
+
+    if (orbits->program) glDeleteProgram(orbits->program);
+    if (orbits->paramsVAO) glDeleteVertexArrays(1, &orbits->paramsVAO);
+    if (orbits->paramsVBO) glDeleteBuffers(1, &orbits->paramsVBO);
+    if (orbits->matrixTexture) glDeleteTextures(1, &orbits->matrixTexture);
+    if (orbits->matrixVBO) glDeleteBuffers(1, &orbits->matrixVBO);
+    memset(orbits, 0, sizeof(OrbitSystem));
+}
\ No newline at end of file
@@ -0,0 +1,311 @@
+#include "../include/primitives.h"
+#include "../include/mesh_optimize.h"
+#include "../include/tangents.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PI 3.14159265358979f
+
+// Corners of an icosahedron, (1, golden ratio) rectangles on the three planes
+static const float ICOSAHEDRON_VERTICES[12][3] = {
+    {-1.0f,  1.618034f,  0.0f}, { 1.0f,  1.618034f,  0.0f}, {-1.0f, -1.618034f,  0.0f}, { 1.0f, -1.618034f,  0.0f},
+    { 0.0f, -1.0f,  1.618034f}, { 0.0f,  1.0f,  1.618034f}, { 0.0f, -1.0f, -1.618034f}, { 0.0f,  1.0f, -1.618034f},
+    { 1.618034f,  0.0f, -1.0f}, { 1.618034f,  0.0f,  1.0f}, {-1.618034f,  0.0f, -1.0f}, {-1.618034f,  0.0f,  1.0f}
+};
+
+// Faces of the icosahedron, counter clockwise seen from outside
+static const unsigned int ICOSAHEDRON_FACES[20][3] = {
+    {0, 11, 5}, {0, 5, 1}, {0, 1, 7}, {0, 7, 10}, {0, 10, 11},
+    {1, 5, 9}, {5, 11, 4}, {11, 10, 2}, {10, 7, 6}, {7, 1, 8},
+    {3, 9, 4}, {3, 4, 2}, {3, 2, 6}, {3, 6, 8}, {3, 8, 9},
+    {4, 9, 5}, {2, 4, 11}, {6, 2, 10}, {8, 6, 7}, {9, 8, 1}
+};
+
+// Faces of a cube: normal, then the axes of the face's U and V (U x V = normal)
+static const float CUBE_FACES[6][3][3] = {
+    {{ 1.0f,  0.0f,  0.0f}, { 0.0f,  0.0f, -1.0f}, {0.0f, 1.0f,  0.0f}}, // Right
+    {{-1.0f,  0.0f,  0.0f}, { 0.0f,  0.0f,  1.0f}, {0.0f, 1.0f,  0.0f}}, // Left
+    {{ 0.0f,  1.0f,  0.0f}, { 1.0f,  0.0f,  0.0f}, {0.0f, 0.0f, -1.0f}}, // Top
+    {{ 0.0f, -1.0f,  0.0f}, { 1.0f,  0.0f,  0.0f}, {0.0f, 0.0f,  1.0f}}, // Bottom
+    {{ 0.0f,  0.0f,  1.0f}, { 1.0f,  0.0f,  0.0f}, {0.0f, 1.0f,  0.0f}}, // Front
+    {{ 0.0f,  0.0f, -1.0f}, {-1.0f,  0.0f,  0.0f}, {0.0f, 1.0f,  0.0f}}  // Back
+};
+
+// Adds a point on the unit sphere in the direction of the given one
+static unsigned int addUnitPosition(float* positions, int* numPositions, float x, float y, float z){
+    float length = sqrtf(x * x + y * y + z * z);
+    unsigned int p = (*numPositions)++;
+    positions[p * 3 + 0] = x / length;
+    positions[p * 3 + 1] = y / length;
+    positions[p * 3 + 2] = z / length;
+    return p;
+}
+
+// Midpoint of an edge on the sphere, created once and shared by both triangles of the edge
+static unsigned int edgeMidpoint(float* positions, int* numPositions, unsigned long long* keys, unsigned int* values,
+                                 unsigned int tableSize, unsigned int a, unsigned int b){
+    unsigned long long key = a < b ? ((unsigned long long)a << 32) | b : ((unsigned long long)b << 32) | a;
+    unsigned int slot = (unsigned int)((key * 0x9E3779B97F4A7C15ull) >> 32) & (tableSize - 1);
+    while (keys[slot] != ~0ull){
+        if (keys[slot] == key){
+            return values[slot];
+        }
+        slot = (slot + 1) & (tableSize - 1);
+    }
+
+    const float* pa = &positions[a * 3];
+    const float* pb = &positions[b * 3];
+    keys[slot] = key;
+    values[slot] = addUnitPosition(positions, numPositions, pa[0] + pb[0], pa[1] + pb[1], pa[2] + pb[2]);
+    return values[slot];
+}
+
+// Equirectangular texture coordinates of a point on the unit sphere
+static void sphereUV(const float* p, float* u, float* v){
+    *u = 0.5f + atan2f(p[0], p[2]) / (2.0f * PI);
+    *v = 0.5f + asinf(fmaxf(-1.0f, fminf(1.0f, p[1]))) / PI;
+}
+
+// Appends a vertex at a point of the unit sphere
+static unsigned int addVertex(LoadedObject* obj, const float* p, float radius, float u, float v){
+    Vertex* vertex = &obj->vertices[obj->numVertices];
+    vertex->x = p[0] * radius;
+    vertex->y = p[1] * radius;
+    vertex->z = p[2] * radius;
+    vertex->u = u;
+    vertex->v = v;
+    vertex->nx = p[0];
+    vertex->ny = p[1];
+    vertex->nz = p[2];
+    return obj->numVertices++;
+}
+
+// Generates a sphere of the given radius by subdividing an icosahedron, centered on the origin
+// 0 on failure, 1 on success
+int generateIcosphere(int subdivisions, float radius, LoadedObject* returnObject){
+    if (subdivisions < 0 || subdivisions > MAX_ICOSPHERE_SUBDIVISIONS){
+        printf("Icosphere subdivisions must be between 0 and %d, got (%d)\n", MAX_ICOSPHERE_SUBDIVISIONS, subdivisions);
+        return 0;
+    }
+    memset(returnObject, 0, sizeof(LoadedObject));
+
+    // Every subdivision splits each triangle in four
+    int numTriangles = 20 << (2 * subdivisions);
+    int maxPositions = 10 * (1 << (2 * subdivisions)) + 2;
+    float* positions = (float*)malloc(maxPositions * 3 * sizeof(float));
+    unsigned int* triangles = (unsigned int*)malloc(numTriangles * 3 * sizeof(unsigned int));
+    unsigned int* next = (unsigned int*)malloc(numTriangles * 3 * sizeof(unsigned int));
+    if (!positions || !triangles || !next){
+        printf("Failed to allocate icosphere: (%d) triangles\n", numTriangles);
+        free(positions);
+        free(triangles);
+        free(next);
+        return 0;
+    }
+
+    int numPositions = 0;
+    for (int i = 0; i < 12; i++){
+        addUnitPosition(positions, &numPositions, ICOSAHEDRON_VERTICES[i][0], ICOSAHEDRON_VERTICES[i][1], ICOSAHEDRON_VERTICES[i][2]);
+    }
+    memcpy(triangles, ICOSAHEDRON_FACES, sizeof(ICOSAHEDRON_FACES));
+    int count = 20;
+
+    // Edge midpoint table, sized for the edges of the last level
+    unsigned int tableSize = 1;
+    while (tableSize < (unsigned int)numTriangles * 3) tableSize <<= 1;
+    unsigned long long* keys = (unsigned long long*)malloc(tableSize * sizeof(unsigned long long));
+    unsigned int* values = (unsigned int*)malloc(tableSize * sizeof(unsigned int));
+    if (!keys || !values){
+        printf("Failed to allocate icosphere edge table: (%u) slots\n", tableSize);
+        free(keys);
+        free(values);
+        free(positions);
+        free(triangles);
+        free(next);
+        return 0;
+    }
+
+    for (int level = 0; level < subdivisions; level++){
+        memset(keys, 0xff, tableSize * sizeof(unsigned long long));
+        for (int t = 0; t < count; t++){
+            unsigned int a = triangles[t * 3 + 0];
+            unsigned int b = triangles[t * 3 + 1];
+            unsigned int c = triangles[t * 3 + 2];
+            unsigned int ab = edgeMidpoint(positions, &numPositions, keys, values, tableSize, a, b);
+            unsigned int bc = edgeMidpoint(positions, &numPositions, keys, values, tableSize, b, c);
+            unsigned int ca = edgeMidpoint(positions, &numPositions, keys, values, tableSize, c, a);
+
+            // Three corner triangles and the middle one, same winding
+            unsigned int* out = &next[t * 12];
+            out[0] = a;  out[1] = ab;  out[2] = ca;
+            out[3] = b;  out[4] = bc;  out[5] = ab;
+            out[6] = c;  out[7] = ca;  out[8] = bc;
+            out[9] = ab; out[10] = bc; out[11] = ca;
+        }
+        unsigned int* swap = triangles;
+        triangles = next;
+        next = swap;
+        count *= 4;
+    }
+    free(keys);
+    free(values);
+    free(next);
+
+    // At most a seam copy per position plus a pole copy per triangle
+    returnObject->vertices = (Vertex*)malloc((numPositions * 2 + numTriangles) * sizeof(Vertex));
+    returnObject->indices = triangles;
+    returnObject->numIndices = numTriangles * 3;
+
+    // One vertex per position, the seam copies are made when needed
+    unsigned int* wrapped = (unsigned int*)malloc(numPositions * sizeof(unsigned int));
+    if (!returnObject->vertices || !wrapped){
+        printf("Failed to allocate icosphere: (%d) vertices\n", numPositions * 2 + numTriangles);
+        free(wrapped);
+        free(positions);
+        freeObj(returnObject);
+        return 0;
+    }
+    memset(wrapped, 0xff, numPositions * sizeof(unsigned int));
+    for (int p = 0; p < numPositions; p++){
+        float u, v;
+        sphereUV(&positions[p * 3], &u, &v);
+        addVertex(returnObject, &positions[p * 3], radius, u, v);
+    }
+
+    for (int t = 0; t < numTriangles; t++){
+        unsigned int* tri = &triangles[t * 3];
+        float u[3];
+        int pole[3];
+        float umin = 1.0f, umax = 0.0f;
+        for (int c = 0; c < 3; c++){
+            const float* p = &positions[tri[c] * 3];
+            u[c] = returnObject->vertices[tri[c]].u;
+            pole[c] = p[0] * p[0] + p[2] * p[2] < 1e-10f;
+            if (!pole[c]){
+                umin = fminf(umin, u[c]);
+                umax = fmaxf(umax, u[c]);
+            }
+        }
+
+        // Triangles across the seam use copies on the far side of it
+        if (umax - umin > 0.5f){
+            for (int c = 0; c < 3; c++){
+                if (!pole[c] && u[c] < 0.5f){
+                    unsigned int p = tri[c];
+                    if (wrapped[p] == 0xffffffffu){
+                        wrapped[p] = addVertex(returnObject, &positions[p * 3], radius, u[c] + 1.0f, returnObject->vertices[p].v);
+                    }
+                    tri[c] = wrapped[p];
+                    u[c] += 1.0f;
+                }
+            }
+        }
+
+        // Poles have no longitude, each triangle gets a copy in the middle of its other corners
+        for (int c = 0; c < 3; c++){
+            if (pole[c]){
+                float poleU = (u[(c + 1) % 3] + u[(c + 2) % 3]) * 0.5f;
+                unsigned int p = tri[c];
+                tri[c] = addVertex(returnObject, &positions[p * 3], radius, poleU, returnObject->vertices[p].v);
+            }
+        }
+    }
+    free(wrapped);
+    free(positions);
+
+    // Cache friendly triangle order, then vertices in the order they are used
+    // Either one failing leaves a valid mesh that is only slower to draw
+    optimizeVertexCache(returnObject->indices, returnObject->numIndices, returnObject->numVertices);
+    int usedVertices = optimizeVertexFetch(returnObject->vertices, returnObject->indices,
+                                           returnObject->numIndices, returnObject->numVertices);
+    if (usedVertices > 0){
+        returnObject->numVertices = usedVertices;
+    }
+    // Trim the room left for seam and pole copies, the larger buffer is still valid if this fails
+    Vertex* trimmed = (Vertex*)realloc(returnObject->vertices, returnObject->numVertices * sizeof(Vertex));
+    if (trimmed){
+        returnObject->vertices = trimmed;
+    }
+    if (generateTangents(returnObject->vertices, returnObject->numVertices, returnObject->indices, returnObject->numIndices) == 0){
+        freeObj(returnObject);
+        return 0;
+    }
+    printf("Generated icosphere: (%d) vertices, (%d) triangles\n", returnObject->numVertices, numTriangles);
+
+    // Same detail level setup as loadObj
+    returnObject->numLods = 1;
+    returnObject->lods[0].indexOffset = 0;
+    returnObject->lods[0].numIndices = returnObject->numIndices;
+    returnObject->lods[0].error = 0.0f;
+
+    // One submesh without a material
+    returnObject->numSubmeshes = 1;
+    returnObject->lods[0].submeshIndices[0] = returnObject->numIndices;
+    computeBounds(returnObject->vertices, returnObject->numVertices, sizeof(Vertex), &returnObject->bounds);
+
+    return 1;
+}
+
+// Generates an axis aligned cube with the given edge length, centered on the origin
+// 0 on failure, 1 on success
+int generateCube(float size, LoadedObject* returnObject){
+    memset(returnObject, 0, sizeof(LoadedObject));
+    returnObject->vertices = (Vertex*)malloc(24 * sizeof(Vertex));
+    returnObject->indices = (unsigned int*)malloc(36 * sizeof(unsigned int));
+    if (!returnObject->vertices || !returnObject->indices){
+        printf("Failed to allocate cube\n");
+        freeObj(returnObject);
+        return 0;
+    }
+
+    // Corners of a face in UV order, counter clockwise seen from outside
+    const float corners[4][2] = {{0.0f, 0.0f}, {1.0f, 0.0f}, {1.0f, 1.0f}, {0.0f, 1.0f}};
+    float half = size * 0.5f;
+
+    for (int f = 0; f < 6; f++){
+        const float* n = CUBE_FACES[f][0];
+        const float* s = CUBE_FACES[f][1];
+        const float* t = CUBE_FACES[f][2];
+
+        for (int c = 0; c < 4; c++){
+            // Offset from the face center along U and V
+            float ds = corners[c][0] * 2.0f - 1.0f;
+            float dt = corners[c][1] * 2.0f - 1.0f;
+
+            Vertex* vertex = &returnObject->vertices[f * 4 + c];
+            vertex->x = (n[0] + s[0] * ds + t[0] * dt) * half;
+            vertex->y = (n[1] + s[1] * ds + t[1] * dt) * half;
+            vertex->z = (n[2] + s[2] * ds + t[2] * dt) * half;
+            vertex->u = corners[c][0];
+            vertex->v = corners[c][1];
+            vertex->nx = n[0];
+            vertex->ny = n[1];
+            vertex->nz = n[2];
+        }
+
+        // Two triangles per face
+        unsigned int* tri = &returnObject->indices[f * 6];
+        unsigned int base = f * 4;
+        tri[0] = base + 0; tri[1] = base + 1; tri[2] = base + 2;
+        tri[3] = base + 0; tri[4] = base + 2; tri[5] = base + 3;
+    }
+    returnObject->numVertices = 24;
+    returnObject->numIndices = 36;
+    if (generateTangents(returnObject->vertices, 24, returnObject->indices, 36) == 0){
+        freeObj(returnObject);
+        return 0;
+    }
+
+    // Same detail level setup as loadObj
+    returnObject->numLods = 1;
+    returnObject->lods[0].indexOffset = 0;
+    returnObject->lods[0].numIndices = 36;
+    returnObject->lods[0].error = 0.0f;
+    returnObject->numSubmeshes = 1;
+    returnObject->lods[0].submeshIndices[0] = 36;
+    computeBounds(returnObject->vertices, returnObject->numVertices, sizeof(Vertex), &returnObject->bounds);
+
+    return 1;
+}
\ No newline at end of file
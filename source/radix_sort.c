@@ -0,0 +1,126 @@
+#include "../include/radix_sort.h"
+#include <string.h>
+
+// Sorts values by their 32 bit keys, least significant byte first
+void radixSort32(uint32_t* keys, uint32_t* values, int count, uint32_t* tempKeys, uint32_t* tempValues){
+    if (count <= 1){
+        return;
+    }
+
+    // Every histogram in one read of the keys
+    uint32_t histograms[4][256];
+    memset(histograms, 0, sizeof(histograms));
+    for (int i = 0; i < count; i++){
+        uint32_t key = keys[i];
+        histograms[0][key & 0xFF]++;
+        histograms[1][(key >> 8) & 0xFF]++;
+        histograms[2][(key >> 16) & 0xFF]++;
+        histograms[3][key >> 24]++;
+    }
+
+    uint32_t* srcKeys = keys;
+    uint32_t* srcValues = values;
+    uint32_t* destKeys = tempKeys;
+    uint32_t* destValues = tempValues;
+    for (int pass = 0; pass < 4; pass++){
+        uint32_t* histogram = histograms[pass];
+        int shift = pass * 8;
+
+        // Nothing moves when every key has the same byte here
+        if (histogram[(srcKeys[0] >> shift) & 0xFF] == (uint32_t)count){
+            continue;
+        }
+
+        // Start of each bucket
+        uint32_t offset = 0;
+        for (int b = 0; b < 256; b++){
+            uint32_t size = histogram[b];
+            histogram[b] = offset;
+            offset += size;
+        }
+
+        for (int i = 0; i < count; i++){
+            uint32_t key = srcKeys[i];
+            uint32_t slot = histogram[(key >> shift) & 0xFF]++;
+            destKeys[slot] = key;
+            destValues[slot] = srcValues[i];
+        }
+
+        // The destination is the source of the next pass
+        uint32_t* swapKeys = srcKeys;
+        uint32_t* swapValues = srcValues;
+        srcKeys = destKeys;
+        srcValues = destValues;
+        destKeys = swapKeys;
+        destValues = swapValues;
+    }
+
+    // An odd number of passes leaves the result in the temporary arrays
+    if (srcKeys != keys){
+        memcpy(keys, srcKeys, count * sizeof(uint32_t));
+        memcpy(values, srcValues, count * sizeof(uint32_t));
+    }
+}
+
+// Sorts values by their 64 bit keys, least significant byte first
+// Draw keys leave most of their high bytes equal within a frame, those passes are skipped
+void radixSort64(uint64_t* keys, uint32_t* values, int count, uint64_t* tempKeys, uint32_t* tempValues){
+    if (count <= 1){
+        return;
+    }
+
+    uint32_t histograms[8][256];
+    memset(histograms, 0, sizeof(histograms));
+    for (int i = 0; i < count; i++){
+        uint64_t key = keys[i];
+        for (int pass = 0; pass < 8; pass++){
+            histograms[pass][(key >> (pass * 8)) & 0xFF]++;
+        }
+    }
+
+    uint64_t* srcKeys = keys;
+    uint32_t* srcValues = values;
+    uint64_t* destKeys = tempKeys;
+    uint32_t* destValues = tempValues;
+    for (int pass = 0; pass < 8; pass++){
+        uint32_t* histogram = histograms[pass];
+        int shift = pass * 8;
+        if (histogram[(srcKeys[0] >> shift) & 0xFF] == (uint32_t)count){
+            continue;
+        }
+
+        uint32_t offset = 0;
+        for (int b = 0; b < 256; b++){
+            uint32_t size = histogram[b];
+            histogram[b] = offset;
+            offset += size;
+        }
+
+        for (int i = 0; i < count; i++){
+            uint64_t key = srcKeys[i];
+            uint32_t slot = histogram[(key >> shift) & 0xFF]++;
+            destKeys[slot] = key;
+            destValues[slot] = srcValues[i];
+        }
+
+        uint64_t* swapKeys = srcKeys;
+        uint32_t* swapValues = srcValues;
+        srcKeys = destKeys;
+        srcValues = destValues;
+        destKeys = swapKeys;
+        destValues = swapValues;
+    }
+
+    if (srcKeys != keys){
+        memcpy(keys, srcKeys, count * sizeof(uint64_t));
+        memcpy(values, srcValues, count * sizeof(uint32_t));
+    }
+}
+
+// Key of a float that sorts like the float itself
+// Positive floats sort like their bits once the sign is set, negative ones need every bit flipped
+uint32_t floatSortKey(float value){
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+}
\ No newline at end of file
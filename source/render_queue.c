@@ -0,0 +1,170 @@
+#include "../include/render_queue.h"
+#include "../include/radix_sort.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Reallocates every array to the given capacity
+// Arrays that did grow are kept on failure, the capacity stays that of the smallest
+static int growRenderQueue(RenderQueue* queue, int capacity){
+    DrawCommand* commands = (DrawCommand*)realloc(queue->commands, capacity * sizeof(DrawCommand));
+    if (commands) queue->commands = commands;
+    uint64_t* keys = (uint64_t*)realloc(queue->keys, capacity * sizeof(uint64_t));
+    if (keys) queue->keys = keys;
+    uint32_t* order = (uint32_t*)realloc(queue->order, capacity * sizeof(uint32_t));
+    if (order) queue->order = order;
+
+    if (!commands || !keys || !order){
+        printf("Failed to allocate memory for render queue: (%d draws)\n", capacity);
+        return 0;
+    }
+    queue->capacity = capacity;
+    return 1;
+}
+
+// Allocates room for the given amount of draws
+int initRenderQueue(RenderQueue* queue, int capacity, float farPlane){
+    memset(queue, 0, sizeof(RenderQueue));
+    queue->depthScale = (float)(1 << DRAW_DEPTH_BITS) / farPlane;
+    for (int i = 0; i < MAX_QUEUE_PROGRAMS; i++){
+        queue->programs[i].material = -1;
+        queue->programs[i].flag = -1;
+    }
+
+    if (capacity < 1) capacity = 1;
+    if (growRenderQueue(queue, capacity) == 0){
+        freeRenderQueue(queue);
+        return 0;
+    }
+    return 1;
+}
+
+// Sets the order of a pass
+void setRenderPassOrder(RenderQueue* queue, int pass, int depthFirst){
+    queue->depthFirst[pass] = depthFirst;
+}
+
+// Sets the program of a slot, the uniforms of a new program start out unknown
+void setRenderQueueProgram(RenderQueue* queue, int slot, GLuint program, GLint materialLoc, GLint flagLoc){
+    QueueProgram* entry = &queue->programs[slot];
+    entry->program = program;
+    entry->materialLoc = materialLoc;
+    entry->flagLoc = flagLoc;
+    entry->material = -1;
+    entry->flag = -1;
+}
+
+// Empties the queue, the storage is kept for the next frame
+void resetRenderQueue(RenderQueue* queue){
+    queue->count = 0;
+    queue->draws = 0;
+    queue->instances = 0;
+    queue->stateChanges = 0;
+}
+
+// Builds the key of a draw, equal keys keep their submission order
+static uint64_t makeDrawKey(const RenderQueue* queue, int pass, const DrawCommand* command, float depth){
+    float scaled = depth * queue->depthScale;
+    uint64_t maxDepth = (1u << DRAW_DEPTH_BITS) - 1;
+    uint64_t depthBits = scaled <= 0.0f ? 0 : scaled >= (float)maxDepth ? maxDepth : (uint64_t)scaled;
+    uint64_t state = ((uint64_t)command->program << 16) | ((uint64_t)command->material << 8) | (uint64_t)command->meshId;
+
+    // Pass, then 60 bits of depth and state in the pass's order
+    uint64_t key = (uint64_t)pass << 60;
+    if (queue->depthFirst[pass]){
+        key |= (depthBits << 22) | state;
+    }
+    else {
+        key |= (state << DRAW_DEPTH_BITS) | depthBits;
+    }
+    return key;
+}
+
+// Adds a draw to a pass, doubling the storage when it is full
+int submitDraw(RenderQueue* queue, int pass, const DrawCommand* command, float depth){
+    if (queue->count == queue->capacity && growRenderQueue(queue, queue->capacity * 2) == 0){
+        return 0;
+    }
+    int index = queue->count++;
+    queue->commands[index] = *command;
+    queue->keys[index] = makeDrawKey(queue, pass, command, depth);
+    queue->order[index] = index;
+    return 1;
+}
+
+// Sorts the draws and finds where each pass starts, passes without draws get an empty range
+// The sort's second buffers only live until it returns, so they come from the frame arena
+int sortRenderQueue(RenderQueue* queue, Arena* scratch){
+    uint64_t* tempKeys = (uint64_t*)arenaAlloc(scratch, queue->count * sizeof(uint64_t));
+    uint32_t* tempOrder = (uint32_t*)arenaAlloc(scratch, queue->count * sizeof(uint32_t));
+    if (!tempKeys || !tempOrder){
+        // Every pass left empty rather than drawn out of order
+        for (int pass = 0; pass <= MAX_RENDER_PASSES; pass++){
+            queue->passStart[pass] = 0;
+        }
+        return 0;
+    }
+    radixSort64(queue->keys, queue->order, queue->count, tempKeys, tempOrder);
+
+    int index = 0;
+    for (int pass = 0; pass <= MAX_RENDER_PASSES; pass++){
+        while (index < queue->count && (int)(queue->keys[index] >> 60) < pass){
+            index++;
+        }
+        queue->passStart[pass] = index;
+    }
+    return 1;
+}
+
+// Issues the draws of a pass, the program and instance range are bound again at its start
+// since other passes and the lighting in between use programs and VAOs of their own
+void executeRenderPass(RenderQueue* queue, int pass){
+    int boundProgram = -1;
+    const CullBatch* boundBatch = NULL;
+    int boundLod = -1;
+
+    for (int i = queue->passStart[pass]; i < queue->passStart[pass + 1]; i++){
+        DrawCommand* command = &queue->commands[queue->order[i]];
+        QueueProgram* program = &queue->programs[command->program];
+
+        if (command->program != boundProgram){
+            glUseProgram(program->program);
+            boundProgram = command->program;
+            queue->stateChanges++;
+        }
+        if (command->material != program->material){
+            glUniform1i(program->materialLoc, command->material);
+            program->material = command->material;
+            queue->stateChanges++;
+        }
+        if (command->isPlanet != program->flag){
+            glUniform1i(program->flagLoc, command->isPlanet);
+            program->flag = command->isPlanet;
+            queue->stateChanges++;
+        }
+        if (command->batch != boundBatch || command->lod != boundLod){
+            bindCullBatchLod(command->batch, command->lod);
+            boundBatch = command->batch;
+            boundLod = command->lod;
+            queue->stateChanges++;
+        }
+
+        int instanceCount = command->batch->lodVisible[command->lod];
+        if (command->submesh < 0){
+            drawMeshInstanced(command->mesh, command->lod, instanceCount);
+        }
+        else {
+            drawSubmeshInstanced(command->mesh, command->lod, command->submesh, instanceCount);
+        }
+        queue->draws++;
+        queue->instances += instanceCount;
+    }
+}
+
+// Frees the arrays
+void freeRenderQueue(RenderQueue* queue){
+    free(queue->commands);
+    free(queue->keys);
+    free(queue->order);
+    memset(queue, 0, sizeof(RenderQueue));
+}
\ No newline at end of file
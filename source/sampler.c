@@ -0,0 +1,70 @@
+#include "../include/sampler.h"
+#include <GLFW/glfw3.h>
+#include <stdio.h>
+#include <string.h>
+
+// Sampling state of one class at one quality
+typedef struct {
+    GLenum minFilter;
+    float anisotropy;
+    float lodBias;
+} SamplerPreset;
+
+// Height maps keep a zero bias and less anisotropy, color gets the sharpest filtering of each preset
+static const SamplerPreset presets[SAMPLER_QUALITIES][SAMPLER_CLASSES] = {
+    { { GL_LINEAR_MIPMAP_NEAREST, 1.0f, 0.5f }, { GL_LINEAR_MIPMAP_NEAREST, 1.0f, 0.0f } },
+    { { GL_LINEAR_MIPMAP_LINEAR, 4.0f, 0.0f }, { GL_LINEAR_MIPMAP_LINEAR, 1.0f, 0.0f } },
+    { { GL_LINEAR_MIPMAP_LINEAR, 16.0f, -0.25f }, { GL_LINEAR_MIPMAP_LINEAR, 4.0f, 0.0f } },
+};
+
+// Makes the samplers of every preset
+void initSamplerSet(SamplerSet* set, SamplerQuality quality){
+    memset(set, 0, sizeof(SamplerSet));
+    set->quality = quality;
+
+    set->maxAnisotropy = 1.0f;
+    if (glfwExtensionSupported("GL_EXT_texture_filter_anisotropic") || glfwExtensionSupported("GL_ARB_texture_filter_anisotropic")){
+        glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &set->maxAnisotropy);
+    }
+
+    glGenSamplers(SAMPLER_QUALITIES * SAMPLER_CLASSES, &set->samplers[0][0]);
+    for (int q = 0; q < SAMPLER_QUALITIES; q++){
+        for (int c = 0; c < SAMPLER_CLASSES; c++){
+            const SamplerPreset* preset = &presets[q][c];
+            GLuint sampler = set->samplers[q][c];
+            glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, preset->minFilter);
+            glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glSamplerParameterf(sampler, GL_TEXTURE_LOD_BIAS, preset->lodBias);
+            if (set->maxAnisotropy > 1.0f){
+                float anisotropy = preset->anisotropy < set->maxAnisotropy ? preset->anisotropy : set->maxAnisotropy;
+                glSamplerParameterf(sampler, GL_TEXTURE_MAX_ANISOTROPY_EXT, anisotropy);
+            }
+        }
+    }
+    printf("Samplers: (%s), up to (%.0fx) anisotropy\n", samplerQualityName(quality), set->maxAnisotropy);
+}
+
+// Sampler of a class at the current quality
+GLuint getSampler(const SamplerSet* set, SamplerClass samplerClass){
+    return set->samplers[set->quality][samplerClass];
+}
+
+// Name of a quality
+const char* samplerQualityName(SamplerQuality quality){
+    switch (quality){
+        case SAMPLER_LOW: return "low";
+        case SAMPLER_MEDIUM: return "medium";
+        case SAMPLER_HIGH: return "high";
+        default: return "unknown";
+    }
+}
+
+// Deletes the samplers
+void freeSamplerSet(SamplerSet* set){
+    if (set->samplers[0][0]){
+        glDeleteSamplers(SAMPLER_QUALITIES * SAMPLER_CLASSES, &set->samplers[0][0]);
+    }
+    memset(set, 0, sizeof(SamplerSet));
+}
\ No newline at end of file
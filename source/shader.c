@@ -56,9 +56,37 @@ GLuint compileShader(const char* source, GLenum shaderType){
 }
 
 
+// Puts the defines right after the #version line, which has to stay first
+// Frees the code and returns the new string
+char* insertDefines(char* code, const char* defines){
+    if (!defines || !defines[0]){
+        return code;
+    }
+    char* lineEnd = strchr(code, '\n');
+    int versionLength = lineEnd ? (int)(lineEnd - code) + 1 : 0;
+
+    // #line keeps compiler errors pointing at the lines of the file
+    const char* lineDirective = "#line 2\n";
+    char* result = (char*)malloc(strlen(code) + strlen(defines) + strlen(lineDirective) + 2);
+    sprintf(result, "%.*s%s\n%s%s", versionLength, code, defines, lineDirective, code + versionLength);
+    free(code);
+    return result;
+}
+
+
 // Load and compile vertex and fragment shaders from given file paths
 GLuint loadShaders(const char* vertex_file_path, const char* fragment_file_path){
-    printf("Loading Shaders: S:(%s) | F:(%s)\n", vertex_file_path, fragment_file_path);
+    return loadShaderVariant(vertex_file_path, fragment_file_path, NULL);
+}
+
+
+// Load and compile vertex and fragment shaders, with #define lines added to both
+GLuint loadShaderVariant(const char* vertex_file_path, const char* fragment_file_path, const char* defines){
+    printf("Loading Shaders: S:(%s) | F:(%s)", vertex_file_path, fragment_file_path);
+    if (defines && defines[0]){
+        printf(" | D:(%s)", defines);
+    }
+    printf("\n");
 
     // Read vertex and fragment shader code from files
     char* vertexShaderCode = readFile(vertex_file_path);
@@ -71,6 +99,8 @@ GLuint loadShaders(const char* vertex_file_path, const char* fragment_file_path)
         free(vertexShaderCode);
         return 0;
     }
+    vertexShaderCode = insertDefines(vertexShaderCode, defines);
+    fragmentShaderCode = insertDefines(fragmentShaderCode, defines);
 
     // Compile the shaders
     GLuint vertexShader = compileShader(vertexShaderCode, GL_VERTEX_SHADER);
@@ -79,6 +109,11 @@ GLuint loadShaders(const char* vertex_file_path, const char* fragment_file_path)
     // Free the shader code strings
     free(vertexShaderCode);
     free(fragmentShaderCode);
+    if (!vertexShader || !fragmentShader){
+        if (vertexShader) glDeleteShader(vertexShader);
+        if (fragmentShader) glDeleteShader(fragmentShader);
+        return 0;
+    }
 
     // Link the shaders with a program
     GLuint programID = glCreateProgram();
@@ -93,6 +128,9 @@ GLuint loadShaders(const char* vertex_file_path, const char* fragment_file_path)
         char infoLog[1024];
         glGetProgramInfoLog(programID, 1024, NULL, infoLog);
         printf("Linking failed: (%s)\n", infoLog);
+        glDeleteShader(vertexShader);
+        glDeleteShader(fragmentShader);
+        glDeleteProgram(programID);
         return 0;
     }
 
@@ -100,5 +138,64 @@ GLuint loadShaders(const char* vertex_file_path, const char* fragment_file_path)
     glDeleteShader(vertexShader);
     glDeleteShader(fragmentShader);
 
+    return programID;
+}
+
+
+// Load and compile a program whose outputs are captured with transform feedback
+GLuint loadFeedbackShader(const char* vertex_file_path, const char* geometry_file_path, const char** varyings, int varyingCount){
+    printf("Loading Feedback Shader: S:(%s) | G:(%s)\n", vertex_file_path, geometry_file_path ? geometry_file_path : "none");
+
+    // Read and compile the vertex shader
+    char* vertexShaderCode = readFile(vertex_file_path);
+    if (!vertexShaderCode){
+        return 0;
+    }
+    GLuint vertexShader = compileShader(vertexShaderCode, GL_VERTEX_SHADER);
+    free(vertexShaderCode);
+    if (!vertexShader){
+        return 0;
+    }
+
+    // Read and compile the optional geometry shader
+    GLuint geometryShader = 0;
+    if (geometry_file_path){
+        char* geometryShaderCode = readFile(geometry_file_path);
+        if (!geometryShaderCode){
+            glDeleteShader(vertexShader);
+            return 0;
+        }
+        geometryShader = compileShader(geometryShaderCode, GL_GEOMETRY_SHADER);
+        free(geometryShaderCode);
+        if (!geometryShader){
+            glDeleteShader(vertexShader);
+            return 0;
+        }
+    }
+
+    // The captured outputs must be declared before linking
+    GLuint programID = glCreateProgram();
+    glAttachShader(programID, vertexShader);
+    if (geometryShader){
+        glAttachShader(programID, geometryShader);
+    }
+    glTransformFeedbackVaryings(programID, varyingCount, varyings, GL_INTERLEAVED_ATTRIBS);
+    glLinkProgram(programID);
+    glDeleteShader(vertexShader);
+    if (geometryShader){
+        glDeleteShader(geometryShader);
+    }
+
+    // Check linking status
+    GLint success;
+    glGetProgramiv(programID, GL_LINK_STATUS, &success);
+    if (!success) {
+        char infoLog[1024];
+        glGetProgramInfoLog(programID, 1024, NULL, infoLog);
+        printf("Linking failed: (%s)\n", infoLog);
+        glDeleteProgram(programID);
+        return 0;
+    }
+
     return programID;
 }
\ No newline at end of file
@@ -0,0 +1,179 @@
+#include "../include/shader_reload.h"
+#include "../include/shader.h"
+#include <stdio.h>
+#include <string.h>
+
+// Builds every variant, all or nothing
+// 0 on failure, 1 on success
+static int buildVariants(const ShaderReloader* reloader, GLuint* programs){
+    for (int i = 0; i < reloader->numVariants; i++){
+        programs[i] = loadShaderVariant(reloader->vertexPath, reloader->fragmentPath, reloader->defines[i]);
+        if (programs[i] == 0){
+            for (int j = 0; j < i; j++){
+                glDeleteProgram(programs[j]);
+            }
+            printf("Shader reload failed, keeping the current programs\n");
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Deletes the current programs and takes the new ones
+static void swapPrograms(ShaderReloader* reloader, GLuint* programs){
+    for (int i = 0; i < reloader->numVariants; i++){
+        glDeleteProgram(reloader->programs[i]);
+        reloader->programs[i] = programs[i];
+        programs[i] = 0;
+    }
+}
+
+// Waits for change requests and builds the programs in its own context
+static void* reloadWorker(void* arg){
+    ShaderReloader* reloader = (ShaderReloader*)arg;
+    glfwMakeContextCurrent(reloader->workerContext);
+
+    pthread_mutex_lock(&reloader->lock);
+    while (!reloader->quit){
+        if (!reloader->requested){
+            pthread_cond_wait(&reloader->wake, &reloader->lock);
+            continue;
+        }
+        reloader->requested = 0;
+        pthread_mutex_unlock(&reloader->lock);
+
+        // Compile and link while the drawing thread keeps going
+        GLuint programs[MAX_SHADER_VARIANTS];
+        int success = buildVariants(reloader, programs);
+        GLsync fence = 0;
+        if (success){
+            // The main context may only use the programs once this context's commands are done
+            fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            glFlush();
+        }
+
+        pthread_mutex_lock(&reloader->lock);
+        if (success){
+            // A newer build replaces one that was never picked up
+            if (reloader->pendingFence){
+                for (int i = 0; i < reloader->numVariants; i++){
+                    glDeleteProgram(reloader->pending[i]);
+                }
+                glDeleteSync(reloader->pendingFence);
+            }
+            memcpy(reloader->pending, programs, sizeof(programs));
+            reloader->pendingFence = fence;
+        }
+    }
+    pthread_mutex_unlock(&reloader->lock);
+
+    glfwMakeContextCurrent(NULL);
+    return NULL;
+}
+
+// Starts watching the files of already loaded programs
+int initShaderReloader(ShaderReloader* reloader, GLFWwindow* workerContext, const char* vertex_file_path, const char* fragment_file_path,
+                       const char* const* defines, const GLuint* programs, int numVariants){
+    memset(reloader, 0, sizeof(ShaderReloader));
+    if (numVariants > MAX_SHADER_VARIANTS) numVariants = MAX_SHADER_VARIANTS;
+    reloader->vertexPath = vertex_file_path;
+    reloader->fragmentPath = fragment_file_path;
+    reloader->numVariants = numVariants;
+    for (int i = 0; i < numVariants; i++){
+        reloader->defines[i] = defines[i];
+        reloader->programs[i] = programs[i];
+    }
+
+    if (initFileWatcher(&reloader->watcher) == 0 ||
+        watchFile(&reloader->watcher, vertex_file_path) < 0 ||
+        watchFile(&reloader->watcher, fragment_file_path) < 0){
+        printf("Failed to watch shaders: S:(%s) | F:(%s)\n", vertex_file_path, fragment_file_path);
+        freeFileWatcher(&reloader->watcher);
+        return 0;
+    }
+
+    // Hidden window whose context shares programs with the drawing one, windows can only be created on the main thread
+    reloader->workerContext = workerContext;
+    if (reloader->workerContext == NULL){
+        printf("No shared context, shaders reload between frames\n");
+        return 1;
+    }
+
+    pthread_mutex_init(&reloader->lock, NULL);
+    pthread_cond_init(&reloader->wake, NULL);
+    if (pthread_create(&reloader->worker, NULL, reloadWorker, reloader) != 0){
+        printf("Failed to start shader worker, shaders reload between frames\n");
+        pthread_mutex_destroy(&reloader->lock);
+        pthread_cond_destroy(&reloader->wake);
+        reloader->workerContext = NULL;
+    }
+    return 1;
+}
+
+// Call once per frame on the drawing thread, never waits on the compiler
+int updateShaderReloader(ShaderReloader* reloader){
+    int changed[MAX_WATCHED_FILES];
+    int numChanged = pollFileChanges(&reloader->watcher, changed, MAX_WATCHED_FILES);
+
+    // Deferred path, rebuild here and swap right away
+    if (reloader->workerContext == NULL){
+        GLuint programs[MAX_SHADER_VARIANTS];
+        if (numChanged == 0 || buildVariants(reloader, programs) == 0){
+            return 0;
+        }
+        swapPrograms(reloader, programs);
+        printf("Shaders reloaded\n");
+        return 1;
+    }
+
+    pthread_mutex_lock(&reloader->lock);
+    if (numChanged > 0){
+        reloader->requested = 1;
+        pthread_cond_signal(&reloader->wake);
+    }
+
+    // Swap only once the worker's commands have reached the GPU, polling without a timeout
+    int swapped = 0;
+    if (reloader->pendingFence){
+        GLenum status = glClientWaitSync(reloader->pendingFence, 0, 0);
+        if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED){
+            glDeleteSync(reloader->pendingFence);
+            reloader->pendingFence = 0;
+            swapPrograms(reloader, reloader->pending);
+            swapped = 1;
+        }
+    }
+    pthread_mutex_unlock(&reloader->lock);
+
+    if (swapped){
+        printf("Shaders reloaded\n");
+    }
+    return swapped;
+}
+
+// Stops the worker and deletes the programs
+void freeShaderReloader(ShaderReloader* reloader){
+    if (reloader->workerContext){
+        pthread_mutex_lock(&reloader->lock);
+        reloader->quit = 1;
+        pthread_cond_signal(&reloader->wake);
+        pthread_mutex_unlock(&reloader->lock);
+        pthread_join(reloader->worker, NULL);
+
+        if (reloader->pendingFence){
+            for (int i = 0; i < reloader->numVariants; i++){
+                glDeleteProgram(reloader->pending[i]);
+            }
+            glDeleteSync(reloader->pendingFence);
+        }
+        pthread_mutex_destroy(&reloader->lock);
+        pthread_cond_destroy(&reloader->wake);
+    }
+    for (int i = 0; i < reloader->numVariants; i++){
+        if (reloader->programs[i]){
+            glDeleteProgram(reloader->programs[i]);
+        }
+    }
+    freeFileWatcher(&reloader->watcher);
+    memset(reloader, 0, sizeof(ShaderReloader));
+}
\ No newline at end of file
@@ -0,0 +1,206 @@
+#include "../include/shadow.h"
+#include "../include/shader.h"
+#include "../include/culling.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Direction and up vector of each face, in the order of GL_TEXTURE_CUBE_MAP_POSITIVE_X onwards
+static const float faceDirections[SHADOW_FACES][3] = {
+    { 1.0f,  0.0f,  0.0f}, {-1.0f,  0.0f,  0.0f},
+    { 0.0f,  1.0f,  0.0f}, { 0.0f, -1.0f,  0.0f},
+    { 0.0f,  0.0f,  1.0f}, { 0.0f,  0.0f, -1.0f}
+};
+static const float faceUps[SHADOW_FACES][3] = {
+    { 0.0f, -1.0f,  0.0f}, { 0.0f, -1.0f,  0.0f},
+    { 0.0f,  0.0f,  1.0f}, { 0.0f,  0.0f, -1.0f},
+    { 0.0f, -1.0f,  0.0f}, { 0.0f, -1.0f,  0.0f}
+};
+
+// FNV-1a over 32 bit words, the same positions give the same signature
+static uint64_t hashWord(uint64_t hash, const void* word){
+    uint32_t value;
+    memcpy(&value, word, sizeof(value));
+    for (int i = 0; i < 4; i++){
+        hash ^= (value >> (i * 8)) & 0xFF;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Creates the cube map and loads the shadow program
+int initShadowMap(ShadowMap* shadow, int size, float range, int lightBody, int firstCaster, int numCasters,
+                  float casterRadius, int matrixUnit){
+    memset(shadow, 0, sizeof(ShadowMap));
+    shadow->size = size;
+    shadow->range = range;
+    shadow->lightBody = lightBody;
+    shadow->firstCaster = firstCaster;
+    shadow->numCasters = numCasters;
+    shadow->casterRadius = casterRadius;
+
+    shadow->indices = (GLuint*)malloc((numCasters > 0 ? numCasters : 1) * SHADOW_FACES * sizeof(GLuint));
+    if (!shadow->indices){
+        printf("Failed to allocate memory for shadow casters\n");
+        return 0;
+    }
+
+    // Compared in hardware, linear filtering blends four comparisons
+    glGenTextures(1, &shadow->texture);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, shadow->texture);
+    for (int face = 0; face < SHADOW_FACES; face++){
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_DEPTH_COMPONENT24, size, size, 0,
+                     GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+    }
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+    // Filtering across face edges, without it the seams show in the penumbra
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+    // Depth only, a face is attached before it is drawn
+    glGenFramebuffers(1, &shadow->framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, shadow->framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X, shadow->texture, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (status != GL_FRAMEBUFFER_COMPLETE){
+        printf("Failed to create shadow map: (%d) (0x%x)\n", size, status);
+        freeShadowMap(shadow);
+        return 0;
+    }
+
+    shadow->program = loadShaders("shaders/shadow.glsl", "shaders/shadow_fragment.glsl");
+    if (shadow->program == 0){
+        printf("Failed to load shadow shaders\n");
+        freeShadowMap(shadow);
+        return 0;
+    }
+    glUseProgram(shadow->program);
+    glUniform1i(glGetUniformLocation(shadow->program, "bodyMatrices"), matrixUnit);
+    glUniform1f(glGetUniformLocation(shadow->program, "lightRange"), range);
+    shadow->faceViewProjectionLoc = glGetUniformLocation(shadow->program, "faceViewProjection");
+    shadow->lightPosLoc = glGetUniformLocation(shadow->program, "lightPos");
+
+    glGenBuffers(1, &shadow->indexVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, shadow->indexVBO);
+    glBufferData(GL_ARRAY_BUFFER, (numCasters > 0 ? numCasters : 1) * SHADOW_FACES * sizeof(GLuint), NULL, GL_DYNAMIC_DRAW);
+
+    printf("Shadow map: (%d x %d) per face, (%d) casters\n", size, size, numCasters);
+    return 1;
+}
+
+// Sets the shadow uniforms of the scene program
+void setShadowUniforms(const ShadowMap* shadow, GLuint program, int unit, int light){
+    glUseProgram(program);
+    // Set even without shadows, samplers of different types may not share unit 0
+    glUniform1i(glGetUniformLocation(program, "shadowMap"), unit);
+    glUniform1i(glGetUniformLocation(program, "shadowLight"), shadow->texture ? light : -1);
+
+    // Range, and the size of a texel one unit away from the light, which scales the normal offset
+    float params[2] = {shadow->range, shadow->size > 0 ? 2.0f / shadow->size : 0.0f};
+    glUniform2fv(glGetUniformLocation(program, "shadowParams"), 1, params);
+}
+
+// Culls the casters of every face and draws the faces whose contents changed
+void updateShadowMap(ShadowMap* shadow, const OrbitSystem* orbits, float time, GLuint vao, const MeshRange* casterMesh){
+    vec3 lightPos = {orbits->posX[shadow->lightBody], orbits->posY[shadow->lightBody], orbits->posZ[shadow->lightBody]};
+    mat4 projection;
+    glm_perspective(glm_rad(90.0f), 1.0f, SHADOW_NEAR, shadow->range, projection);
+
+    int bound = 0;
+    for (int face = 0; face < SHADOW_FACES; face++){
+        vec3 center, up;
+        glm_vec3_add(lightPos, (float*)faceDirections[face], center);
+        glm_vec3_copy((float*)faceUps[face], up);
+        mat4 view, viewProjection;
+        glm_lookat(lightPos, center, up, view);
+        glm_mat4_mul(projection, view, viewProjection);
+        Frustum frustum;
+        extractFrustum(viewProjection, &frustum);
+
+        // Casters inside the face, and a signature of where the light and each of them are
+        GLuint* indices = shadow->indices + (size_t)face * shadow->numCasters;
+        int count = 0;
+        uint64_t signature = 14695981039346656037ull;
+        for (int j = 0; j < 3; j++){
+            signature = hashWord(signature, &lightPos[j]);
+        }
+        for (int i = 0; i < shadow->numCasters; i++){
+            int body = shadow->firstCaster + i;
+            vec3 pos = {orbits->posX[body], orbits->posY[body], orbits->posZ[body]};
+            int inside = 1;
+            for (int p = 0; p < 6 && inside; p++){
+                inside = glm_vec3_dot(frustum.planes[p], pos) + frustum.planes[p][3] >= -shadow->casterRadius;
+            }
+            if (!inside){
+                continue;
+            }
+            indices[count++] = body;
+
+            // Casters spin as well as orbit, the angle is part of where they are
+            float angle = time * orbits->spin[body];
+            signature = hashWord(signature, &body);
+            signature = hashWord(signature, &pos[0]);
+            signature = hashWord(signature, &pos[1]);
+            signature = hashWord(signature, &pos[2]);
+            signature = hashWord(signature, &angle);
+        }
+
+        // Kept as it is when nothing in it moved, an empty face stays empty wherever the light goes
+        if (shadow->faceValid[face] && shadow->faceCasters[face] == count &&
+            (count == 0 || shadow->faceSignature[face] == signature)){
+            shadow->facesReused++;
+            continue;
+        }
+        shadow->faceValid[face] = 1;
+        shadow->faceCasters[face] = count;
+        shadow->faceSignature[face] = signature;
+        shadow->facesDrawn++;
+
+        if (!bound){
+            glBindFramebuffer(GL_FRAMEBUFFER, shadow->framebuffer);
+            glViewport(0, 0, shadow->size, shadow->size);
+            glUseProgram(shadow->program);
+            glUniform3fv(shadow->lightPosLoc, 1, lightPos);
+            glBindVertexArray(vao);
+            glBindBuffer(GL_ARRAY_BUFFER, shadow->indexVBO);
+            bound = 1;
+        }
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, shadow->texture, 0);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        if (count == 0){
+            continue;
+        }
+
+        size_t offset = (size_t)face * shadow->numCasters * sizeof(GLuint);
+        glBufferSubData(GL_ARRAY_BUFFER, offset, count * sizeof(GLuint), indices);
+        glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)offset);
+        glUniformMatrix4fv(shadow->faceViewProjectionLoc, 1, GL_FALSE, (float*)viewProjection);
+        drawMeshInstanced(casterMesh, 0, count);
+    }
+
+    if (bound){
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+}
+
+// Frees the cube map and the program
+void freeShadowMap(ShadowMap* shadow){
+    free(shadow->indices);
+    if (shadow->program) glDeleteProgram(shadow->program);
+    if (shadow->framebuffer) glDeleteFramebuffers(1, &shadow->framebuffer);
+    if (shadow->texture) glDeleteTextures(1, &shadow->texture);
+    if (shadow->indexVBO) glDeleteBuffers(1, &shadow->indexVBO);
+    memset(shadow, 0, sizeof(ShadowMap));
+}
\ No newline at end of file
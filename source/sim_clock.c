@@ -0,0 +1,46 @@
+#include "../include/sim_clock.h"
+#include <string.h>
+#include <math.h>
+
+// Starts at step 0 with the given steps per second
+void initSimulationClock(SimulationClock* clock, double rate, int maxSteps){
+    memset(clock, 0, sizeof(SimulationClock));
+    clock->step = 1.0 / rate;
+    clock->maxSteps = maxSteps > 0 ? maxSteps : 1;
+}
+
+// Adds the frame time and takes the steps it covers
+int advanceSimulation(SimulationClock* clock, double elapsed){
+    clock->accumulator += elapsed;
+
+    int steps = 0;
+    while (clock->accumulator >= clock->step && steps < clock->maxSteps){
+        clock->accumulator -= clock->step;
+        clock->ticks++;
+        steps++;
+    }
+
+    // Behind by more than the clamp allows, the simulation slows down instead of spiralling
+    // Only the whole steps are dropped, the fraction left keeps the interpolation where it was heading
+    if (clock->accumulator >= clock->step){
+        double fraction = fmod(clock->accumulator, clock->step);
+        clock->timeDropped += clock->accumulator - fraction;
+        clock->accumulator = fraction;
+    }
+    clock->alpha = clock->accumulator / clock->step;
+    clock->stepsTaken += steps;
+    return steps;
+}
+
+// Time of the latest step, from the step count so it never drifts
+double simulationTime(const SimulationClock* clock){
+    return clock->ticks * clock->step;
+}
+
+// Time the renderer draws, one step behind so there is always a later state to move towards
+double interpolatedTime(const SimulationClock* clock){
+    if (clock->ticks == 0){
+        return 0.0;
+    }
+    return (clock->ticks - 1 + clock->alpha) * clock->step;
+}
\ No newline at end of file
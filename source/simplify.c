@@ -0,0 +1,358 @@
+#include "../include/simplify.h"
+#include "../include/mesh_optimize.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Levels that keep more than this share of the previous level's triangles are dropped
+#define MIN_LOD_REDUCTION 0.8f
+
+// Symmetric 4x4 matrix, the sum of the squared distances to the planes around a vertex
+// Planes are weighted by triangle area, weight keeps the total so errors are in squared model units
+typedef struct {
+    double a2, b2, c2, d2;
+    double ab, ac, ad, bc, bd, cd;
+    double weight;
+} Quadric;
+
+// A possible collapse of v0 onto v1
+typedef struct {
+    unsigned int v0;
+    unsigned int v1;
+    float cost;
+} Collapse;
+
+static void quadricAddPlane(Quadric* q, double a, double b, double c, double d, double w){
+    q->a2 += a * a * w; q->b2 += b * b * w; q->c2 += c * c * w; q->d2 += d * d * w;
+    q->ab += a * b * w; q->ac += a * c * w; q->ad += a * d * w;
+    q->bc += b * c * w; q->bd += b * d * w; q->cd += c * d * w;
+    q->weight += w;
+}
+
+static void quadricAdd(Quadric* q, const Quadric* other){
+    q->a2 += other->a2; q->b2 += other->b2; q->c2 += other->c2; q->d2 += other->d2;
+    q->ab += other->ab; q->ac += other->ac; q->ad += other->ad;
+    q->bc += other->bc; q->bd += other->bd; q->cd += other->cd;
+    q->weight += other->weight;
+}
+
+// Mean squared distance of a point to the planes of the quadric
+static double quadricError(const Quadric* q, const Vertex* v){
+    double x = v->x, y = v->y, z = v->z;
+    double r = q->a2 * x * x + q->b2 * y * y + q->c2 * z * z + q->d2
+             + 2.0 * (q->ab * x * y + q->ac * x * z + q->bc * y * z)
+             + 2.0 * (q->ad * x + q->bd * y + q->cd * z);
+    return q->weight > 0.0 ? fabs(r) / q->weight : 0.0;
+}
+
+// Unnormalized normal of a triangle
+static void triangleNormal(const Vertex* a, const Vertex* b, const Vertex* c, float* n){
+    float e1[3] = {b->x - a->x, b->y - a->y, b->z - a->z};
+    float e2[3] = {c->x - a->x, c->y - a->y, c->z - a->z};
+    n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+    n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+    n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+
+static int compareCollapse(const void* a, const void* b){
+    float ca = ((const Collapse*)a)->cost;
+    float cb = ((const Collapse*)b)->cost;
+    return (ca > cb) - (ca < cb);
+}
+
+// Marks vertices on edges that don't have exactly two triangles
+// 0 when the edge table could not be allocated, 1 on success
+static int findLockedVertices(const unsigned int* indices, int indexCount, int vertexCount, unsigned char* locked){
+    // Open addressing table of undirected edges and how many triangles use them
+    unsigned int tableSize = 1;
+    while (tableSize < (unsigned int)indexCount * 2) tableSize <<= 1;
+    unsigned long long* keys = (unsigned long long*)malloc(tableSize * sizeof(unsigned long long));
+    int* counts = (int*)calloc(tableSize, sizeof(int));
+    if (!keys || !counts){
+        printf("Failed to allocate edge table: (%u slots)\n", tableSize);
+        free(keys);
+        free(counts);
+        return 0;
+    }
+    memset(keys, 0xff, tableSize * sizeof(unsigned long long));
+
+    for (int i = 0; i < indexCount; i++){
+        unsigned int a = indices[i];
+        unsigned int b = indices[i % 3 == 2 ? i - 2 : i + 1];
+        unsigned long long key = a < b ? ((unsigned long long)a << 32) | b : ((unsigned long long)b << 32) | a;
+
+        unsigned int slot = (unsigned int)((key * 0x9E3779B97F4A7C15ull) >> 32) & (tableSize - 1);
+        while (keys[slot] != ~0ull && keys[slot] != key){
+            slot = (slot + 1) & (tableSize - 1);
+        }
+        keys[slot] = key;
+        counts[slot]++;
+    }
+
+    memset(locked, 0, vertexCount);
+    for (unsigned int slot = 0; slot < tableSize; slot++){
+        if (keys[slot] != ~0ull && counts[slot] != 2){
+            locked[keys[slot] >> 32] = 1;
+            locked[keys[slot] & 0xffffffffu] = 1;
+        }
+    }
+
+    free(keys);
+    free(counts);
+    return 1;
+}
+
+// Checks if moving v0 onto v1 turns any remaining triangle around v0 over
+static int collapseFlips(const unsigned int* indices, const int* adjOffsets, const int* adjTriangles,
+                         const Vertex* vertices, unsigned int v0, unsigned int v1){
+    for (int k = adjOffsets[v0]; k < adjOffsets[v0 + 1]; k++){
+        const unsigned int* tri = &indices[adjTriangles[k] * 3];
+
+        // Triangles on the edge disappear
+        if (tri[0] == v1 || tri[1] == v1 || tri[2] == v1){
+            continue;
+        }
+
+        const Vertex* before[3];
+        const Vertex* after[3];
+        for (int c = 0; c < 3; c++){
+            before[c] = &vertices[tri[c]];
+            after[c] = tri[c] == v0 ? &vertices[v1] : before[c];
+        }
+
+        float n0[3], n1[3];
+        triangleNormal(before[0], before[1], before[2], n0);
+        triangleNormal(after[0], after[1], after[2], n1);
+        float len0 = sqrtf(n0[0] * n0[0] + n0[1] * n0[1] + n0[2] * n0[2]);
+        float len1 = sqrtf(n1[0] * n1[0] + n1[1] * n1[1] + n1[2] * n1[2]);
+
+        // Already degenerate triangles have no side to flip to
+        if (len0 == 0.0f){
+            continue;
+        }
+        // Collapsing to a sliver or rotating too far is a flip
+        float dot = n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2];
+        if (len1 <= 1e-6f * len0 || dot < 0.25f * len0 * len1){
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Reduces an indexed triangle mesh towards targetIndexCount with quadric error edge collapses
+int simplifyMesh(unsigned int* destination, const unsigned int* indices, int indexCount,
+                 const Vertex* vertices, int vertexCount, int targetIndexCount, float* resultError){
+    memcpy(destination, indices, indexCount * sizeof(unsigned int));
+    double maxError = 0.0;
+
+    Quadric* quadrics = (Quadric*)calloc(vertexCount, sizeof(Quadric));
+    unsigned char* locked = (unsigned char*)malloc(vertexCount);
+
+    // Per pass working memory
+    int* adjOffsets = (int*)malloc((vertexCount + 1) * sizeof(int));
+    int* adjTriangles = (int*)malloc(indexCount * sizeof(int));
+    unsigned int* remap = (unsigned int*)malloc(vertexCount * sizeof(unsigned int));
+    unsigned char* touched = (unsigned char*)malloc(vertexCount);
+    Collapse* collapses = (Collapse*)malloc(indexCount * 2 * sizeof(Collapse));
+
+    if (!quadrics || !locked || !adjOffsets || !adjTriangles || !remap || !touched || !collapses){
+        printf("Failed to allocate memory for simplification: (%d vertices, %d indices)\n", vertexCount, indexCount);
+        indexCount = -1;
+        goto cleanup;
+    }
+    if (findLockedVertices(indices, indexCount, vertexCount, locked) == 0){
+        indexCount = -1;
+        goto cleanup;
+    }
+
+    // Area weighted plane of every triangle, added to its three corners
+    for (int i = 0; i < indexCount; i += 3){
+        const Vertex* a = &vertices[indices[i]];
+        float n[3];
+        triangleNormal(a, &vertices[indices[i + 1]], &vertices[indices[i + 2]], n);
+        double length = sqrt((double)n[0] * n[0] + (double)n[1] * n[1] + (double)n[2] * n[2]);
+        if (length == 0.0){
+            continue;
+        }
+        double nx = n[0] / length, ny = n[1] / length, nz = n[2] / length;
+        double d = -(nx * a->x + ny * a->y + nz * a->z);
+        for (int c = 0; c < 3; c++){
+            quadricAddPlane(&quadrics[indices[i + c]], nx, ny, nz, d, length * 0.5);
+        }
+    }
+
+
+    // Every pass collapses the cheapest edges that don't share a neighbourhood
+    while (indexCount > targetIndexCount){
+        int triangleCount = indexCount / 3;
+
+        // Triangles around each vertex
+        memset(adjOffsets, 0, (vertexCount + 1) * sizeof(int));
+        for (int i = 0; i < indexCount; i++){
+            adjOffsets[destination[i] + 1]++;
+        }
+        for (int v = 0; v < vertexCount; v++){
+            adjOffsets[v + 1] += adjOffsets[v];
+        }
+        for (int i = 0; i < indexCount; i++){
+            int v = destination[i];
+            adjTriangles[adjOffsets[v]++] = i / 3;
+        }
+        // Filling moved every offset to the next vertex's start
+        for (int v = vertexCount; v > 0; v--){
+            adjOffsets[v] = adjOffsets[v - 1];
+        }
+        adjOffsets[0] = 0;
+
+        // Both directions of every edge, a locked vertex can only be collapsed onto
+        int numCollapses = 0;
+        for (int i = 0; i < indexCount; i++){
+            unsigned int a = destination[i];
+            unsigned int b = destination[i % 3 == 2 ? i - 2 : i + 1];
+            for (int dir = 0; dir < 2; dir++){
+                unsigned int v0 = dir ? b : a;
+                unsigned int v1 = dir ? a : b;
+                if (locked[v0]){
+                    continue;
+                }
+                Quadric q = quadrics[v0];
+                quadricAdd(&q, &quadrics[v1]);
+                collapses[numCollapses].v0 = v0;
+                collapses[numCollapses].v1 = v1;
+                collapses[numCollapses].cost = (float)quadricError(&q, &vertices[v1]);
+                numCollapses++;
+            }
+        }
+        qsort(collapses, numCollapses, sizeof(Collapse), compareCollapse);
+
+        for (int v = 0; v < vertexCount; v++){
+            remap[v] = v;
+        }
+        memset(touched, 0, vertexCount);
+
+        // Collapse in order of cost until enough triangles are gone
+        int trianglesToRemove = (indexCount - targetIndexCount) / 3;
+        int removed = 0;
+        for (int c = 0; c < numCollapses && removed < trianglesToRemove; c++){
+            unsigned int v0 = collapses[c].v0;
+            unsigned int v1 = collapses[c].v1;
+            if (touched[v0] || touched[v1]){
+                continue;
+            }
+            if (collapseFlips(destination, adjOffsets, adjTriangles, vertices, v0, v1)){
+                continue;
+            }
+
+            remap[v0] = v1;
+            quadricAdd(&quadrics[v1], &quadrics[v0]);
+            if (collapses[c].cost > maxError){
+                maxError = collapses[c].cost;
+            }
+
+            // Nothing around v0 may change again this pass, its triangles are out of date
+            for (int k = adjOffsets[v0]; k < adjOffsets[v0 + 1]; k++){
+                const unsigned int* tri = &destination[adjTriangles[k] * 3];
+                touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = 1;
+                if (tri[0] == v1 || tri[1] == v1 || tri[2] == v1){
+                    removed++;
+                }
+            }
+        }
+        if (removed == 0){
+            break;
+        }
+
+        // Apply the collapses and drop the triangles that lost an edge
+        int newCount = 0;
+        for (int t = 0; t < triangleCount; t++){
+            unsigned int a = remap[destination[t * 3 + 0]];
+            unsigned int b = remap[destination[t * 3 + 1]];
+            unsigned int c = remap[destination[t * 3 + 2]];
+            if (a != b && b != c && a != c){
+                destination[newCount++] = a;
+                destination[newCount++] = b;
+                destination[newCount++] = c;
+            }
+        }
+        indexCount = newCount;
+    }
+
+cleanup:
+    free(quadrics);
+    free(locked);
+    free(adjOffsets);
+    free(adjTriangles);
+    free(remap);
+    free(touched);
+    free(collapses);
+
+    *resultError = (float)sqrt(maxError);
+    return indexCount;
+}
+
+// Appends up to maxLods - 1 simplified levels to the object
+// Every submesh is reduced on its own, material borders are open borders so they stay put
+void generateLods(LoadedObject* obj, int maxLods){
+    if (maxLods > MAX_LODS) maxLods = MAX_LODS;
+
+    while (obj->numLods < maxLods){
+        MeshLod prev = obj->lods[obj->numLods - 1];
+
+        // Room for a level as large as the previous one, the levels so far are kept if there is none
+        int offset = obj->numIndices;
+        unsigned int* indices = (unsigned int*)realloc(obj->indices, (offset + prev.numIndices) * sizeof(unsigned int));
+        if (indices == NULL){
+            printf("Failed to allocate LOD %d: (%d indices)\n", obj->numLods, prev.numIndices);
+            break;
+        }
+        obj->indices = indices;
+
+        MeshLod next;
+        memset(&next, 0, sizeof(MeshLod));
+        next.indexOffset = offset;
+
+        int source = prev.indexOffset;
+        float error = 0.0f;
+        int failed = 0;
+        for (int s = 0; s < obj->numSubmeshes && !failed; s++){
+            int sourceCount = prev.submeshIndices[s];
+            int target = (sourceCount / 2) / 3 * 3;
+
+            float submeshError = 0.0f;
+            int count = simplifyMesh(obj->indices + offset + next.numIndices, obj->indices + source, sourceCount,
+                                     obj->vertices, obj->numVertices, target, &submeshError);
+            if (count < 0){
+                failed = 1;
+                break;
+            }
+
+            // Collapses leave holes in the triangle order, a failure keeps the level in its unoptimized order
+            optimizeVertexCache(obj->indices + offset + next.numIndices, count, obj->numVertices);
+
+            next.submeshIndices[s] = count;
+            next.numIndices += count;
+            if (submeshError > error){
+                error = submeshError;
+            }
+            source += sourceCount;
+        }
+        if (failed || next.numIndices > prev.numIndices * MIN_LOD_REDUCTION){
+            break;
+        }
+
+        // Errors of the levels in between add up
+        next.error = prev.error + error;
+        obj->lods[obj->numLods++] = next;
+        obj->numIndices += next.numIndices;
+    }
+    // Trim the room of the level that was not kept, the larger buffer is still valid if this fails
+    unsigned int* trimmed = (unsigned int*)realloc(obj->indices, obj->numIndices * sizeof(unsigned int));
+    if (trimmed){
+        obj->indices = trimmed;
+    }
+
+    for (int i = 0; i < obj->numLods; i++){
+        printf("LOD %d: (%d) triangles, error (%f)\n", i, obj->lods[i].numIndices / 3, obj->lods[i].error);
+    }
+}
\ No newline at end of file
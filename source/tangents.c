@@ -0,0 +1,284 @@
+#include "../include/tangents.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Four triangles per step when SSE is available
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#define TANGENT_SIMD 1
+#endif
+
+// Accumulated frame of each vertex, tangent then bitangent
+#define FRAME_FLOATS 6
+
+static float signNotZero(float v){
+    return v >= 0.0f ? 1.0f : -1.0f;
+}
+
+static signed char toSnorm8(float v){
+    if (v > 1.0f) v = 1.0f;
+    if (v < -1.0f) v = -1.0f;
+    return (signed char)lroundf(v * 127.0f);
+}
+
+// Packs a unit vector into two snorm8 octahedral coordinates
+void encodeOctahedral(const float* v, signed char* dest){
+    float l1 = fabsf(v[0]) + fabsf(v[1]) + fabsf(v[2]);
+    if (l1 == 0.0f){
+        dest[0] = dest[1] = 0;
+        return;
+    }
+    float x = v[0] / l1, y = v[1] / l1;
+    // Lower hemisphere folds over the diagonals
+    if (v[2] < 0.0f){
+        float fx = (1.0f - fabsf(y)) * signNotZero(x);
+        float fy = (1.0f - fabsf(x)) * signNotZero(y);
+        x = fx;
+        y = fy;
+    }
+    dest[0] = toSnorm8(x);
+    dest[1] = toSnorm8(y);
+}
+
+// Unpacks two snorm8 octahedral coordinates into a unit vector, same as the vertex shader
+void decodeOctahedral(const signed char* e, float* dest){
+    float x = e[0] / 127.0f, y = e[1] / 127.0f;
+    float z = 1.0f - fabsf(x) - fabsf(y);
+    if (z < 0.0f){
+        float fx = (1.0f - fabsf(y)) * signNotZero(x);
+        float fy = (1.0f - fabsf(x)) * signNotZero(y);
+        x = fx;
+        y = fy;
+    }
+    float length = sqrtf(x * x + y * y + z * z);
+    dest[0] = x / length;
+    dest[1] = y / length;
+    dest[2] = z / length;
+}
+
+// Adds a corner's weighted face frame to its vertex
+static void addCorner(float* frames, unsigned int vertex, const float* t, const float* b, float angle){
+    float* frame = &frames[vertex * FRAME_FLOATS];
+    frame[0] += t[0] * angle; frame[1] += t[1] * angle; frame[2] += t[2] * angle;
+    frame[3] += b[0] * angle; frame[4] += b[1] * angle; frame[5] += b[2] * angle;
+}
+
+// Angle between two edges, 0 for a degenerate corner
+static float cornerAngle(const float* a, const float* b){
+    float la = sqrtf(a[0] * a[0] + a[1] * a[1] + a[2] * a[2]);
+    float lb = sqrtf(b[0] * b[0] + b[1] * b[1] + b[2] * b[2]);
+    if (la <= 1e-12f || lb <= 1e-12f){
+        return 0.0f;
+    }
+    float c = (a[0] * b[0] + a[1] * b[1] + a[2] * b[2]) / (la * lb);
+    if (c > 1.0f) c = 1.0f;
+    if (c < -1.0f) c = -1.0f;
+    return acosf(c);
+}
+
+static void normalizeOrZero(float* v){
+    float length = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    float inv = length > 1e-12f ? 1.0f / length : 0.0f;
+    v[0] *= inv; v[1] *= inv; v[2] *= inv;
+}
+
+// Frame of one triangle, the scalar version of the SSE loop
+static void addTriangle(float* frames, const Vertex* vertices, const unsigned int* tri){
+    const Vertex* a = &vertices[tri[0]];
+    const Vertex* b = &vertices[tri[1]];
+    const Vertex* c = &vertices[tri[2]];
+    float e1[3] = {b->x - a->x, b->y - a->y, b->z - a->z};
+    float e2[3] = {c->x - a->x, c->y - a->y, c->z - a->z};
+    float e3[3] = {c->x - b->x, c->y - b->y, c->z - b->z};
+    float du1 = b->u - a->u, dv1 = b->v - a->v;
+    float du2 = c->u - a->u, dv2 = c->v - a->v;
+
+    // Only the direction matters, the determinant's sign keeps the orientation
+    float sign = signNotZero(du1 * dv2 - du2 * dv1);
+    float t[3], bt[3];
+    for (int k = 0; k < 3; k++){
+        t[k] = (e1[k] * dv2 - e2[k] * dv1) * sign;
+        bt[k] = (e2[k] * du1 - e1[k] * du2) * sign;
+    }
+    normalizeOrZero(t);
+    normalizeOrZero(bt);
+
+    float ne1[3] = {-e1[0], -e1[1], -e1[2]};
+    float ne2[3] = {-e2[0], -e2[1], -e2[2]};
+    float ne3[3] = {-e3[0], -e3[1], -e3[2]};
+    addCorner(frames, tri[0], t, bt, cornerAngle(e1, e2));
+    addCorner(frames, tri[1], t, bt, cornerAngle(ne1, e3));
+    addCorner(frames, tri[2], t, bt, cornerAngle(ne2, ne3));
+}
+
+#ifdef TANGENT_SIMD
+// acos with a third order polynomial, error below 0.0001 radians
+static __m128 acos4(__m128 x){
+    __m128 signMask = _mm_set1_ps(-0.0f);
+    __m128 ax = _mm_andnot_ps(signMask, x);
+    __m128 p = _mm_set1_ps(-0.0187293f);
+    p = _mm_add_ps(_mm_mul_ps(p, ax), _mm_set1_ps(0.0742610f));
+    p = _mm_sub_ps(_mm_mul_ps(p, ax), _mm_set1_ps(0.2121144f));
+    p = _mm_add_ps(_mm_mul_ps(p, ax), _mm_set1_ps(1.5707288f));
+    __m128 r = _mm_mul_ps(p, _mm_sqrt_ps(_mm_sub_ps(_mm_set1_ps(1.0f), ax)));
+
+    // acos(-x) = pi - acos(x)
+    __m128 negative = _mm_cmplt_ps(x, _mm_setzero_ps());
+    __m128 reflected = _mm_sub_ps(_mm_set1_ps(3.14159265f), r);
+    return _mm_or_ps(_mm_and_ps(negative, reflected), _mm_andnot_ps(negative, r));
+}
+
+static __m128 dot4(__m128 ax, __m128 ay, __m128 az, __m128 bx, __m128 by, __m128 bz){
+    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz));
+}
+
+// 1 / sqrt(v), or 0 where v is too small
+static __m128 safeInvSqrt4(__m128 v){
+    __m128 valid = _mm_cmpgt_ps(v, _mm_set1_ps(1e-24f));
+    return _mm_and_ps(valid, _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(v)));
+}
+
+// Angle between edges a and b of four corners, using their squared lengths
+static __m128 cornerAngle4(__m128 d, __m128 la2, __m128 lb2){
+    __m128 c = _mm_mul_ps(d, _mm_mul_ps(safeInvSqrt4(la2), safeInvSqrt4(lb2)));
+    c = _mm_min_ps(_mm_max_ps(c, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f));
+    // Degenerate corners get no weight
+    __m128 valid = _mm_and_ps(_mm_cmpgt_ps(la2, _mm_set1_ps(1e-24f)), _mm_cmpgt_ps(lb2, _mm_set1_ps(1e-24f)));
+    return _mm_and_ps(valid, acos4(c));
+}
+#endif
+
+// Fills the tangent of every vertex from the triangles' UV directions
+int generateTangents(Vertex* vertices, int vertexCount, const unsigned int* indices, int indexCount){
+    if (vertexCount <= 0){
+        return 1;
+    }
+    float* frames = (float*)calloc((size_t)vertexCount * FRAME_FLOATS, sizeof(float));
+    if (frames == NULL){
+        printf("Failed to allocate tangent frames: (%d) vertices\n", vertexCount);
+        return 0;
+    }
+    int triangleCount = indexCount / 3;
+    int t = 0;
+
+#ifdef TANGENT_SIMD
+    // Face frames and corner angles four triangles at a time, only the scatter is scalar
+    __m128 signMask = _mm_set1_ps(-0.0f);
+    __m128 one = _mm_set1_ps(1.0f);
+    for (; t + 4 <= triangleCount; t += 4){
+        const unsigned int* tri = &indices[t * 3];
+        const Vertex* a[4];
+        const Vertex* b[4];
+        const Vertex* c[4];
+        for (int k = 0; k < 4; k++){
+            a[k] = &vertices[tri[k * 3 + 0]];
+            b[k] = &vertices[tri[k * 3 + 1]];
+            c[k] = &vertices[tri[k * 3 + 2]];
+        }
+
+        // Edges
+        __m128 ax = _mm_setr_ps(a[0]->x, a[1]->x, a[2]->x, a[3]->x);
+        __m128 ay = _mm_setr_ps(a[0]->y, a[1]->y, a[2]->y, a[3]->y);
+        __m128 az = _mm_setr_ps(a[0]->z, a[1]->z, a[2]->z, a[3]->z);
+        __m128 bx = _mm_setr_ps(b[0]->x, b[1]->x, b[2]->x, b[3]->x);
+        __m128 by = _mm_setr_ps(b[0]->y, b[1]->y, b[2]->y, b[3]->y);
+        __m128 bz = _mm_setr_ps(b[0]->z, b[1]->z, b[2]->z, b[3]->z);
+        __m128 cx = _mm_setr_ps(c[0]->x, c[1]->x, c[2]->x, c[3]->x);
+        __m128 cy = _mm_setr_ps(c[0]->y, c[1]->y, c[2]->y, c[3]->y);
+        __m128 cz = _mm_setr_ps(c[0]->z, c[1]->z, c[2]->z, c[3]->z);
+        __m128 e1x = _mm_sub_ps(bx, ax), e1y = _mm_sub_ps(by, ay), e1z = _mm_sub_ps(bz, az);
+        __m128 e2x = _mm_sub_ps(cx, ax), e2y = _mm_sub_ps(cy, ay), e2z = _mm_sub_ps(cz, az);
+        __m128 e3x = _mm_sub_ps(cx, bx), e3y = _mm_sub_ps(cy, by), e3z = _mm_sub_ps(cz, bz);
+
+        // UV deltas
+        __m128 au = _mm_setr_ps(a[0]->u, a[1]->u, a[2]->u, a[3]->u);
+        __m128 av = _mm_setr_ps(a[0]->v, a[1]->v, a[2]->v, a[3]->v);
+        __m128 du1 = _mm_sub_ps(_mm_setr_ps(b[0]->u, b[1]->u, b[2]->u, b[3]->u), au);
+        __m128 dv1 = _mm_sub_ps(_mm_setr_ps(b[0]->v, b[1]->v, b[2]->v, b[3]->v), av);
+        __m128 du2 = _mm_sub_ps(_mm_setr_ps(c[0]->u, c[1]->u, c[2]->u, c[3]->u), au);
+        __m128 dv2 = _mm_sub_ps(_mm_setr_ps(c[0]->v, c[1]->v, c[2]->v, c[3]->v), av);
+
+        // Only the direction matters, the determinant's sign keeps the orientation
+        __m128 det = _mm_sub_ps(_mm_mul_ps(du1, dv2), _mm_mul_ps(du2, dv1));
+        __m128 sign = _mm_or_ps(_mm_and_ps(det, signMask), one);
+        __m128 sdv1 = _mm_mul_ps(dv1, sign), sdv2 = _mm_mul_ps(dv2, sign);
+        __m128 sdu1 = _mm_mul_ps(du1, sign), sdu2 = _mm_mul_ps(du2, sign);
+
+        __m128 tx = _mm_sub_ps(_mm_mul_ps(e1x, sdv2), _mm_mul_ps(e2x, sdv1));
+        __m128 ty = _mm_sub_ps(_mm_mul_ps(e1y, sdv2), _mm_mul_ps(e2y, sdv1));
+        __m128 tz = _mm_sub_ps(_mm_mul_ps(e1z, sdv2), _mm_mul_ps(e2z, sdv1));
+        __m128 invT = safeInvSqrt4(dot4(tx, ty, tz, tx, ty, tz));
+        tx = _mm_mul_ps(tx, invT); ty = _mm_mul_ps(ty, invT); tz = _mm_mul_ps(tz, invT);
+
+        __m128 btx = _mm_sub_ps(_mm_mul_ps(e2x, sdu1), _mm_mul_ps(e1x, sdu2));
+        __m128 bty = _mm_sub_ps(_mm_mul_ps(e2y, sdu1), _mm_mul_ps(e1y, sdu2));
+        __m128 btz = _mm_sub_ps(_mm_mul_ps(e2z, sdu1), _mm_mul_ps(e1z, sdu2));
+        __m128 invB = safeInvSqrt4(dot4(btx, bty, btz, btx, bty, btz));
+        btx = _mm_mul_ps(btx, invB); bty = _mm_mul_ps(bty, invB); btz = _mm_mul_ps(btz, invB);
+
+        // Corner angles, at a between e1 and e2, at b between -e1 and e3, at c between -e2 and -e3
+        __m128 l1 = dot4(e1x, e1y, e1z, e1x, e1y, e1z);
+        __m128 l2 = dot4(e2x, e2y, e2z, e2x, e2y, e2z);
+        __m128 l3 = dot4(e3x, e3y, e3z, e3x, e3y, e3z);
+        __m128 angle0 = cornerAngle4(dot4(e1x, e1y, e1z, e2x, e2y, e2z), l1, l2);
+        __m128 angle1 = cornerAngle4(_mm_xor_ps(dot4(e1x, e1y, e1z, e3x, e3y, e3z), signMask), l1, l3);
+        __m128 angle2 = cornerAngle4(dot4(e2x, e2y, e2z, e3x, e3y, e3z), l2, l3);
+
+        float T[3][4], B[3][4], angles[3][4];
+        _mm_storeu_ps(T[0], tx); _mm_storeu_ps(T[1], ty); _mm_storeu_ps(T[2], tz);
+        _mm_storeu_ps(B[0], btx); _mm_storeu_ps(B[1], bty); _mm_storeu_ps(B[2], btz);
+        _mm_storeu_ps(angles[0], angle0); _mm_storeu_ps(angles[1], angle1); _mm_storeu_ps(angles[2], angle2);
+
+        for (int k = 0; k < 4; k++){
+            float tk[3] = {T[0][k], T[1][k], T[2][k]};
+            float bk[3] = {B[0][k], B[1][k], B[2][k]};
+            for (int corner = 0; corner < 3; corner++){
+                addCorner(frames, tri[k * 3 + corner], tk, bk, angles[corner][k]);
+            }
+        }
+    }
+#endif
+
+    // Remainder, or everything without SSE
+    for (; t < triangleCount; t++){
+        addTriangle(frames, vertices, &indices[t * 3]);
+    }
+
+    // Orthogonalize against the normal and pack
+    for (int i = 0; i < vertexCount; i++){
+        Vertex* vertex = &vertices[i];
+        const float* frame = &frames[i * FRAME_FLOATS];
+        float n[3] = {vertex->nx, vertex->ny, vertex->nz};
+        normalizeOrZero(n);
+
+        // Gram-Schmidt
+        float d = n[0] * frame[0] + n[1] * frame[1] + n[2] * frame[2];
+        float tangent[3] = {frame[0] - n[0] * d, frame[1] - n[1] * d, frame[2] - n[2] * d};
+        normalizeOrZero(tangent);
+
+        // No UV direction here, any tangent perpendicular to the normal will do
+        if (tangent[0] == 0.0f && tangent[1] == 0.0f && tangent[2] == 0.0f){
+            float axis[3] = {0.0f, 0.0f, 0.0f};
+            axis[fabsf(n[0]) < 0.9f ? 0 : 1] = 1.0f;
+            tangent[0] = n[1] * axis[2] - n[2] * axis[1];
+            tangent[1] = n[2] * axis[0] - n[0] * axis[2];
+            tangent[2] = n[0] * axis[1] - n[1] * axis[0];
+            normalizeOrZero(tangent);
+        }
+
+        // Mirrored UVs flip the bitangent
+        float cross[3] = {n[1] * tangent[2] - n[2] * tangent[1],
+                          n[2] * tangent[0] - n[0] * tangent[2],
+                          n[0] * tangent[1] - n[1] * tangent[0]};
+        float handedness = cross[0] * frame[3] + cross[1] * frame[4] + cross[2] * frame[5];
+
+        encodeOctahedral(tangent, vertex->tangent);
+        vertex->tangent[2] = handedness < 0.0f ? -127 : 127;
+        vertex->tangent[3] = 0;
+    }
+
+    free(frames);
+    return 1;
+}
\ No newline at end of file
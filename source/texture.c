@@ -1,52 +1,82 @@
 #include "../include/texture.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "../glad/glad.h"
 
 // For image loading
 #define STB_IMAGE_IMPLEMENTATION
 #include "../include/stb_image.h"
 
+// Reads and decodes an image file, needs no GL context
+// 0 on failure, 1 on success
+int loadImage(const char* path, ImageData* image){
+    memset(image, 0, sizeof(ImageData));
+
+    // Flip image on load, per thread so decoding can run off the main thread
+    stbi_set_flip_vertically_on_load_thread(1);
+
+    // Read the image file
+    image->pixels = stbi_load(path, &image->width, &image->height, &image->channels, 0);
+    if (!image->pixels){
+        printf("Failed to load texture: (%s)\n", path);
+        return 0;
+    }
+    return 1;
+}
+
+// Filters the image's mip levels, needs no GL context
+// 0 on failure, 1 on success
+int generateImageMips(ImageData* image, MipSpace space){
+    freeMipChain(&image->mips);
+    if (!image->pixels){
+        return 0;
+    }
+    return generateMipChain(image->pixels, image->width, image->height, image->channels, space, &image->mips);
+}
+
+// Replaces the contents of a texture with the image and every mip level, the texture keeps its ID
+// Leaves the texture bound to the active unit
+void uploadTexture(GLuint texture, const ImageData* image){
+    // Levels come from the CPU, so they are the same on every driver
+    MipChain mips = image->mips;
+    if (mips.numLevels == 0 && generateMipChain(image->pixels, image->width, image->height, image->channels, MIP_SRGB, &mips) == 0){
+        return;
+    }
+    glBindTexture(GL_TEXTURE_2D, texture);
+    uploadMipChain(&mips);
+    if (image->mips.numLevels == 0){
+        freeMipChain(&mips);
+    }
+}
+
+// Frees the decoded pixels and the mips
+void freeImage(ImageData* image){
+    freeMipChain(&image->mips);
+    stbi_image_free(image->pixels);
+    memset(image, 0, sizeof(ImageData));
+}
+
 // Loads a texture from the given file path
 // Returns the texture ID on success, 0 on failure
 GLuint loadTexture(const char* path){
     printf("Loading Texture: (%s)\n", path);
 
+    // Read the image file and filter its levels
+    ImageData image;
+    if (loadImage(path, &image) == 0){
+        return 0;
+    }
+    generateImageMips(&image, MIP_SRGB);
+
     // Generate texture ID and load texture data
     GLuint textureID;
     glGenTextures(1, &textureID);
 
-    // Bind the texture
-    glBindTexture(GL_TEXTURE_2D, textureID);
-
-    // Set texture parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    // No sampling state here, it comes from the sampler object bound with the texture
+    uploadTexture(textureID, &image);
 
-
-    int width, height, nrChannels;
-    // Flip image on load
-    stbi_set_flip_vertically_on_load(1); 
-
-    // Read the image file
-    unsigned char *input = stbi_load(path, &width, &height, &nrChannels, 0);
-
-    if (input){
-        GLenum format = GL_RGB;
-        if (nrChannels == 4){
-            format = GL_RGBA;
-        }
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, input);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        // Free image data
-        stbi_image_free(input);
-        return textureID;
-    } else {
-        printf("Failed to load texture: (%s)\n", path);
-        stbi_image_free(input);
-        return 0;
-    }
+    // Free image data
+    freeImage(&image);
+    return textureID;
 }
\ No newline at end of file
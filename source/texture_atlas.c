@@ -0,0 +1,484 @@
+#include "../include/texture_atlas.h"
+#include "../include/bindless.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Makes an empty atlas and binds its table
+void initTextureAtlas(TextureAtlas* atlas){
+    memset(atlas, 0, sizeof(TextureAtlas));
+    glGenTextures(1, &atlas->texture);
+    glGenTextures(1, &atlas->dataTexture);
+
+    // Whole table is always allocated, so the shader's fixed size array is backed
+    glGenBuffers(1, &atlas->ubo);
+    glBindBuffer(GL_UNIFORM_BUFFER, atlas->ubo);
+    glBufferData(GL_UNIFORM_BUFFER, MAX_ATLAS_IMAGES * sizeof(GpuAtlasImage), NULL, GL_STATIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, ATLAS_BINDING, atlas->ubo);
+}
+
+// Switches the atlas to bindless textures if the context has them
+int useBindlessAtlas(TextureAtlas* atlas){
+    atlas->bindless = loadBindlessTexture();
+    return atlas->bindless;
+}
+
+// Adds an image file
+// A file used both as color and as data is two images, one filtered in each space
+int addAtlasImage(TextureAtlas* atlas, const char* path, MipSpace space){
+    for (int i = 0; i < atlas->numImages; i++){
+        if (atlas->images[i].space == space && strcmp(atlas->images[i].path, path) == 0){
+            return i;
+        }
+    }
+    if (atlas->numImages >= MAX_ATLAS_IMAGES){
+        printf("Texture atlas is full: (%s)\n", path);
+        return -1;
+    }
+    AtlasImage* image = &atlas->images[atlas->numImages];
+    memset(image, 0, sizeof(AtlasImage));
+    snprintf(image->path, ATLAS_PATH_LENGTH, "%s", path);
+    image->space = space;
+    return atlas->numImages++;
+}
+
+// Copies an image to RGBA pixels with its edges repeated ATLAS_PADDING texels outwards
+// dest starts at the padding's corner and has rows of destWidth texels
+static void copyPadded(const ImageData* data, unsigned char* dest, int destWidth){
+    int width = data->width, height = data->height, channels = data->channels;
+    for (int y = -ATLAS_PADDING; y < height + ATLAS_PADDING; y++){
+        int sy = y < 0 ? 0 : (y >= height ? height - 1 : y);
+        unsigned char* row = dest + (size_t)(y + ATLAS_PADDING) * destWidth * 4;
+        for (int x = -ATLAS_PADDING; x < width + ATLAS_PADDING; x++){
+            int sx = x < 0 ? 0 : (x >= width ? width - 1 : x);
+            const unsigned char* src = data->pixels + ((size_t)sy * width + sx) * channels;
+            unsigned char* texel = row + (size_t)(x + ATLAS_PADDING) * 4;
+
+            // Grey, grey and alpha, RGB or RGBA
+            texel[0] = src[0];
+            texel[1] = channels >= 3 ? src[1] : src[0];
+            texel[2] = channels >= 3 ? src[2] : src[0];
+            texel[3] = channels == 4 ? src[3] : (channels == 2 ? src[1] : 255);
+        }
+    }
+}
+
+// Uploads the given texels of every level of one layer's kept chain
+static void uploadLayerRects(TextureAtlas* atlas, int layer, const MipRect* rects){
+    const MipChain* mips = &atlas->layerMips[layer];
+    GLint alignment;
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    // Both arrays get the whole layer, the rects of the other kind are never read from them
+    GLuint textures[2] = {atlas->texture, atlas->dataTexture};
+    for (int t = 0; t < 2; t++){
+        glBindTexture(GL_TEXTURE_2D_ARRAY, textures[t]);
+        for (int level = 0; level < mips->numLevels; level++){
+            const MipRect* rect = &rects[level];
+            if (rect->x0 >= rect->x1 || rect->y0 >= rect->y1){
+                continue;
+            }
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, mips->widths[level]);
+            glPixelStorei(GL_UNPACK_SKIP_PIXELS, rect->x0);
+            glPixelStorei(GL_UNPACK_SKIP_ROWS, rect->y0);
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, rect->x0, rect->y0, layer, rect->x1 - rect->x0, rect->y1 - rect->y0, 1,
+                            GL_RGBA, GL_UNSIGNED_BYTE, mips->levels[level]);
+        }
+    }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+}
+
+// Filters every level of one layer, keeps them and uploads them, the layer is color except for the rects of data images
+static void uploadLayerMips(TextureAtlas* atlas, int layer){
+    size_t layerSize = (size_t)atlas->width * atlas->height * 4;
+    MipChain* mips = &atlas->layerMips[layer];
+    if (generateMipChain(atlas->layerPixels + layer * layerSize, atlas->width, atlas->height, 4, MIP_SRGB, mips) == 0){
+        return;
+    }
+    for (int i = 0; i < atlas->numImages; i++){
+        const AtlasImage* image = &atlas->images[i];
+        if (image->layer == layer && image->space != MIP_SRGB){
+            refilterMipRegion(mips, image->x - ATLAS_PADDING, image->y - ATLAS_PADDING,
+                              image->width + 2 * ATLAS_PADDING, image->height + 2 * ATLAS_PADDING, image->space);
+        }
+    }
+
+    MipRect rects[MAX_MIP_LEVELS];
+    for (int level = 0; level < mips->numLevels; level++){
+        MipRect whole = {0, 0, mips->widths[level], mips->heights[level]};
+        rects[level] = whole;
+    }
+    uploadLayerRects(atlas, layer, rects);
+}
+
+// Frees the kept levels of every layer
+static void freeLayerMips(TextureAtlas* atlas){
+    if (atlas->layerMips){
+        for (int layer = 0; layer < atlas->numLayers; layer++){
+            freeMipChain(&atlas->layerMips[layer]);
+        }
+    }
+    free(atlas->layerMips);
+    free(atlas->layerPixels);
+    atlas->layerMips = NULL;
+    atlas->layerPixels = NULL;
+}
+
+// Places every image on shelves in the layers, tallest first
+// Layers are as big as the largest image, so same size images get one each
+static void packImages(TextureAtlas* atlas){
+    int order[MAX_ATLAS_IMAGES];
+    atlas->width = atlas->height = 1;
+    for (int i = 0; i < atlas->numImages; i++){
+        const AtlasImage* image = &atlas->images[i];
+        if (image->width + 2 * ATLAS_PADDING > atlas->width) atlas->width = image->width + 2 * ATLAS_PADDING;
+        if (image->height + 2 * ATLAS_PADDING > atlas->height) atlas->height = image->height + 2 * ATLAS_PADDING;
+
+        // Insertion sort by height, there are only a few images
+        int j = i;
+        while (j > 0 && atlas->images[order[j - 1]].height < image->height){
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+
+    int layer = 0, shelfX = 0, shelfY = 0, shelfHeight = 0;
+    for (int i = 0; i < atlas->numImages; i++){
+        AtlasImage* image = &atlas->images[order[i]];
+        int width = image->width + 2 * ATLAS_PADDING;
+        int height = image->height + 2 * ATLAS_PADDING;
+
+        // Next shelf, then next layer
+        if (shelfX + width > atlas->width){
+            shelfX = 0;
+            shelfY += shelfHeight;
+            shelfHeight = 0;
+        }
+        if (shelfY + height > atlas->height){
+            layer++;
+            shelfX = shelfY = shelfHeight = 0;
+        }
+
+        image->layer = layer;
+        image->x = shelfX + ATLAS_PADDING;
+        image->y = shelfY + ATLAS_PADDING;
+        shelfX += width;
+        if (height > shelfHeight) shelfHeight = height;
+    }
+    atlas->numLayers = atlas->numImages > 0 ? layer + 1 : 1;
+}
+
+// Uploads the UV rect and layer of every image
+static void uploadImageTable(const TextureAtlas* atlas){
+    GpuAtlasImage gpuImages[MAX_ATLAS_IMAGES];
+    memset(gpuImages, 0, sizeof(gpuImages));
+    for (int i = 0; i < atlas->numImages; i++){
+        const AtlasImage* image = &atlas->images[i];
+        if (atlas->bindless){
+            // The whole texture is the image
+            gpuImages[i].rect[2] = gpuImages[i].rect[3] = 1.0f;
+            memcpy(gpuImages[i].handles, atlas->handles[i], sizeof(atlas->handles[i]));
+            continue;
+        }
+        gpuImages[i].rect[0] = (float)image->x / atlas->width;
+        gpuImages[i].rect[1] = (float)image->y / atlas->height;
+        gpuImages[i].rect[2] = (float)image->width / atlas->width;
+        gpuImages[i].rect[3] = (float)image->height / atlas->height;
+        gpuImages[i].layer = (float)image->layer;
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, atlas->ubo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(gpuImages), gpuImages);
+}
+
+// Makes the handles of one image for the current samplers resident
+// Without samplers every class gets the texture's own handle
+static void makeImageResident(TextureAtlas* atlas, int image){
+    for (int c = 0; c < SAMPLER_CLASSES; c++){
+        GLuint texture = atlas->imageTextures[image];
+        GLuint64 handle = atlas->samplers[c] ? glGetTextureSamplerHandleARB(texture, atlas->samplers[c]) : glGetTextureHandleARB(texture);
+        atlas->handles[image][c] = handle;
+
+        // Classes sharing a handle make it resident once
+        int resident = 0;
+        for (int d = 0; d < c; d++){
+            if (atlas->handles[image][d] == handle) resident = 1;
+        }
+        if (!resident){
+            glMakeTextureHandleResidentARB(handle);
+        }
+    }
+}
+
+// Drops the handles of one image from residency, they stay valid for later use
+static void makeImageNonResident(TextureAtlas* atlas, int image){
+    for (int c = 0; c < SAMPLER_CLASSES; c++){
+        GLuint64 handle = atlas->handles[image][c];
+        int released = handle == 0;
+        for (int d = 0; d < c; d++){
+            if (atlas->handles[image][d] == handle) released = 1;
+        }
+        if (!released){
+            glMakeTextureHandleNonResidentARB(handle);
+        }
+    }
+    memset(atlas->handles[image], 0, sizeof(atlas->handles[image]));
+}
+
+// Own mipmapped texture of one image for the bindless path, sampled through the atlas samplers
+// A missing image gets a black texel so its handles are still valid
+static void createImageTexture(TextureAtlas* atlas, int image, const ImageData* data){
+    unsigned char black[4] = {0, 0, 0, 255};
+    ImageData blank = {.pixels = black, .width = 1, .height = 1, .channels = 4};
+    if (!data->pixels){
+        data = &blank;
+    }
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    uploadTexture(texture, data);
+
+    // From here on the texture's storage is fixed, only its pixels can change
+    atlas->imageTextures[image] = texture;
+    makeImageResident(atlas, image);
+    atlas->images[image].width = data->width;
+    atlas->images[image].height = data->height;
+}
+
+// Drops the handles and texture of one image
+static void deleteImageTexture(TextureAtlas* atlas, int image){
+    makeImageNonResident(atlas, image);
+    if (atlas->imageTextures[image]){
+        glDeleteTextures(1, &atlas->imageTextures[image]);
+        atlas->imageTextures[image] = 0;
+    }
+}
+
+// Samplers the bindless handles are made with
+void setAtlasSamplers(TextureAtlas* atlas, const GLuint* samplers){
+    memcpy(atlas->samplers, samplers, sizeof(atlas->samplers));
+    if (!atlas->bindless){
+        return;
+    }
+
+    // A handle's sampler can not change, the image gets the handles of the new pairs
+    for (int i = 0; i < atlas->numImages; i++){
+        if (atlas->imageTextures[i]){
+            makeImageNonResident(atlas, i);
+            makeImageResident(atlas, i);
+        }
+    }
+    uploadImageTable(atlas);
+}
+
+// Makes a resident texture for every image that has none yet
+static int buildBindlessImages(TextureAtlas* atlas){
+    for (int i = 0; i < atlas->numImages; i++){
+        if (atlas->imageTextures[i]){
+            continue;
+        }
+        printf("Loading Texture: (%s)\n", atlas->images[i].path);
+        ImageData data;
+        loadImage(atlas->images[i].path, &data);
+        generateImageMips(&data, atlas->images[i].space);
+        createImageTexture(atlas, i, &data);
+        freeImage(&data);
+    }
+
+    uploadImageTable(atlas);
+    printf("Texture atlas: (%d) bindless images\n", atlas->numImages);
+    return 1;
+}
+
+// Loads every added image and packs them into the texture array
+int buildTextureAtlas(TextureAtlas* atlas){
+    if (atlas->bindless){
+        return buildBindlessImages(atlas);
+    }
+
+    ImageData* data = (ImageData*)calloc(MAX_ATLAS_IMAGES, sizeof(ImageData));
+    if (!data){
+        printf("Failed to allocate memory for the texture atlas\n");
+        return 0;
+    }
+
+    // A missing file still keeps its index, as a small blank image
+    for (int i = 0; i < atlas->numImages; i++){
+        printf("Loading Texture: (%s)\n", atlas->images[i].path);
+        loadImage(atlas->images[i].path, &data[i]);
+        atlas->images[i].width = data[i].pixels ? data[i].width : 1;
+        atlas->images[i].height = data[i].pixels ? data[i].height : 1;
+    }
+    freeLayerMips(atlas);
+    packImages(atlas);
+
+    // Layers are filled on the CPU, every texel outside an image stays black
+    size_t layerSize = (size_t)atlas->width * atlas->height * 4;
+    unsigned char* pixels = atlas->layerPixels = (unsigned char*)calloc((size_t)atlas->numLayers, layerSize);
+    atlas->layerMips = (MipChain*)calloc((size_t)atlas->numLayers, sizeof(MipChain));
+    if (!pixels || !atlas->layerMips){
+        freeLayerMips(atlas);
+        printf("Failed to allocate memory for the texture atlas\n");
+        for (int i = 0; i < atlas->numImages; i++) freeImage(&data[i]);
+        free(data);
+        return 0;
+    }
+    for (int i = 0; i < atlas->numImages; i++){
+        const AtlasImage* image = &atlas->images[i];
+        if (data[i].pixels){
+            unsigned char* corner = pixels + image->layer * layerSize
+                                  + ((size_t)(image->y - ATLAS_PADDING) * atlas->width + (image->x - ATLAS_PADDING)) * 4;
+            copyPadded(&data[i], corner, atlas->width);
+        }
+        freeImage(&data[i]);
+    }
+    free(data);
+
+    // Sampled through the image rects, the shader does the repeating
+    // Sampling state comes from the sampler objects bound with it
+    GLuint textures[2] = {atlas->texture, atlas->dataTexture};
+    GLenum formats[2] = {GL_SRGB8_ALPHA8, GL_RGBA8};
+    for (int t = 0; t < 2; t++){
+        glBindTexture(GL_TEXTURE_2D_ARRAY, textures[t]);
+        int numLevels = 0;
+        for (int width = atlas->width, height = atlas->height; numLevels < MAX_MIP_LEVELS; numLevels++){
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, numLevels, formats[t], width, height, atlas->numLayers, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+            if (width == 1 && height == 1){
+                numLevels++;
+                break;
+            }
+            width = width > 1 ? width / 2 : 1;
+            height = height > 1 ? height / 2 : 1;
+        }
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, numLevels - 1);
+    }
+    for (int layer = 0; layer < atlas->numLayers; layer++){
+        uploadLayerMips(atlas, layer);
+    }
+
+    uploadImageTable(atlas);
+    printf("Texture atlas: (%d) images in (%d) layers of (%d x %d)\n", atlas->numImages, atlas->numLayers, atlas->width, atlas->height);
+    return 1;
+}
+
+// Copies where an image sits
+void getAtlasSlot(const TextureAtlas* atlas, int image, AtlasSlot* slot){
+    const AtlasImage* target = &atlas->images[image];
+    slot->layerWidth = atlas->width;
+    slot->layerHeight = atlas->height;
+    slot->layer = target->layer;
+    slot->x = target->x;
+    slot->y = target->y;
+    slot->width = target->width;
+    slot->height = target->height;
+    slot->space = target->space;
+}
+
+static int sameSlot(const AtlasSlot* a, const AtlasSlot* b){
+    return a->layerWidth == b->layerWidth && a->layerHeight == b->layerHeight && a->layer == b->layer &&
+           a->x == b->x && a->y == b->y && a->width == b->width && a->height == b->height && a->space == b->space;
+}
+
+// Pads the image and filters only the texels of its layer that it alone reaches
+int filterAtlasImage(const AtlasSlot* slot, const ImageData* data, AtlasImageLevels* levels){
+    memset(levels, 0, sizeof(AtlasImageLevels));
+    if (!data->pixels || data->width != slot->width || data->height != slot->height){
+        return 1;
+    }
+    int width = data->width + 2 * ATLAS_PADDING;
+    int height = data->height + 2 * ATLAS_PADDING;
+    levels->pixels = (unsigned char*)malloc((size_t)width * height * 4);
+    if (!levels->pixels){
+        printf("Failed to allocate memory for the atlas image: (%d x %d)\n", data->width, data->height);
+        return 0;
+    }
+    copyPadded(data, levels->pixels, width);
+
+    MipRect rect = {slot->x - ATLAS_PADDING, slot->y - ATLAS_PADDING, slot->x - ATLAS_PADDING + width, slot->y - ATLAS_PADDING + height};
+    if (generateMipRegion(levels->pixels, slot->layerWidth, slot->layerHeight, rect, 4, slot->space, &levels->region) == 0){
+        freeAtlasImageLevels(levels);
+        return 0;
+    }
+    levels->slot = *slot;
+    return 1;
+}
+
+void freeAtlasImageLevels(AtlasImageLevels* levels){
+    freeMipRegion(&levels->region);
+    free(levels->pixels);
+    memset(levels, 0, sizeof(AtlasImageLevels));
+}
+
+// Replaces one image with new pixels of the same size
+int updateAtlasImage(TextureAtlas* atlas, int image, const ImageData* data, const AtlasImageLevels* levels){
+    AtlasImage* target = &atlas->images[image];
+    if (atlas->bindless){
+        if (data->width == target->width && data->height == target->height){
+            // Same levels as before, filtered here if the worker did not
+            MipChain mips = data->mips;
+            if (mips.numLevels == 0 && generateMipChain(data->pixels, data->width, data->height, data->channels,
+                                                        target->space, &mips) == 0){
+                return 1;
+            }
+            glBindTexture(GL_TEXTURE_2D, atlas->imageTextures[image]);
+            replaceMipChain(&mips);
+            if (data->mips.numLevels == 0){
+                freeMipChain(&mips);
+            }
+        }
+        else {
+            // Storage can not be resized once a handle exists
+            deleteImageTexture(atlas, image);
+            createImageTexture(atlas, image, data);
+            uploadImageTable(atlas);
+        }
+        return 1;
+    }
+    if (data->width != target->width || data->height != target->height || !atlas->layerMips ||
+        atlas->layerMips[target->layer].numLevels == 0){
+        return 0;
+    }
+
+    // Levels filtered for where the image sits now, the worker's unless the atlas was packed since
+    AtlasSlot slot;
+    getAtlasSlot(atlas, image, &slot);
+    AtlasImageLevels filtered;
+    memset(&filtered, 0, sizeof(AtlasImageLevels));
+    if (!levels || !levels->pixels || !sameSlot(&levels->slot, &slot)){
+        if (filterAtlasImage(&slot, data, &filtered) == 0){
+            return 1;
+        }
+        levels = &filtered;
+    }
+
+    // Only the texels the image reaches change, the rest of the layer is neither filtered nor uploaded
+    MipRect changed[MAX_MIP_LEVELS];
+    spliceMipRegion(&atlas->layerMips[slot.layer], &levels->region, changed);
+    uploadLayerRects(atlas, slot.layer, changed);
+    freeAtlasImageLevels(&filtered);
+    return 1;
+}
+
+// Points a program's "Atlas" block at the image table
+void bindTextureAtlas(GLuint program){
+    GLuint block = glGetUniformBlockIndex(program, "Atlas");
+    if (block != GL_INVALID_INDEX){
+        glUniformBlockBinding(program, block, ATLAS_BINDING);
+    }
+}
+
+// Frees the textures and the table
+void freeTextureAtlas(TextureAtlas* atlas){
+    for (int i = 0; i < atlas->numImages; i++){
+        deleteImageTexture(atlas, i);
+    }
+    if (atlas->texture) glDeleteTextures(1, &atlas->texture);
+    if (atlas->dataTexture) glDeleteTextures(1, &atlas->dataTexture);
+    if (atlas->ubo) glDeleteBuffers(1, &atlas->ubo);
+    freeLayerMips(atlas);
+    memset(atlas, 0, sizeof(TextureAtlas));
+}
\ No newline at end of file
@@ -0,0 +1,616 @@
+#include "../include/virtual_texture.h"
+#include "../include/texture.h"
+#include "../include/stb_image.h"
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define PAGE_BYTES ((size_t)VT_PADDED_PAGE * VT_PADDED_PAGE * 4)
+#define PHYSICAL_SLOTS (VT_PHYSICAL_PAGES * VT_PHYSICAL_PAGES)
+
+// Most pages asked for by one feedback read, the rest wait for a later one
+#define MAX_REQUESTS 256
+
+// Start of a pages file, the pages follow level by level, each level row by row
+typedef struct {
+    char magic[4]; // "VTP1"
+    int width, height;
+    int pageSize, border;
+    int numLevels;
+} PageFileHeader;
+
+// Whether an image is big enough that it should be streamed, reads only its header
+int wantsVirtualTexture(const char* path){
+    int width, height, channels;
+    if (!stbi_info(path, &width, &height, &channels)){
+        return 0;
+    }
+    return width > VT_MIN_SIZE || height > VT_MIN_SIZE;
+}
+
+// Splits the levels into pages, halving until one page covers a level
+static void computeLevels(VirtualTexture* vt, int width, int height){
+    vt->numLevels = 0;
+    vt->numPages = 0;
+    for (int l = 0; l < VT_MAX_LEVELS; l++){
+        VirtualLevel* level = &vt->levels[l];
+        level->width = width >> l > 0 ? width >> l : 1;
+        level->height = height >> l > 0 ? height >> l : 1;
+        level->pagesX = (level->width + VT_PAGE_SIZE - 1) / VT_PAGE_SIZE;
+        level->pagesY = (level->height + VT_PAGE_SIZE - 1) / VT_PAGE_SIZE;
+        level->firstPage = vt->numPages;
+        vt->numPages += level->pagesX * level->pagesY;
+        vt->numLevels++;
+        if (level->pagesX == 1 && level->pagesY == 1){
+            break;
+        }
+    }
+}
+
+// Copies one page and its border out of a level, the border wraps around like the texture repeats
+static void copyPage(const unsigned char* level, int width, int height, int pageX, int pageY, unsigned char* page){
+    for (int y = 0; y < VT_PADDED_PAGE; y++){
+        int sy = pageY * VT_PAGE_SIZE + y - VT_BORDER;
+        sy = ((sy % height) + height) % height;
+        for (int x = 0; x < VT_PADDED_PAGE; x++){
+            int sx = pageX * VT_PAGE_SIZE + x - VT_BORDER;
+            sx = ((sx % width) + width) % width;
+            memcpy(page + ((size_t)y * VT_PADDED_PAGE + x) * 4, level + ((size_t)sy * width + sx) * 4, 4);
+        }
+    }
+}
+
+// Frees a level, the first one may still be the decoded image itself
+static void freeLevel(unsigned char* level, ImageData* image){
+    if (level == image->pixels){
+        freeImage(image);
+    }
+    else {
+        free(level);
+    }
+}
+
+// Writes every level of the image as bordered pages, done once per source image
+// Needs the whole source in memory, so for the biggest images run it ahead of time with --convert-pages
+// 0 on failure, 1 on success
+static int convertPages(const char* path, const char* pagesPath){
+    printf("Converting virtual texture: (%s)\n", path);
+    ImageData image;
+    if (loadImage(path, &image) == 0){
+        return 0;
+    }
+
+    // Pages are always RGBA, a four channel decode is paged as it is instead of copied
+    int width = image.width, height = image.height;
+    size_t texels = (size_t)width * height;
+    unsigned char* level = image.channels == 4 ? image.pixels : malloc(texels * 4);
+    unsigned char* page = malloc(PAGE_BYTES);
+    FILE* file = fopen(pagesPath, "wb");
+    if (level == NULL || page == NULL || file == NULL){
+        printf("Failed to write pages: (%s)\n", pagesPath);
+        if (file) fclose(file);
+        if (level != image.pixels) free(level);
+        free(page);
+        freeImage(&image);
+        return 0;
+    }
+    if (level != image.pixels){
+        for (size_t i = 0; i < texels; i++){
+            const unsigned char* src = image.pixels + i * image.channels;
+            unsigned char* texel = level + i * 4;
+            texel[0] = src[0];
+            texel[1] = image.channels >= 3 ? src[1] : src[0];
+            texel[2] = image.channels >= 3 ? src[2] : src[0];
+            texel[3] = image.channels == 2 ? src[1] : 255;
+        }
+        // Only the copy is needed from here, so the decode and the copy never sit next to a second level
+        freeImage(&image);
+    }
+
+    VirtualTexture layout;
+    computeLevels(&layout, width, height);
+    PageFileHeader header = {{'V', 'T', 'P', '1'}, width, height, VT_PAGE_SIZE, VT_BORDER, layout.numLevels};
+    int success = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    for (int l = 0; l < layout.numLevels && success; l++){
+        const VirtualLevel* current = &layout.levels[l];
+        for (int py = 0; py < current->pagesY && success; py++){
+            for (int px = 0; px < current->pagesX && success; px++){
+                copyPage(level, current->width, current->height, px, py, page);
+                success = fwrite(page, PAGE_BYTES, 1, file) == 1;
+            }
+        }
+
+        // Halve for the next level
+        if (l + 1 < layout.numLevels){
+            const VirtualLevel* next = &layout.levels[l + 1];
+            unsigned char* smaller = malloc((size_t)next->width * next->height * 4);
+            if (smaller == NULL){
+                success = 0;
+                break;
+            }
+            downsampleMip(level, current->width, current->height, smaller, 4, MIP_SRGB);
+            freeLevel(level, &image);
+            level = smaller;
+        }
+    }
+    freeLevel(level, &image);
+    free(page);
+    if (fclose(file) != 0) success = 0;
+    if (!success){
+        printf("Failed to write pages: (%s)\n", pagesPath);
+        remove(pagesPath);
+        return 0;
+    }
+    printf("Virtual texture pages: (%s) (%d) levels, (%d) pages\n", pagesPath, layout.numLevels, layout.numPages);
+    return 1;
+}
+
+// Reads one page from the pages file, safe on any thread
+// 0 on failure, 1 on success
+static int readPage(int fd, int page, unsigned char* pixels){
+    off_t offset = (off_t)sizeof(PageFileHeader) + (off_t)page * (off_t)PAGE_BYTES;
+    size_t done = 0;
+    while (done < PAGE_BYTES){
+        ssize_t count = pread(fd, pixels + done, PAGE_BYTES - done, offset + (off_t)done);
+        if (count <= 0){
+            return 0;
+        }
+        done += (size_t)count;
+    }
+    return 1;
+}
+
+// Reads queued pages one at a time
+static void* pageWorker(void* arg){
+    VirtualTexture* vt = (VirtualTexture*)arg;
+
+    pthread_mutex_lock(&vt->lock);
+    while (!vt->quit){
+        PageLoad* load = NULL;
+        for (int i = 0; i < VT_MAX_LOADS; i++){
+            if (vt->loads[i].state == PAGE_LOAD_QUEUED){
+                load = &vt->loads[i];
+                break;
+            }
+        }
+        if (load == NULL){
+            pthread_cond_wait(&vt->wake, &vt->lock);
+            continue;
+        }
+        load->state = PAGE_LOAD_READING;
+        pthread_mutex_unlock(&vt->lock);
+
+        // A failed read uploads a black page instead of asking for it forever
+        if (readPage(vt->fd, load->page, load->pixels) == 0){
+            printf("Failed to read virtual texture page: (%d)\n", load->page);
+            memset(load->pixels, 0, PAGE_BYTES);
+        }
+
+        pthread_mutex_lock(&vt->lock);
+        load->state = PAGE_LOAD_DONE;
+    }
+    pthread_mutex_unlock(&vt->lock);
+    return NULL;
+}
+
+// The page of the next coarser level that covers a page
+static int parentPage(const VirtualTexture* vt, int level, int x, int y){
+    const VirtualLevel* parent = &vt->levels[level + 1];
+    int px = x / 2 < parent->pagesX ? x / 2 : parent->pagesX - 1;
+    int py = y / 2 < parent->pagesY ? y / 2 : parent->pagesY - 1;
+    return parent->firstPage + py * parent->pagesX + px;
+}
+
+// Copies a page into a slot of the physical texture
+static void uploadPage(VirtualTexture* vt, int page, int slot, const unsigned char* pixels){
+    int x = (slot % VT_PHYSICAL_PAGES) * VT_PADDED_PAGE;
+    int y = (slot / VT_PHYSICAL_PAGES) * VT_PADDED_PAGE;
+    glBindTexture(GL_TEXTURE_2D, vt->physical);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, VT_PADDED_PAGE, VT_PADDED_PAGE, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+
+    if (vt->slotPages[slot] >= 0){
+        vt->pageSlots[vt->slotPages[slot]] = -1;
+        vt->pagesEvicted++;
+    }
+    vt->slotPages[slot] = page;
+    vt->slotUsed[slot] = vt->frame;
+    vt->pageSlots[page] = slot;
+    vt->pagesUploaded++;
+    vt->indirectionDirty = 1;
+}
+
+// Least recently used slot, -1 when every slot holds a page the latest feedback still needs
+static int evictableSlot(const VirtualTexture* vt){
+    int best = -1;
+    for (int i = 0; i < PHYSICAL_SLOTS; i++){
+        if (vt->slotPages[i] < 0){
+            return i;
+        }
+        if (vt->slotUsed[i] < vt->feedbackFrame && (best < 0 || vt->slotUsed[i] < vt->slotUsed[best])){
+            best = i;
+        }
+    }
+    return best;
+}
+
+// Maps every page to its own slot, or to whatever its parent maps to, coarsest level first
+static void updateIndirection(VirtualTexture* vt){
+    for (int l = vt->numLevels - 1; l >= 0; l--){
+        const VirtualLevel* level = &vt->levels[l];
+        for (int y = 0; y < level->pagesY; y++){
+            for (int x = 0; x < level->pagesX; x++){
+                int page = level->firstPage + y * level->pagesX + x;
+                unsigned char* entry = vt->indirectionData + (size_t)page * 4;
+                int slot = vt->pageSlots[page];
+                if (slot >= 0){
+                    entry[0] = (unsigned char)(slot % VT_PHYSICAL_PAGES);
+                    entry[1] = (unsigned char)(slot / VT_PHYSICAL_PAGES);
+                    entry[2] = (unsigned char)l;
+                    entry[3] = 1;
+                }
+                else if (l + 1 < vt->numLevels){
+                    memcpy(entry, vt->indirectionData + (size_t)parentPage(vt, l, x, y) * 4, 4);
+                }
+            }
+        }
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, vt->indirectionBuffer);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, (GLsizeiptr)vt->numPages * 4, vt->indirectionData);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    vt->indirectionDirty = 0;
+}
+
+// Render target and read back buffers of the feedback pass
+// 0 on failure, 1 on success
+static int initFeedback(VirtualTexture* vt, int windowWidth, int windowHeight){
+    vt->feedbackWidth = windowWidth / VT_FEEDBACK_SCALE > 0 ? windowWidth / VT_FEEDBACK_SCALE : 1;
+    vt->feedbackHeight = windowHeight / VT_FEEDBACK_SCALE > 0 ? windowHeight / VT_FEEDBACK_SCALE : 1;
+
+    glGenRenderbuffers(1, &vt->feedbackColor);
+    glBindRenderbuffer(GL_RENDERBUFFER, vt->feedbackColor);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA16UI, vt->feedbackWidth, vt->feedbackHeight);
+    glGenRenderbuffers(1, &vt->feedbackDepth);
+    glBindRenderbuffer(GL_RENDERBUFFER, vt->feedbackDepth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, vt->feedbackWidth, vt->feedbackHeight);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &vt->feedbackFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, vt->feedbackFramebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, vt->feedbackColor);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, vt->feedbackDepth);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE){
+        printf("Failed to create feedback framebuffer: (0x%x)\n", status);
+        return 0;
+    }
+
+    // RGBA16UI texels, 8 bytes each
+    glGenBuffers(2, vt->feedbackBuffers);
+    for (int i = 0; i < 2; i++){
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, vt->feedbackBuffers[i]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)vt->feedbackWidth * vt->feedbackHeight * 8, NULL, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    return 1;
+}
+
+// Converts the image into "<path>.pages", without a GL context
+int convertVirtualTexture(const char* path){
+    char pagesPath[512];
+    snprintf(pagesPath, sizeof(pagesPath), "%s.pages", path);
+    return convertPages(path, pagesPath);
+}
+
+// Converts the image into "<path>.pages" if that is missing or older, opens it and starts the worker
+// 0 on failure, 1 on success
+int initVirtualTexture(VirtualTexture* vt, const char* path, int windowWidth, int windowHeight){
+    memset(vt, 0, sizeof(VirtualTexture));
+    vt->fd = -1;
+
+    char pagesPath[512];
+    snprintf(pagesPath, sizeof(pagesPath), "%s.pages", path);
+    struct stat source, pages;
+    if (stat(path, &source) != 0){
+        printf("Failed to open virtual texture: (%s)\n", path);
+        return 0;
+    }
+    if (stat(pagesPath, &pages) != 0 || pages.st_mtime < source.st_mtime){
+        if (convertPages(path, pagesPath) == 0){
+            return 0;
+        }
+    }
+
+    PageFileHeader header;
+    vt->fd = open(pagesPath, O_RDONLY);
+    if (vt->fd < 0 || pread(vt->fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+        memcmp(header.magic, "VTP1", 4) != 0 || header.pageSize != VT_PAGE_SIZE || header.border != VT_BORDER){
+        printf("Failed to read pages, delete it to convert again: (%s)\n", pagesPath);
+        freeVirtualTexture(vt);
+        return 0;
+    }
+    computeLevels(vt, header.width, header.height);
+
+    vt->pageSlots = malloc(sizeof(int) * vt->numPages);
+    vt->pageUsed = calloc(vt->numPages, sizeof(unsigned int));
+    vt->pageLoading = calloc(vt->numPages, 1);
+    vt->indirectionData = calloc(vt->numPages, 4);
+    for (int i = 0; i < VT_MAX_LOADS; i++){
+        vt->loads[i].page = -1;
+        vt->loads[i].pixels = malloc(PAGE_BYTES);
+        if (vt->loads[i].pixels == NULL) vt->numPages = 0;
+    }
+    if (vt->pageSlots == NULL || vt->pageUsed == NULL || vt->pageLoading == NULL || vt->indirectionData == NULL || vt->numPages == 0){
+        printf("Failed to allocate virtual texture: (%s)\n", path);
+        freeVirtualTexture(vt);
+        return 0;
+    }
+    for (int i = 0; i < vt->numPages; i++){
+        vt->pageSlots[i] = -1;
+    }
+    for (int i = 0; i < PHYSICAL_SLOTS; i++){
+        vt->slotPages[i] = -1;
+    }
+
+    // Pages are placed with their borders, so plain bilinear filtering never reads a neighbour
+    // Not sampled through the shared sampler objects, the cache has no mip levels and must not repeat
+    int physicalSize = VT_PHYSICAL_PAGES * VT_PADDED_PAGE;
+    glGenTextures(1, &vt->physical);
+    glBindTexture(GL_TEXTURE_2D, vt->physical);
+    // Pages are color, decoded from sRGB when sampled
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8, physicalSize, physicalSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+    // Fetched per page like the body matrices
+    glGenBuffers(1, &vt->indirectionBuffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, vt->indirectionBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, (GLsizeiptr)vt->numPages * 4, NULL, GL_DYNAMIC_DRAW);
+    glGenTextures(1, &vt->indirection);
+    glBindTexture(GL_TEXTURE_BUFFER, vt->indirection);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA8UI, vt->indirectionBuffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    if (initFeedback(vt, windowWidth, windowHeight) == 0){
+        freeVirtualTexture(vt);
+        return 0;
+    }
+
+    // The coarsest page goes in right away and is pinned, everything falls back to it
+    int root = vt->levels[vt->numLevels - 1].firstPage;
+    if (readPage(vt->fd, root, vt->loads[0].pixels) == 0){
+        printf("Failed to read pages, delete it to convert again: (%s)\n", pagesPath);
+        freeVirtualTexture(vt);
+        return 0;
+    }
+    uploadPage(vt, root, 0, vt->loads[0].pixels);
+    vt->slotUsed[0] = 0xFFFFFFFFu;
+    vt->pagesUploaded = 0;
+    updateIndirection(vt);
+
+    pthread_mutex_init(&vt->lock, NULL);
+    pthread_cond_init(&vt->wake, NULL);
+    if (pthread_create(&vt->worker, NULL, pageWorker, vt) != 0){
+        printf("Failed to start page worker: (%s)\n", path);
+        pthread_mutex_destroy(&vt->lock);
+        pthread_cond_destroy(&vt->wake);
+        freeVirtualTexture(vt);
+        return 0;
+    }
+    vt->started = 1;
+
+    printf("Virtual texture: (%s) (%d x %d), (%d) levels, (%d) pages, (%d) page cache\n",
+           path, header.width, header.height, vt->numLevels, vt->numPages, PHYSICAL_SLOTS);
+    return 1;
+}
+
+// Sets the level table and the lod bias of a program
+void setVirtualTextureUniforms(const VirtualTexture* vt, GLuint program, float lodBias){
+    GLint levels[VT_MAX_LEVELS * 4];
+    for (int l = 0; l < vt->numLevels; l++){
+        levels[l * 4 + 0] = vt->levels[l].width;
+        levels[l * 4 + 1] = vt->levels[l].height;
+        levels[l * 4 + 2] = vt->levels[l].pagesX;
+        levels[l * 4 + 3] = vt->levels[l].firstPage;
+    }
+    glUseProgram(program);
+    glUniform4iv(glGetUniformLocation(program, "vtLevels"), vt->numLevels, levels);
+    glUniform1i(glGetUniformLocation(program, "vtNumLevels"), vt->numLevels);
+    glUniform1f(glGetUniformLocation(program, "vtLodBias"), lodBias);
+}
+
+// The feedback target is VT_FEEDBACK_SCALE times smaller, so its derivatives pick levels that much coarser
+float virtualFeedbackBias(void){
+    return -log2f((float)VT_FEEDBACK_SCALE);
+}
+
+// Binds the feedback target, cleared to "no page"
+void beginVirtualFeedback(VirtualTexture* vt){
+    static const GLuint none[4] = {0, 0, 0, 0};
+    glBindFramebuffer(GL_FRAMEBUFFER, vt->feedbackFramebuffer);
+    glViewport(0, 0, vt->feedbackWidth, vt->feedbackHeight);
+    glClearBufferuiv(GL_COLOR, 0, none);
+    glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+// Copies the feedback into a pack buffer and fences it, updateVirtualTexture maps it once the fence has signaled
+void endVirtualFeedback(VirtualTexture* vt, int windowWidth, int windowHeight){
+    int index = vt->feedbackIndex;
+    if (vt->feedbackFences[index]){
+        // Never read, a newer one replaces it
+        glDeleteSync(vt->feedbackFences[index]);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, vt->feedbackBuffers[index]);
+    glReadPixels(0, 0, vt->feedbackWidth, vt->feedbackHeight, GL_RGBA_INTEGER, GL_UNSIGNED_SHORT, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    vt->feedbackFences[index] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    vt->feedbackIndex ^= 1;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, windowWidth, windowHeight);
+}
+
+// Uploads finished reads into the least recently used slots, at most VT_UPLOADS_PER_FRAME
+static void uploadLoads(VirtualTexture* vt){
+    int uploads = 0;
+    pthread_mutex_lock(&vt->lock);
+    for (int i = 0; i < VT_MAX_LOADS && uploads < VT_UPLOADS_PER_FRAME; i++){
+        PageLoad* load = &vt->loads[i];
+        if (load->state != PAGE_LOAD_DONE){
+            continue;
+        }
+        // Pages the latest feedback needs stay, the load is dropped and asked for again later
+        int slot = evictableSlot(vt);
+        if (slot >= 0){
+            uploadPage(vt, load->page, slot, load->pixels);
+            uploads++;
+        }
+        vt->pageLoading[load->page] = 0;
+        load->page = -1;
+        load->state = PAGE_LOAD_FREE;
+    }
+    pthread_mutex_unlock(&vt->lock);
+}
+
+// Marks the pages a feedback read saw, touches the resident ones and their ancestors
+// Returns how many missing pages were put in requests
+static int readFeedback(VirtualTexture* vt, const GLushort* texels, int* requests){
+    int numRequests = 0;
+    int count = vt->feedbackWidth * vt->feedbackHeight;
+    for (int i = 0; i < count; i++){
+        const GLushort* texel = texels + (size_t)i * 4;
+        int x = texel[0], y = texel[1], l = texel[2];
+        if (texel[3] == 0 || l >= vt->numLevels || x >= vt->levels[l].pagesX || y >= vt->levels[l].pagesY){
+            continue;
+        }
+
+        // Walk up until a page already seen this frame, most texels repeat their neighbour's page
+        while (1){
+            int page = vt->levels[l].firstPage + y * vt->levels[l].pagesX + x;
+            if (vt->pageUsed[page] == vt->frame){
+                break;
+            }
+            vt->pageUsed[page] = vt->frame;
+            int slot = vt->pageSlots[page];
+            if (slot >= 0){
+                if (vt->slotUsed[slot] != 0xFFFFFFFFu) vt->slotUsed[slot] = vt->frame;
+            }
+            else if (!vt->pageLoading[page] && numRequests < MAX_REQUESTS){
+                requests[numRequests++] = page;
+            }
+            if (l + 1 >= vt->numLevels){
+                break;
+            }
+            int parent = parentPage(vt, l, x, y);
+            l++;
+            x = (parent - vt->levels[l].firstPage) % vt->levels[l].pagesX;
+            y = (parent - vt->levels[l].firstPage) / vt->levels[l].pagesX;
+        }
+    }
+    return numRequests;
+}
+
+// Hands the coarsest requests to free load slots, coarse pages cover more and arrive first
+static void queueLoads(VirtualTexture* vt, int* requests, int numRequests){
+    // Pages are numbered finest level first, so a higher id is never finer
+    for (int i = 1; i < numRequests; i++){
+        int page = requests[i], j = i;
+        while (j > 0 && requests[j - 1] < page){
+            requests[j] = requests[j - 1];
+            j--;
+        }
+        requests[j] = page;
+    }
+
+    int next = 0, queued = 0;
+    pthread_mutex_lock(&vt->lock);
+    for (int i = 0; i < VT_MAX_LOADS && next < numRequests; i++){
+        if (vt->loads[i].state != PAGE_LOAD_FREE){
+            continue;
+        }
+        int page = requests[next++];
+        vt->loads[i].page = page;
+        vt->loads[i].state = PAGE_LOAD_QUEUED;
+        vt->pageLoading[page] = 1;
+        queued++;
+    }
+    if (queued > 0){
+        pthread_cond_signal(&vt->wake);
+    }
+    pthread_mutex_unlock(&vt->lock);
+}
+
+// Call once per frame on the main thread
+void updateVirtualTexture(VirtualTexture* vt){
+    vt->frame++;
+    uploadLoads(vt);
+
+    // The buffer written longest ago, only if the GPU is done with it, never waits
+    int index = vt->feedbackIndex;
+    GLsync fence = vt->feedbackFences[index];
+    if (fence){
+        GLenum status = glClientWaitSync(fence, 0, 0);
+        if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED){
+            glDeleteSync(fence);
+            vt->feedbackFences[index] = 0;
+            vt->feedbackFrame = vt->frame;
+
+            int requests[MAX_REQUESTS];
+            int numRequests = 0;
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, vt->feedbackBuffers[index]);
+            const GLushort* texels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+                                                      (GLsizeiptr)vt->feedbackWidth * vt->feedbackHeight * 8, GL_MAP_READ_BIT);
+            if (texels){
+                numRequests = readFeedback(vt, texels, requests);
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            }
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            queueLoads(vt, requests, numRequests);
+        }
+    }
+
+    if (vt->indirectionDirty){
+        updateIndirection(vt);
+    }
+}
+
+// Stops the worker and frees everything
+void freeVirtualTexture(VirtualTexture* vt){
+    if (vt->started){
+        pthread_mutex_lock(&vt->lock);
+        vt->quit = 1;
+        pthread_cond_signal(&vt->wake);
+        pthread_mutex_unlock(&vt->lock);
+        pthread_join(vt->worker, NULL);
+        pthread_mutex_destroy(&vt->lock);
+        pthread_cond_destroy(&vt->wake);
+    }
+    for (int i = 0; i < 2; i++){
+        if (vt->feedbackFences[i]) glDeleteSync(vt->feedbackFences[i]);
+    }
+    if (vt->feedbackBuffers[0]) glDeleteBuffers(2, vt->feedbackBuffers);
+    if (vt->feedbackFramebuffer) glDeleteFramebuffers(1, &vt->feedbackFramebuffer);
+    if (vt->feedbackColor) glDeleteRenderbuffers(1, &vt->feedbackColor);
+    if (vt->feedbackDepth) glDeleteRenderbuffers(1, &vt->feedbackDepth);
+    if (vt->indirection) glDeleteTextures(1, &vt->indirection);
+    if (vt->indirectionBuffer) glDeleteBuffers(1, &vt->indirectionBuffer);
+    if (vt->physical) glDeleteTextures(1, &vt->physical);
+    for (int i = 0; i < VT_MAX_LOADS; i++){
+        free(vt->loads[i].pixels);
+    }
+    free(vt->pageSlots);
+    free(vt->pageUsed);
+    free(vt->pageLoading);
+    free(vt->indirectionData);
+    if (vt->fd >= 0) close(vt->fd);
+    memset(vt, 0, sizeof(VirtualTexture));
+}
\ No newline at end of file